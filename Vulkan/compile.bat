@@ -1,2 +1,12 @@
 glslc shaders\simple_shader.vert -o shaders\simple_shader.vert.spv
 glslc shaders\simple_shader.frag -o shaders\simple_shader.frag.spv
+glslc shaders\particles.comp -o shaders\particles.comp.spv
+glslc shaders\particles.vert -o shaders\particles.vert.spv
+glslc shaders\particles.frag -o shaders\particles.frag.spv
+glslc shaders\sierpinski.vert -o shaders\sierpinski.vert.spv
+glslc shaders\sierpinski.frag -o shaders\sierpinski.frag.spv
+glslc shaders\chaos.comp -o shaders\chaos.comp.spv
+glslc shaders\fullscreen.vert -o shaders\fullscreen.vert.spv
+glslc shaders\chaos.frag -o shaders\chaos.frag.spv
+glslc shaders\bindless.vert -o shaders\bindless.vert.spv
+glslc shaders\bindless.frag -o shaders\bindless.frag.spv
\ No newline at end of file
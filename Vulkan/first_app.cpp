@@ -1,13 +1,28 @@
 #include "first_app.hpp"
 
+#include "lve_allocation_counter.hpp"
+#include "lve_startup_trace.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
 // std
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
 #include <stdexcept>
+#include <thread>
 
 #include <chrono>
 
@@ -21,34 +36,337 @@ namespace lve
 	{
 		glm::vec2 offset;
 		alignas(16) glm::vec3 color;
+		float scale;
+	};
+
+	// Matches the push constants of sierpinski.vert and sierpinski.frag
+	struct SierpinskiPushConstantData
+	{
+		glm::vec2 left;
+		glm::vec2 right;
+		glm::vec2 top;
+		uint32_t depth;
+		alignas(16) glm::vec3 color;
+	};
+
+	// Matches Instance in bindless.vert, std430
+	struct BindlessInstanceData
+	{
+		glm::vec2 offset;
+		float scale;
+		uint32_t material;
+		glm::vec4 color;
 	};
 
-	FirstApp::FirstApp()
+	// LveBindlessTable handles of this frame's instances and of the materials
+	struct BindlessPushConstantData
+	{
+		uint32_t instances;
+		uint32_t materials;
+	};
+
+	// Materials, by the COLOR_MODE of simple_shader.frag they are built with
+	static constexpr int32_t MATERIAL_COLOR_MODES[] = { 0, 2 };
+	static const char* MATERIAL_NAMES[] = { "simple", "simple_tinted" };
+	// The material the streamed Sierpinski mesh is drawn with, see morphPipeline
+	static constexpr size_t MORPH_MATERIAL = 1;
+
+	static const VkClearColorValue CLEAR_COLOR{ { 0.01f, 0.01f, 0.01f, 1.0f } };
+
+	FirstApp::FirstApp(const std::string& preferredDevice)
+		: lveDevice{ lveWindow, preferredDevice }
 	{
+		if (const char* report = std::getenv("LVE_MEMORY_REPORT"))
+			memoryReport = report;
+		printStats = std::getenv("LVE_STATS") != nullptr;
+		if (const char* mode = std::getenv("LVE_SIERPINSKI"))
+			sierpinskiMode = std::strcmp(mode, "procedural") == 0 ? SierpinskiMode::Procedural : SierpinskiMode::Mesh;
+		if (const char* depth = std::getenv("LVE_MORPH_DEPTH"))
+			morphDepth = std::clamp(std::atoi(depth), 0, sierpinskiMode == SierpinskiMode::Mesh ? MAX_MESH_DEPTH : MAX_PROCEDURAL_DEPTH);
+		if (const char* count = std::getenv("LVE_PARTICLES"))
+			particleCount = static_cast<uint32_t>(std::min(std::strtoul(count, nullptr, 10), 1ul << 24));
+		if (const char* points = std::getenv("LVE_CHAOS_POINTS"))
+			chaosPoints = std::strtoull(points, nullptr, 10);
+		if (const char* resolution = std::getenv("LVE_CHAOS_RESOLUTION"))
+			chaosResolution = static_cast<uint32_t>(std::max(std::strtoul(resolution, nullptr, 10), 1ul));
+
 		loadModels();
+		if (morphDepth > 0 && sierpinskiMode == SierpinskiMode::Mesh)
+			morphModel = std::make_unique<LveDynamicModel>(lveDevice, sierpinskiVertexCount(morphDepth), LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		loadScene();
+		createParticles();
+		createChaosGame();
+		createBindless();
 		createPipelineLayout();
 		recreateSwapChain(); // calls createPipeline() too
-		createCommandBuffers();
+		createShaderWatcher();
 	}
 	
 	FirstApp::~FirstApp()
 	{
+		// The watcher thread builds against the device, it has to stop first
+		shaderWatcher = nullptr;
+		vkDeviceWaitIdle(lveDevice.device());
+		if (!traceFile.empty())
+		{
+			for (uint32_t frameIndex = 0; frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT; ++frameIndex)
+				gpuTrace.collect(frameIndex);
+			try
+			{
+				finishTrace();
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << e.what() << "\n";
+			}
+		}
+		// Every copy has landed, so the last frames are written too
+		if (readback != nullptr)
+		{
+			for (uint32_t frameIndex = 0; frameIndex < LveSwapChain::MAX_FRAMES_IN_FLIGHT; ++frameIndex)
+				readback->complete(frameIndex);
+			readback = nullptr;
+		}
+		retiredPipelines.clear();
+		particles = nullptr;
+		chaosGame = nullptr;
+		sierpinskiPipeline = nullptr;
+		morphPipeline = nullptr;
+		bindlessPipeline = nullptr;
+		for (auto& instances : instanceBuffers)
+			destroyBindlessBuffer(instances);
+		destroyBindlessBuffer(materialBuffer);
+		vkDestroyPipelineLayout(lveDevice.device(), bindlessLayout, nullptr);
+		vkDestroyPipelineLayout(lveDevice.device(), sierpinskiLayout, nullptr);
 		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
 	}
 	
 	void FirstApp::run()
 	{
 		std::cout << "Max Push Constants Size: " << lveDevice.properties.limits.maxPushConstantsSize << "\n";
-		while (!lveWindow.shouldClose())
+		startTime = std::chrono::steady_clock::now();
+		running = true;
+		LveTrace::setThreadName("main");
+
+		// A failure on either thread stops both and is rethrown here once they are joined
+		std::exception_ptr simulationError;
+		std::exception_ptr renderError;
+		auto start = [this](void (FirstApp::* loop)(), std::exception_ptr& error)
+		{
+			return std::thread([this, loop, &error]()
+				{
+					try
+					{
+						(this->*loop)();
+					}
+					catch (...)
+					{
+						error = std::current_exception();
+						running = false;
+						glfwPostEmptyEvent();
+					}
+				});
+		};
+		std::thread simulation = start(&FirstApp::simulationLoop, simulationError);
+		std::thread render = start(&FirstApp::renderLoop, renderError);
+
+		// Blocks until there are events, so a slow frame never delays input and an idle window costs nothing
+		while (running && !lveWindow.shouldClose())
+			glfwWaitEvents();
+
+		running = false;
+		simulation.join();
+		render.join();
+
+		if (renderError)
+			std::rethrow_exception(renderError);
+		if (simulationError)
+			std::rethrow_exception(simulationError);
+	}
+
+	double FirstApp::secondsSinceStart() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	void FirstApp::simulationLoop()
+	{
+		// After a stall of more than this many ticks the missed time is dropped instead of caught up
+		constexpr uint64_t maxCatchUpTicks = 5;
+
+		LveTrace::setThreadName("simulation");
+		uint64_t tick = 0;
+		while (running)
+		{
+			double due = (tick + 1) * static_cast<double>(SIMULATION_STEP);
+			double late = secondsSinceStart() - due;
+			if (late < 0.0)
+			{
+				std::this_thread::sleep_for(std::chrono::duration<double>(-late));
+				continue;
+			}
+			if (late > maxCatchUpTicks * static_cast<double>(SIMULATION_STEP))
+			{
+				tick += static_cast<uint64_t>(late / SIMULATION_STEP);
+				due = (tick + 1) * static_cast<double>(SIMULATION_STEP);
+			}
+
+			// The slot belongs to this thread until it is published, its vectors are reused
+			LVE_TRACE_SCOPE("simulationTick");
+			auto& snapshot = snapshots.back();
+			simulationScene.saveFrame(snapshot.previous);
+			simulationScene.update(SIMULATION_STEP, 0);
+			simulationScene.saveFrame(snapshot.current);
+			snapshot.tick = ++tick;
+			snapshot.time = due;
+			snapshots.publish();
+		}
+	}
+
+	void FirstApp::renderLoop()
+	{
+		// Everything a frame needs comes from its arena, so once warmed up the count stays at 0.
+		// The total also counts the culling jobs on the workers and the other threads.
+		// tests/frame_allocation_test checks the CPU side of prepareFrame, workers included
+		uint64_t reportStart = LveAllocationCounter::threadAllocations();
+		uint64_t totalReportStart = LveAllocationCounter::totalAllocations();
+		uint32_t framesSinceReport = 0;
+		LveTrace::setThreadName("render");
+
+		while (running)
 		{
-			// auto start = std::chrono::high_resolution_clock::now();
-			glfwPollEvents();
 			drawFrame();
-			// std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
-			// std::cout << "Took: " << duration.count() * 1000.0 << "ms - FPS: " << 1 / (duration.count()) << "\n";
+
+			if (printStats && ++framesSinceReport == STATS_INTERVAL)
+			{
+				uint64_t allocations = LveAllocationCounter::threadAllocations();
+				uint64_t totalAllocations = LveAllocationCounter::totalAllocations();
+				std::cout << "Heap allocations, last " << STATS_INTERVAL << " frames: " << allocations - reportStart
+					<< " on the render thread, " << totalAllocations - totalReportStart << " on all threads\n";
+				reportStart = LveAllocationCounter::threadAllocations();
+				totalReportStart = LveAllocationCounter::totalAllocations();
+				framesSinceReport = 0;
+			}
+		}
+	}
+
+	// Runs once the fence of this frame slot signaled, what the last frame in it allocated
+	// or streamed to the GPU is free again
+	void FirstApp::prepareFrame(uint32_t frameIndex)
+	{
+		LVE_TRACE_SCOPE("prepareFrame");
+		auto& arena = frameArenas[frameIndex];
+		arena.reset();
+
+		snapshots.update();
+		const auto& snapshot = snapshots.front();
+
+		// Drawn one tick behind the simulation, so there is always a later state to blend towards
+		float alpha = static_cast<float>((secondsSinceStart() - snapshot.time) / SIMULATION_STEP);
+		scene.interpolate(snapshot.previous, snapshot.current, std::clamp(alpha, 0.0f, 1.0f));
+		cullScene(arena);
+
+		// The corners circle around their rest positions, out of phase with each other
+		float time = static_cast<float>(secondsSinceStart());
+		auto corner = [time](glm::vec2 rest, float phase)
+		{
+			return rest + 0.15f * glm::vec2{ std::cos(time + phase), std::sin(1.3f * time + phase) };
+		};
+		morphCorners = { corner({ -1.0f, 1.0f }, 0.0f), corner({ 1.0f, 1.0f }, 2.1f), corner({ 0.0f, -1.0f }, 4.2f) };
+		if (morphModel != nullptr)
+			morphSierpinski(frameIndex);
+
+		double gpuMs;
+		if (frameTimer.collect(frameIndex, gpuMs))
+		{
+			frameTimes.gpuMs += gpuMs;
+			++frameTimes.frames;
+		}
+		gpuTrace.collect(frameIndex);
+		if (particles != nullptr)
+			reportParticles(frameIndex);
+		if (chaosGame != nullptr)
+			reportChaosGame(frameIndex);
+		if (readback != nullptr)
+		{
+			readback->complete(frameIndex);
+			reportReadback();
 		}
 	}
 
+	void FirstApp::benchmarkPipelines(uint32_t variantCount)
+	{
+		// Every variant differs in fixed function state only, the way material permutations do
+		std::vector<std::unique_ptr<PipelineConfigInfo>> configs;
+		std::vector<PipelineBuildRequest> requests;
+		for (uint32_t i = 0; i < variantCount; ++i)
+		{
+			auto config = std::make_unique<PipelineConfigInfo>();
+			LvePipeline::defaultPipelineConfigInfo(*config);
+			setRenderTarget(*config);
+			config->pipelineLayout = pipelineLayout;
+
+			config->rasterizationInfo.cullMode = (i & 1) ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+			config->rasterizationInfo.frontFace = (i & 2) ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
+			config->colorBlendAttachment.blendEnable = (i & 4) ? VK_TRUE : VK_FALSE;
+			config->colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			config->colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			config->depthStencilInfo.depthCompareOp = (i & 8) ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_LESS;
+			config->depthStencilInfo.depthWriteEnable = (i & 16) ? VK_FALSE : VK_TRUE;
+			// Past 32 variants the depth bias keeps them distinct
+			config->rasterizationInfo.depthBiasEnable = (i >> 5) ? VK_TRUE : VK_FALSE;
+			config->rasterizationInfo.depthBiasConstantFactor = static_cast<float>(i >> 5);
+
+			requests.push_back({ "shaders/simple_shader.vert.spv", "shaders/simple_shader.frag.spv", config.get() });
+			configs.push_back(std::move(config));
+		}
+
+		auto runBatch = [&](const char* label, uint32_t threadCount, VkPipelineCache cache)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			auto results = LvePipeline::createBatch(lveDevice, requests, threadCount, cache);
+			std::chrono::duration<double, std::milli> total = std::chrono::high_resolution_clock::now() - start;
+
+			double minMs = 0.0, maxMs = 0.0, sumMs = 0.0;
+			uint32_t built = 0;
+			for (const auto& result : results)
+			{
+				if (result.pipeline == nullptr)
+					continue;
+				minMs = built == 0 ? result.compileMs : std::min(minMs, result.compileMs);
+				maxMs = std::max(maxMs, result.compileMs);
+				sumMs += result.compileMs;
+				++built;
+			}
+
+			std::cout << label << " (" << threadCount << " threads): " << built << " pipelines in " << total.count() << "ms"
+				<< " - per pipeline min: " << minMs << "ms, avg: " << (built > 0 ? sumMs / built : 0.0)
+				<< "ms, max: " << maxMs << "ms\n";
+		};
+
+		// A fresh cache per run, otherwise the second run only measures cache hits
+		auto createCache = [this]()
+		{
+			VkPipelineCacheCreateInfo cacheInfo{};
+			cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			VkPipelineCache cache;
+			if (vkCreatePipelineCache(lveDevice.device(), &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create pipeline cache");
+			return cache;
+		};
+
+		uint32_t threadCount = LveJobSystem::get().threadCount();
+
+		VkPipelineCache serialCache = createCache();
+		runBatch("Serial", 1, serialCache);
+		vkDestroyPipelineCache(lveDevice.device(), serialCache, nullptr);
+
+		VkPipelineCache parallelCache = createCache();
+		runBatch("Parallel", threadCount, parallelCache);
+		runBatch("Parallel, warm cache", threadCount, parallelCache);
+		vkDestroyPipelineCache(lveDevice.device(), parallelCache, nullptr);
+	}
+
 	void createInverseSierpinskiTriangle(
 		std::vector<LveModel::Vertex>& vertices,
 		int depth,
@@ -69,19 +387,619 @@ namespace lve
 		createInverseSierpinskiTriangle(vertices, depth - 1, nLeft, nRight, top);
 	}
 
+	// Same triangles as createInverseSierpinskiTriangle, written straight to out, returns the end
+	static LveModel::Vertex* writeInverseSierpinskiTriangle(
+		LveModel::Vertex* out,
+		int depth,
+		glm::vec2 left, glm::vec2 right, glm::vec2 top)
+	{
+		if (depth <= 0) return out;
+
+		auto nLeft = 0.5f * (left + top);
+		auto nRight = 0.5f * (right + top);
+		auto nBottom = 0.5f * (left + right);
+
+		*out++ = { { nLeft }   , {1.0f, 0.0f, 0.0f} };
+		*out++ = { { nRight }  , {0.0f, 1.0f, 0.0f} };
+		*out++ = { { nBottom } , {0.0f, 0.0f, 1.0f} };
+
+		out = writeInverseSierpinskiTriangle(out, depth - 1, left, nBottom, nLeft);
+		out = writeInverseSierpinskiTriangle(out, depth - 1, nBottom, right, nRight);
+		return writeInverseSierpinskiTriangle(out, depth - 1, nLeft, nRight, top);
+	}
+
+	// 3 vertices per level, each level has 3 times the triangles of the previous one
+	uint32_t FirstApp::sierpinskiVertexCount(int depth)
+	{
+		uint32_t triangles = 0;
+		for (uint32_t level = 0, count = 1; level < static_cast<uint32_t>(depth); ++level, count *= 3)
+			triangles += count;
+		return 3 * triangles;
+	}
+
+	void FirstApp::morphSierpinski(uint32_t frameIndex)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		LveModel::Vertex* begin = morphModel->beginWrite(frameIndex);
+		LveModel::Vertex* end = writeInverseSierpinskiTriangle(begin, morphDepth, morphCorners[0], morphCorners[1], morphCorners[2]);
+		morphModel->endWrite(static_cast<uint32_t>(end - begin));
+
+		morphStats.bytes += morphModel->lastWriteBytes();
+		morphStats.writeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (++morphStats.frames == STATS_INTERVAL)
+		{
+			if (printStats)
+			{
+				double megabytes = morphStats.bytes / (1024.0 * 1024.0) / morphStats.frames;
+				double ms = morphStats.writeMs / morphStats.frames;
+				std::cout << "Streaming: " << megabytes << " MB per frame, written in " << ms << "ms ("
+					<< megabytes / 1024.0 / (ms / 1000.0) << " GB/s) to " << (morphModel->isDeviceLocal() ? "device local" : "host")
+					<< (morphModel->isCoherent() ? " coherent" : " non coherent, flushed") << " memory\n";
+			}
+			morphStats = {};
+		}
+	}
+
+	// Fills clip space behind everything else, its own vertex colors dimmed
+	void FirstApp::drawSierpinski(VkCommandBuffer commandBuffer)
+	{
+		if (sierpinskiMode == SierpinskiMode::Procedural)
+		{
+			sierpinskiPipeline->bind(commandBuffer);
+
+			SierpinskiPushConstantData push{};
+			push.left = morphCorners[0];
+			push.right = morphCorners[1];
+			push.top = morphCorners[2];
+			push.depth = static_cast<uint32_t>(morphDepth);
+			push.color = { 0.3f, 0.3f, 0.3f };
+			vkCmdPushConstants(commandBuffer, sierpinskiLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SierpinskiPushConstantData), &push);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			if (capture != nullptr)
+				capture->draw(static_cast<uint32_t>(std::size(MATERIAL_COLOR_MODES)), CapturedDraw::NO_MODEL, 3, &push, sizeof(push));
+			return;
+		}
+
+		morphPipeline->bind(commandBuffer);
+		morphModel->bind(commandBuffer);
+
+		SimplePushConstantData push{};
+		push.offset = { 0.0f, 0.0f };
+		push.color = { 0.3f, 0.3f, 0.3f };
+		push.scale = 1.0f;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
+		morphModel->draw(commandBuffer);
+	}
+
+	void FirstApp::benchmarkSierpinski(int maxDepth)
+	{
+		// Every frame goes through drawFrame, only the scene is left out
+		constexpr uint32_t warmupFrames = 10;
+		constexpr uint32_t measuredFrames = 120;
+		startTime = std::chrono::steady_clock::now();
+		drawScene = false;
+
+		if (!frameTimer.available())
+			std::cout << "No timestamps on this device, only wall clock frame times (vsync bound)\n";
+		std::cout << "Sierpinski on " << lveDevice.properties.deviceName << ", " << measuredFrames << " frames per run\n";
+
+		auto measure = [&](SierpinskiMode mode, int depth)
+		{
+			vkDeviceWaitIdle(lveDevice.device());
+			sierpinskiMode = mode;
+			morphDepth = depth;
+			morphModel = nullptr;
+			if (mode == SierpinskiMode::Mesh)
+				morphModel = std::make_unique<LveDynamicModel>(lveDevice, sierpinskiVertexCount(depth), LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+			for (uint32_t frame = 0; frame < warmupFrames; ++frame)
+			{
+				glfwPollEvents();
+				drawFrame();
+			}
+			frameTimes = {};
+			morphStats = {};
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < measuredFrames; ++frame)
+			{
+				glfwPollEvents();
+				drawFrame();
+			}
+			vkDeviceWaitIdle(lveDevice.device());
+			double wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / measuredFrames;
+
+			VkDeviceSize bytes = morphModel != nullptr ? morphModel->bufferSize() : 0;
+			std::cout << "  depth " << depth << (mode == SierpinskiMode::Mesh ? ", mesh:       " : ", procedural: ")
+				<< (mode == SierpinskiMode::Mesh ? sierpinskiVertexCount(depth) : 3) << " vertices, "
+				<< bytes / 1024.0 << " KB geometry, frame " << wallMs << "ms";
+			if (frameTimes.frames > 0)
+				std::cout << ", GPU " << frameTimes.gpuMs / frameTimes.frames << "ms";
+			if (morphStats.frames > 0)
+				std::cout << ", vertex writes " << morphStats.writeMs / morphStats.frames << "ms";
+			std::cout << "\n";
+		};
+
+		for (int depth = 1; depth <= std::min(maxDepth, MAX_PROCEDURAL_DEPTH); ++depth)
+		{
+			if (depth <= MAX_MESH_DEPTH)
+				measure(SierpinskiMode::Mesh, depth);
+			measure(SierpinskiMode::Procedural, depth);
+		}
+
+		vkDeviceWaitIdle(lveDevice.device());
+		morphModel = nullptr;
+		morphDepth = 0;
+		drawScene = true;
+	}
+
+	// The materials, then the procedural Sierpinski triangle
+	static std::vector<CapturedPipeline> capturedPipelines()
+	{
+		std::vector<CapturedPipeline> pipelines;
+		for (int32_t colorMode : MATERIAL_COLOR_MODES)
+		{
+			CapturedPipeline material{};
+			material.vertFilePath = "shaders/simple_shader.vert.spv";
+			material.fragFilePath = "shaders/simple_shader.frag.spv";
+			material.colorMode = colorMode;
+			material.pushConstantSize = sizeof(SimplePushConstantData);
+			material.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+			pipelines.push_back(material);
+		}
+		CapturedPipeline sierpinski{};
+		sierpinski.vertFilePath = "shaders/sierpinski.vert.spv";
+		sierpinski.fragFilePath = "shaders/sierpinski.frag.spv";
+		sierpinski.pushConstantSize = sizeof(SierpinskiPushConstantData);
+		sierpinski.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		sierpinski.vertexInput = false;
+		sierpinski.depthTest = false;
+		pipelines.push_back(sierpinski);
+		CapturedPipeline morph = pipelines[MORPH_MATERIAL];
+		morph.depthTest = false;
+		pipelines.push_back(morph);
+		return pipelines;
+	}
+
+	void FirstApp::startCapture(const std::string& filePath, uint32_t frames)
+	{
+		if (frames == 0)
+			return;
+		capture = std::make_unique<LveFrameCaptureWriter>(filePath, lveSwapChain->getSwapChainExtent(), CLEAR_COLOR.float32);
+		captureFramesLeft = frames;
+
+		// Same handles as the draw list, material i is pipeline i and model handle i is model i
+		for (const auto& meshFile : meshFiles)
+			capture->addModel(meshFile->view());
+		for (const auto& pipeline : capturedPipelines())
+			capture->addPipeline(pipeline);
+
+		if ((morphDepth > 0 && sierpinskiMode == SierpinskiMode::Mesh) || particles != nullptr || chaosGame != nullptr)
+			std::cout << "Capture leaves out the streamed Sierpinski mesh, particles and the chaos game\n";
+		std::cout << "Capturing " << frames << " frames to " << filePath << "\n";
+	}
+
+	void FirstApp::startTrace(const std::string& filePath, uint32_t frames)
+	{
+		if (frames == 0)
+			return;
+		traceFile = filePath;
+		traceFramesLeft = frames;
+		// Without the extension the calibration submit must not queue behind frames
+		vkDeviceWaitIdle(lveDevice.device());
+		gpuTrace.calibrate();
+		LveTrace::start();
+		std::cout << "Tracing " << frames << " frames to " << filePath << (gpuTrace.calibrated() ? "" :
+			", GPU ranges are placed by a one time calibration without VK_EXT_calibrated_timestamps") << "\n";
+	}
+
+	void FirstApp::finishTrace()
+	{
+		LveTrace::stop();
+		std::string filePath = std::move(traceFile);
+		traceFile.clear();
+		LveTrace::writeJson(filePath);
+		std::cout << "Wrote " << LveTrace::eventCount() << " trace events to " << filePath << "\n";
+	}
+
+	void FirstApp::createParticles()
+	{
+		if (particleCount == 0)
+			return;
+
+		// Stepped in the command buffers that draw them, so it has to be the graphics queue
+		if (!lveDevice.findPhysicalQueueFamilies().graphicsFamilySupportsCompute)
+		{
+			std::cerr << "Particles disabled: the graphics queue has no compute support\n";
+			return;
+		}
+		particles = std::make_unique<LveParticleSystem>(
+			lveDevice, particleCount, LveSwapChain::MAX_FRAMES_IN_FLIGHT, lveDevice.graphicsQueue(), lveDevice.getCommandPool());
+		if (!particles->hasTimestamps())
+			std::cout << "Particles: no timestamps on this device, throughput is not reported\n";
+	}
+
+	void FirstApp::reportParticles(uint32_t frameIndex)
+	{
+		particles->collectTimings(frameIndex);
+		if (!statsDue() || frameCount == 0)
+			return;
+
+		auto stats = particles->takeStats();
+		if (stats.steps == 0)
+			return;
+		double ms = stats.gpuMs / stats.steps;
+		std::cout << "Particles: " << particles->size() << " stepped in " << ms << "ms on the GPU ("
+			<< particles->size() / ms << " particles per ms)\n";
+	}
+
+	void FirstApp::createChaosGame()
+	{
+		if (chaosPoints == 0)
+			return;
+
+		// Splatted in the command buffers that draw it, like the particles
+		if (!lveDevice.findPhysicalQueueFamilies().graphicsFamilySupportsCompute)
+		{
+			std::cerr << "Chaos game disabled: the graphics queue has no compute support\n";
+			return;
+		}
+		chaosGame = std::make_unique<LveChaosGame>(
+			lveDevice, chaosPoints, chaosResolution, LveSwapChain::MAX_FRAMES_IN_FLIGHT, lveDevice.graphicsQueue());
+		if (!chaosGame->hasTimestamps())
+			std::cout << "Chaos game: no timestamps on this device, throughput is not reported\n";
+	}
+
+	void FirstApp::reportChaosGame(uint32_t frameIndex)
+	{
+		chaosGame->collectTimings(frameIndex);
+		if (!statsDue() || frameCount == 0)
+			return;
+
+		auto stats = chaosGame->takeStats();
+		if (stats.frames == 0)
+			return;
+		double ms = stats.gpuMs / stats.frames;
+		std::cout << "Chaos game: " << chaosGame->pointsPerFrame() << " points at " << chaosGame->resolution() << "x"
+			<< chaosGame->resolution() << " in " << ms << "ms on the GPU ("
+			<< chaosGame->pointsPerFrame() / (ms / 1000.0) / 1e9 << " billion points per second)\n";
+	}
+
+	std::vector<RegressionScene> FirstApp::regressionScenes()
+	{
+		const auto pipelines = capturedPipelines();
+		const uint32_t sierpinskiPipeline = static_cast<uint32_t>(std::size(MATERIAL_COLOR_MODES));
+		const uint32_t morphPipeline = sierpinskiPipeline + 1;
+		const LveFrameCaptureFile::Model triangle{ {
+			{ { -0.5f,  0.5f }, { 1.0f, 0.0f, 0.0f } },
+			{ {  0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f } },
+			{ {  0.0f, -0.5f }, { 0.0f, 0.0f, 1.0f } } }, {} };
+
+		// One frame each, pipeline i of a scene is usedPipelines[i]
+		std::vector<RegressionScene> scenes;
+		auto addScene = [&](std::string name, const std::vector<uint32_t>& usedPipelines, std::vector<LveFrameCaptureFile::Model> models)
+		{
+			RegressionScene scene{ std::move(name), {} };
+			auto& capture = scene.capture;
+			capture.header.magic = CaptureFileHeader::MAGIC;
+			capture.header.version = CaptureFileHeader::VERSION;
+			capture.header.width = LveRegression::WIDTH;
+			capture.header.height = LveRegression::HEIGHT;
+			std::copy(std::begin(CLEAR_COLOR.float32), std::end(CLEAR_COLOR.float32), capture.header.clearColor);
+			capture.header.vertexStride = sizeof(LveModel::Vertex);
+			for (uint32_t pipeline : usedPipelines)
+				capture.pipelines.push_back(pipelines[pipeline]);
+			capture.models = std::move(models);
+			capture.frames.resize(1);
+			capture.header.modelCount = static_cast<uint32_t>(capture.models.size());
+			capture.header.pipelineCount = static_cast<uint32_t>(capture.pipelines.size());
+			capture.header.frameCount = 1;
+			scenes.push_back(std::move(scene));
+			return &scenes.back().capture.frames[0];
+		};
+		auto addDraw = [](CapturedFrame* frame, uint32_t pipeline, uint32_t model, uint32_t vertexCount, const auto& push)
+		{
+			frame->draws.push_back({ pipeline, model, vertexCount, static_cast<uint32_t>(frame->pushData.size()), sizeof(push) });
+			auto bytes = reinterpret_cast<const uint8_t*>(&push);
+			frame->pushData.insert(frame->pushData.end(), bytes, bytes + sizeof(push));
+		};
+
+		SimplePushConstantData whole{};
+		whole.offset = { 0.0f, 0.0f };
+		whole.color = { 0.3f, 0.3f, 0.3f };
+		whole.scale = 1.0f;
+		addDraw(addScene("triangle", { 0 }, { triangle }), 0, 0, 0, whole);
+
+		// Drawn the way drawSierpinski draws them, as the streamed mesh and procedurally
+		for (int depth : { 2, 4, 6, 8 })
+		{
+			LveFrameCaptureFile::Model mesh{};
+			createInverseSierpinskiTriangle(mesh.vertices, depth, { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 0.0f, -1.0f });
+			addDraw(addScene("sierpinski_mesh_" + std::to_string(depth), { morphPipeline }, { std::move(mesh) }), 0, 0, 0, whole);
+		}
+		for (int depth : { 4, 8, 16 })
+		{
+			SierpinskiPushConstantData push{};
+			push.left = { -1.0f, 1.0f };
+			push.right = { 1.0f, 1.0f };
+			push.top = { 0.0f, -1.0f };
+			push.depth = static_cast<uint32_t>(depth);
+			push.color = { 0.3f, 0.3f, 0.3f };
+			addDraw(addScene("sierpinski_procedural_" + std::to_string(depth), { sierpinskiPipeline }, {}), 0, CapturedDraw::NO_MODEL, 3, push);
+		}
+
+		// The scene's shape, one triangle and one push constant block per object, sorted by material
+		constexpr int gridSize = 32;
+		CapturedFrame* instanced = addScene("instanced", { 0, 1 }, { triangle });
+		for (uint32_t material = 0; material < 2; ++material)
+		{
+			for (int y = 0; y < gridSize; ++y)
+			{
+				for (int x = (y + material) % 2; x < gridSize; x += 2)
+				{
+					SimplePushConstantData push{};
+					push.offset = { (x + 0.5f) * 2.0f / gridSize - 1.0f, (y + 0.5f) * 2.0f / gridSize - 1.0f };
+					push.color = { static_cast<float>(x) / gridSize, static_cast<float>(y) / gridSize, 0.5f };
+					push.scale = 2.0f / gridSize;
+					addDraw(instanced, material, 0, 0, push);
+				}
+			}
+		}
+		return scenes;
+	}
+
+	void FirstApp::startReadback(const std::string& directory, bool raw)
+	{
+		if (!lveSwapChain->supportsReadback())
+			throw std::runtime_error("The surface does not allow copying from swap chain images");
+		if (!LveReadback::supportsFormat(lveSwapChain->getSwapChainImageFormat()))
+			throw std::runtime_error("Readback does not support the swap chain format");
+
+		std::filesystem::create_directories(directory);
+		readbackDirectory = directory;
+		readbackRaw = raw;
+		// Two frames in flight plus as many waiting for a worker
+		readback = std::make_unique<LveReadback>(lveDevice, 2 * LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		buildRenderGraph();
+		std::cout << "Writing every frame to " << directory << (raw ? " as raw pixels\n" : " as PNG\n");
+	}
+
+	void FirstApp::reportReadback()
+	{
+		if (frameCount % STATS_INTERVAL != 0 || frameCount == 0)
+			return;
+
+		// Failed writes are reported with or without LVE_STATS
+		auto stats = readback->takeStats();
+		if (stats.failed > 0)
+			std::cerr << "Readback: " << stats.failed << " frames failed to write\n";
+		if (!printStats || (stats.copied == 0 && stats.dropped == 0 && stats.failed == 0))
+			return;
+		std::cout << "Readback: " << stats.copied << " frames written, " << stats.dropped << " dropped, " << stats.failed << " failed, "
+			<< (stats.copied > 0 ? stats.consumeMs / stats.copied : 0.0) << "ms per frame on the workers\n";
+	}
+
+	void FirstApp::benchmarkParticles(uint32_t particleCount)
+	{
+		// Steps are recorded back to back into one submission, so the timestamps around
+		// them measure the dispatches and barriers without any per frame overhead
+		constexpr uint32_t steps = 100;
+
+		VkQueue queue = lveDevice.computeQueue();
+		VkCommandPool commandPool = lveDevice.getComputeCommandPool();
+		LveParticleSystem system{ lveDevice, particleCount, 0, queue, commandPool };
+
+		LveGpuTimer timer{ lveDevice, 1 };
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed allocating command buffers");
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		timer.begin(commandBuffer, 0);
+		for (uint32_t step = 0; step < steps; ++step)
+			system.simulate(commandBuffer, SIMULATION_STEP, { 0.3f, 0.0f });
+		timer.end(commandBuffer, 0);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to record command buffer");
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit particle steps");
+		vkQueueWaitIdle(queue);
+		double wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::cout << "Particles on " << lveDevice.properties.deviceName << ", " << particleCount << " particles, "
+			<< steps << " steps, " << (queue == lveDevice.graphicsQueue() ? "graphics" : "dedicated compute") << " queue\n";
+		std::cout << "  submit to idle: " << wallMs / steps << "ms per step, "
+			<< particleCount / (wallMs / steps) << " particles per ms\n";
+		double gpuMs;
+		if (timer.collect(0, gpuMs, true))
+		{
+			gpuMs /= steps;
+			std::cout << "  GPU timestamps: " << gpuMs << "ms per step, " << particleCount / gpuMs << " particles per ms\n";
+		}
+
+		vkFreeCommandBuffers(lveDevice.device(), commandPool, 1, &commandBuffer);
+	}
+
+	// Recursion depths of the Sierpinski LODs, each level has a third of the triangles of the one before
+	static constexpr int SIERPINSKI_LOD_DEPTHS[] = { 8, 6, 4, 2 };
+	// Part of every generated mesh's cache key. Bump it when a generator below changes what it
+	// emits, or the cache keeps mapping the old meshes
+	static constexpr int MESH_GENERATOR_VERSION = 1;
+
+	std::vector<std::unique_ptr<LveMeshFile>> FirstApp::loadMeshFiles(LveMeshCache::LoadStats* stats)
+	{
+		LveStartupTrace::Phase phase{ "loadMeshFiles" };
+		LveMeshCache meshCache{ "cache" };
+		std::vector<std::unique_ptr<LveMeshFile>> meshFiles;
+
+		// Stats add up, the load only counts as warm if every mesh came from the cache
+		stats->cacheHit = true;
+		auto accumulate = [stats](const LveMeshCache::LoadStats& meshStats)
+		{
+			stats->cacheHit = stats->cacheHit && meshStats.cacheHit;
+			stats->buildMs += meshStats.buildMs;
+			stats->mapMs += meshStats.mapMs;
+		};
+
+		// Every mesh is generated or mapped independently, one job each
+		const size_t meshCount = 1 + std::size(SIERPINSKI_LOD_DEPTHS);
+		meshFiles.resize(meshCount);
+		std::vector<LveMeshCache::LoadStats> meshStats(meshCount);
+		LveJobSystem::get().parallelFor(meshCount, 1, [&](size_t begin, size_t end)
+			{
+				for (size_t mesh = begin; mesh < end; ++mesh)
+				{
+					if (mesh == 0)
+					{
+						meshFiles[mesh] = meshCache.load("triangle:v=" + std::to_string(MESH_GENERATOR_VERSION), [](auto& vertices, auto&)
+							{
+								vertices.push_back({ { -0.5f,  0.5f }  , { 1.0f, 0.0f, 0.0f } });
+								vertices.push_back({ {  0.5f,  0.5f }  , { 0.0f, 1.0f, 0.0f } });
+								vertices.push_back({ {  0.0f, -0.5f }  , { 0.0f, 0.0f, 1.0f } });
+							}, &meshStats[mesh]);
+						continue;
+					}
+
+					int depth = SIERPINSKI_LOD_DEPTHS[mesh - 1];
+					std::string key = "sierpinski:depth=" + std::to_string(depth) + ":v=" + std::to_string(MESH_GENERATOR_VERSION);
+					meshFiles[mesh] = meshCache.load(key, [depth](auto& vertices, auto&)
+						{
+							createInverseSierpinskiTriangle(vertices, depth, { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 0.0f, -1.0f });
+						}, &meshStats[mesh]);
+				}
+			});
+		for (const auto& stat : meshStats)
+			accumulate(stat);
+		return meshFiles;
+	}
+
+	FirstApp::ShaderCode FirstApp::readSimpleShaders()
+	{
+		LveStartupTrace::Phase phase{ "readSimpleShaders" };
+		return { LvePipeline::readFile("shaders/simple_shader.vert.spv"), LvePipeline::readFile("shaders/simple_shader.frag.spv") };
+	}
+
 	void FirstApp::loadModels()
 	{
-		std::vector<LveModel::Vertex> vertices;
-		// createInverseSierpinskiTriangle(vertices, 10, { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 0.0f, -1.0f });
-		vertices.push_back({ { -0.5f,  0.5f }  , { 1.0f, 0.0f, 0.0f } });
-		vertices.push_back({ {  0.5f,  0.5f }  , { 0.0f, 1.0f, 0.0f } });
-		vertices.push_back({ {  0.0f, -0.5f }  , { 0.0f, 0.0f, 1.0f } });
-		lveModel = std::make_unique<LveModel>(lveDevice, vertices);
-		
+		LveStartupTrace::Phase phase{ "loadModels" };
+
+		// Usually ready by now, the device took longer than the cache
+		auto start = std::chrono::high_resolution_clock::now();
+		meshFiles = pendingMeshes.get();
+		for (const auto& meshFile : meshFiles)
+			models.push_back(std::make_unique<LveModel>(lveDevice, meshFile->view()));
+		std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+		std::cout << "Model load (" << (meshStats.cacheHit ? "warm" : "cold") << "): " << duration.count() << "ms"
+			<< " - build: " << meshStats.buildMs << "ms, map: " << meshStats.mapMs << "ms\n";
+	}
+
+	void FirstApp::loadScene()
+	{
+		// Group 0 is the plain triangle, group 1 the Sierpinski LODs, switched by on screen size
+		lodGroups.push_back({ { { 0, 0.0f } }, 0.71f });
+
+		LodGroup sierpinski{};
+		sierpinski.boundingRadius = 1.42f;
+		const float minPixels[] = { 300.0f, 120.0f, 40.0f, 0.0f };
+		for (size_t level = 0; level < std::size(SIERPINSKI_LOD_DEPTHS); ++level)
+			sierpinski.levels.push_back({ static_cast<ModelHandle>(1 + level), minPixels[level] });
+		lodGroups.push_back(sierpinski);
+
+		// The four triangles that used to be hardcoded in recordCommandBuffer, now moving on their own
+		for (int j = 0; j < 4; ++j)
+		{
+			scene.add(
+				{ -0.5f, -0.4f + j * 0.25f },
+				{ 0.12f * (j + 1), 0.05f * (j - 1.5f) },
+				0.5f,
+				{ 0.2f * j, 0.6f - 0.1f * j, 0.2f + 0.2f * j },
+				0);
+		}
+
+		// The view only shows the middle of the world, so objects wander in and out of it
+		std::mt19937 random{ 7 };
+		std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+		for (int i = 0; i < 2000; ++i)
+		{
+			scene.add(
+				{ 2.0f * unit(random) - 1.0f, 2.0f * unit(random) - 1.0f },
+				{ 0.2f * unit(random) - 0.1f, 0.2f * unit(random) - 0.1f },
+				0.01f + 0.2f * unit(random) * unit(random),
+				{ unit(random), unit(random), 0.5f + 0.5f * unit(random) },
+				1,
+				i % 2);
+		}
+		view.halfExtent = 0.6f;
+
+		// The simulation starts from the same objects, every slot holds the initial state
+		simulationScene = scene;
+		SimulationSnapshot initial{};
+		scene.saveFrame(initial.previous);
+		scene.saveFrame(initial.current);
+		snapshots.reset(initial);
+	}
+
+	void FirstApp::cullScene(LveFrameArena& arena)
+	{
+		visibleObjects = FrameVector<VisibleObject>(LveArenaAllocator<VisibleObject>(arena));
+		visibleObjects.reserve(scene.size());
+		view.viewportHeight = static_cast<float>(lveSwapChain->getSwapChainExtent().height);
+		LveCulling::cull(scene, lodGroups, view, visibleObjects, cullStats);
+
+		if (statsDue())
+		{
+			std::cout << "Culling: drawn " << cullStats.drawn << ", culled " << cullStats.culled << " of " << cullStats.tested
+				<< " in " << cullStats.cullMs << "ms - per lod:";
+			for (size_t level = 0; level < std::size(SIERPINSKI_LOD_DEPTHS); ++level)
+				std::cout << " " << cullStats.drawnPerLod[level];
+			std::cout << "\n";
+		}
+
+		buildDrawList(arena);
+	}
+
+	void FirstApp::buildDrawList(LveFrameArena& arena)
+	{
+		drawList.clear(arena);
+		for (const auto& visible : visibleObjects)
+		{
+			// One descriptor set for everything and a 2D scene without depth, so those key bits stay 0.
+			// Drawn instanced every material shares the pipeline, so only the model is sorted by
+			uint32_t material = scene.material(visible.object);
+			uint32_t keyMaterial = instancedScene() ? 0 : material;
+			drawList.add(LveDrawList::makeKey(keyMaterial, 0, visible.model, 0.0f), { material, visible.model, visible.object });
+		}
+		drawList.sort();
+
+		if (statsDue())
+		{
+			auto binds = drawList.countBinds();
+			std::cout << "Draws: " << binds.draws << ", pipeline binds " << binds.pipelineBinds << " (unsorted " << binds.unsortedPipelineBinds
+				<< "), model binds " << binds.modelBinds << " (unsorted " << binds.unsortedModelBinds << "), sort " << binds.sortMs << "ms\n";
+			if (instancedScene())
+				std::cout << "Bindless: " << instancedDraws << " instanced draws\n";
+		}
 	}
 
 	void FirstApp::createPipelineLayout()
 	{
+		LveStartupTrace::Phase phase{ "createPipelineLayout" };
 
 		VkPushConstantRange pushConstantRange{};
 		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -97,100 +1015,358 @@ namespace lve
 
 		if (vkCreatePipelineLayout(lveDevice.device(), &pipelinelayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 			throw std::runtime_error("Failed creating pipeline layout");
+
+		pushConstantRange.size = sizeof(SierpinskiPushConstantData);
+		if (vkCreatePipelineLayout(lveDevice.device(), &pipelinelayoutInfo, nullptr, &sierpinskiLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed creating pipeline layout");
+
+		if (bindless != nullptr)
+		{
+			VkDescriptorSetLayout setLayout = bindless->setLayout();
+			pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+			pushConstantRange.size = sizeof(BindlessPushConstantData);
+			pipelinelayoutInfo.setLayoutCount = 1;
+			pipelinelayoutInfo.pSetLayouts = &setLayout;
+			if (vkCreatePipelineLayout(lveDevice.device(), &pipelinelayoutInfo, nullptr, &bindlessLayout) != VK_SUCCESS)
+				throw std::runtime_error("Failed creating pipeline layout");
+		}
+	}
+
+	void FirstApp::createBindless()
+	{
+		if (!lveDevice.descriptorIndexingEnabled())
+			return;
+		bindless = std::make_unique<LveBindlessTable>(lveDevice);
+
+		// The materials never change, one buffer serves every frame
+		reserveBindlessBuffer(materialBuffer, sizeof(MATERIAL_COLOR_MODES));
+		std::memcpy(materialBuffer.mapped, MATERIAL_COLOR_MODES, sizeof(MATERIAL_COLOR_MODES));
+	}
+
+	// Only grows, and only while no frame in flight can read the buffer, its handle stays the same
+	void FirstApp::reserveBindlessBuffer(BindlessBuffer& buffer, VkDeviceSize size)
+	{
+		if (size <= buffer.size)
+			return;
+		VkDeviceSize newSize = std::max(size, 2 * buffer.size);
+		VkBuffer oldBuffer = buffer.buffer;
+		VkDeviceMemory oldMemory = buffer.memory;
+
+		lveDevice.createBuffer(newSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer.buffer, buffer.memory, MemoryTag::Storage);
+		if (vkMapMemory(lveDevice.device(), buffer.memory, 0, newSize, 0, &buffer.mapped) != VK_SUCCESS)
+			throw std::runtime_error("Failed to map bindless buffer");
+		buffer.size = newSize;
+
+		if (buffer.handle == LveBindlessTable::INVALID_HANDLE)
+			buffer.handle = bindless->addBuffer(buffer.buffer);
+		else
+			bindless->updateBuffer(buffer.handle, buffer.buffer);
+		if (oldBuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(lveDevice.device(), oldBuffer, nullptr);
+			lveDevice.freeMemory(oldMemory);
+		}
+	}
+
+	void FirstApp::destroyBindlessBuffer(BindlessBuffer& buffer)
+	{
+		if (buffer.buffer == VK_NULL_HANDLE)
+			return;
+		vkDestroyBuffer(lveDevice.device(), buffer.buffer, nullptr);
+		lveDevice.freeMemory(buffer.memory);
+		bindless->removeBuffer(buffer.handle);
+		buffer = {};
 	}
 	
 	void FirstApp::createPipeline()
+	{
+		LveStartupTrace::Phase phase{ "createPipeline" };
+
+		// The first pipelines use the shaders read during startup
+		ShaderCode code{};
+		if (pendingShaders.valid())
+			code = pendingShaders.get();
+
+		pipelines.clear();
+		for (int32_t colorMode : MATERIAL_COLOR_MODES)
+			pipelines.push_back(makeSimplePipeline(colorMode, code.vert.empty() ? nullptr : &code));
+		sierpinskiPipeline = makeSierpinskiPipeline();
+		morphPipeline = makeSimplePipeline(MATERIAL_COLOR_MODES[MORPH_MATERIAL], code.vert.empty() ? nullptr : &code, false);
+		if (bindless != nullptr)
+			bindlessPipeline = makeBindlessPipeline();
+
+		if (particles != nullptr)
+		{
+			PipelineConfigInfo particleConfig{};
+			LvePipeline::defaultPipelineConfigInfo(particleConfig);
+			setRenderTarget(particleConfig);
+			particles->createDrawPipeline(particleConfig);
+		}
+		if (chaosGame != nullptr)
+		{
+			PipelineConfigInfo chaosConfig{};
+			LvePipeline::defaultPipelineConfigInfo(chaosConfig);
+			setRenderTarget(chaosConfig);
+			chaosGame->createDrawPipeline(chaosConfig);
+		}
+	}
+
+	// Also called from the shader watcher thread, so it only reads state that
+	// recreateSwapChain replaces while the watcher is paused
+	std::unique_ptr<LvePipeline> FirstApp::makeSimplePipeline(int32_t colorMode, const ShaderCode* code, bool depthTest)
 	{
 		PipelineConfigInfo pipelineConfig{};
 		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = lveSwapChain->getRenderPass();
+		setRenderTarget(pipelineConfig);
 		pipelineConfig.pipelineLayout = pipelineLayout;
-		lvePipeline = std::make_unique<LvePipeline>(
+		// Off for what is drawn behind the scene. Every vertex is at z = 0, so with depth it
+		// would hide whatever is drawn over it
+		pipelineConfig.depthStencilInfo.depthTestEnable = depthTest ? VK_TRUE : VK_FALSE;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = depthTest ? VK_TRUE : VK_FALSE;
+		// COLOR_MODE in simple_shader.frag
+		pipelineConfig.fragSpecialization.set(0, colorMode);
+		if (code != nullptr)
+			return std::make_unique<LvePipeline>(lveDevice, code->vert, code->frag, pipelineConfig);
+		return std::make_unique<LvePipeline>(
 			lveDevice,
 			"shaders/simple_shader.vert.spv",
 			"shaders/simple_shader.frag.spv",
 			pipelineConfig
 			);
 	}
+
+	// Every material in one pipeline, bindless.frag picks the COLOR_MODE per instance
+	std::unique_ptr<LvePipeline> FirstApp::makeBindlessPipeline()
+	{
+		PipelineConfigInfo pipelineConfig{};
+		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+		setRenderTarget(pipelineConfig);
+		pipelineConfig.pipelineLayout = bindlessLayout;
+		return std::make_unique<LvePipeline>(
+			lveDevice,
+			"shaders/bindless.vert.spv",
+			"shaders/bindless.frag.spv",
+			pipelineConfig
+			);
+	}
+
+	// No vertex input, the full screen triangle comes from gl_VertexIndex, and no depth so
+	// it stays behind the scene
+	std::unique_ptr<LvePipeline> FirstApp::makeSierpinskiPipeline()
+	{
+		PipelineConfigInfo pipelineConfig{};
+		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+		setRenderTarget(pipelineConfig);
+		pipelineConfig.bindingDescriptions.clear();
+		pipelineConfig.attributeDescriptions.clear();
+		pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		pipelineConfig.pipelineLayout = sierpinskiLayout;
+		return std::make_unique<LvePipeline>(
+			lveDevice,
+			"shaders/sierpinski.vert.spv",
+			"shaders/sierpinski.frag.spv",
+			pipelineConfig
+			);
+	}
+
+	// Pipelines are built against the render pass, or only the formats of the
+	// attachments when the swap chain uses dynamic rendering
+	void FirstApp::setRenderTarget(PipelineConfigInfo& configInfo)
+	{
+		configInfo.renderPass = lveSwapChain->getRenderPass();
+		if (lveSwapChain->usesDynamicRendering())
+		{
+			configInfo.colorAttachmentFormats = { lveSwapChain->getSwapChainImageFormat() };
+			configInfo.depthAttachmentFormat = lveSwapChain->findDepthFormat();
+			if (LveSwapChain::hasStencilComponent(configInfo.depthAttachmentFormat))
+				configInfo.stencilAttachmentFormat = configInfo.depthAttachmentFormat;
+		}
+	}
+
+	void FirstApp::createShaderWatcher()
+	{
+		LveStartupTrace::Phase phase{ "createShaderWatcher" };
+		try
+		{
+			shaderWatcher = std::make_unique<LveShaderWatcher>("shaders");
+			for (size_t material = 0; material < std::size(MATERIAL_NAMES); ++material)
+			{
+				shaderWatcher->watch(MATERIAL_NAMES[material], { "shaders/simple_shader.vert", "shaders/simple_shader.frag" },
+					[this, material]() { return makeSimplePipeline(MATERIAL_COLOR_MODES[material]); });
+			}
+			shaderWatcher->watch("morph", { "shaders/simple_shader.vert", "shaders/simple_shader.frag" },
+				[this]() { return makeSimplePipeline(MATERIAL_COLOR_MODES[MORPH_MATERIAL], nullptr, false); });
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Shader hot reload disabled: " << e.what() << "\n";
+		}
+	}
+
+	void FirstApp::swapRebuiltPipelines()
+	{
+		// The fence of this frame slot was just waited on, so everything submitted
+		// MAX_FRAMES_IN_FLIGHT frames ago is done with its pipeline
+		while (!retiredPipelines.empty() && retiredPipelines.front().destroyAfterFrame <= frameCount)
+			retiredPipelines.erase(retiredPipelines.begin());
+
+		if (shaderWatcher == nullptr || !shaderWatcher->hasRebuiltPipelines())
+			return;
+
+		for (auto& [name, pipeline] : shaderWatcher->takeRebuiltPipelines())
+		{
+			if (name == "morph")
+			{
+				retiredPipelines.push_back({ std::move(morphPipeline), frameCount + LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+				morphPipeline = std::move(pipeline);
+				continue;
+			}
+			for (size_t material = 0; material < std::size(MATERIAL_NAMES); ++material)
+			{
+				if (name != MATERIAL_NAMES[material])
+					continue;
+				retiredPipelines.push_back({ std::move(pipelines[material]), frameCount + LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+				pipelines[material] = std::move(pipeline);
+			}
+		}
+	}
 	
 	void FirstApp::recreateSwapChain()
 	{
+		LveStartupTrace::Phase phase{ "recreateSwapChain" };
+		// Minimized, wait for the main thread to see the window come back
 		auto extend = lveWindow.getExtend();
 		while (extend.width == 0 || extend.height == 0)
 		{
+			if (!running)
+				return;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
 			extend = lveWindow.getExtend();
-			glfwWaitEvents();
 		}
 
 		vkDeviceWaitIdle(lveDevice.device());
+		retiredPipelines.clear();
+
+		// The watcher builds against the current render pass, keep it out while that changes
+		if (shaderWatcher != nullptr)
+			shaderWatcher->pause();
 
+		VkFormat previousFormat = VK_FORMAT_UNDEFINED;
 		if (lveSwapChain == nullptr)
 			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extend);
 		else
 		{
+			previousFormat = lveSwapChain->getSwapChainImageFormat();
 			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extend, std::move(lveSwapChain));
-			if (lveSwapChain->imageCount() != commandBuffers.size())
-			{
-				freeCommandBuffers();
-				createCommandBuffers();
-			}
 		}
 
-		createPipeline();
+		// A render pass is owned by the swap chain, so its pipelines die with it. Without one
+		// the pipelines only depend on the formats, which a resize does not change
+		bool pipelinesStillValid = lveSwapChain->usesDynamicRendering() && !pipelines.empty() &&
+			previousFormat == lveSwapChain->getSwapChainImageFormat();
+		if (!pipelinesStillValid)
+			createPipeline();
+		buildRenderGraph();
 
+		if (shaderWatcher != nullptr)
+			shaderWatcher->resume();
 	}
 
-	void FirstApp::createCommandBuffers()
+	void FirstApp::buildRenderGraph()
 	{
-		commandBuffers.resize(lveSwapChain->imageCount());
-		
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = lveDevice.getCommandPool();
-		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
-		
-		if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-			throw std::runtime_error("Failed allocating command buffers");
+		// Nothing recorded from the last graph is in flight, the swap chain was rebuilt after
+		// waiting for the device or no frame was drawn yet
+		renderGraph.reset();
+		bool renderPass = !lveSwapChain->usesDynamicRendering();
+		graphColor = renderGraph.importExternalImage("swap chain color", VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		graphDepth = renderGraph.importImage("depth", lveSwapChain->depthAspect());
+		renderGraph.output(graphColor);
 
-	}
+		RenderGraphResource particleBuffers = 0;
+		if (particles != nullptr)
+		{
+			particleBuffers = renderGraph.importBuffer("particles");
+			RenderGraphPass pass = renderGraph.addPass("particles", [this](VkCommandBuffer commandBuffer) { recordParticles(commandBuffer); });
+			renderGraph.readWrite(pass, particleBuffers, RenderGraphUsage::computeStorage());
+		}
 
-	void FirstApp::freeCommandBuffers()
-	{
-		vkFreeCommandBuffers(
-			lveDevice.device(), 
-			lveDevice.getCommandPool(), 
-			static_cast<uint32_t>(commandBuffers.size()),
-			commandBuffers.data());
-		commandBuffers.clear();
-	}
-	
-	void FirstApp::recordCommandBuffer(int imageIndex)
-	{
-		static int frame = 0;
-		frame = (frame + 1) % 1000;
+		// Cleared with a transfer and splatted with atomics, every frame from zero
+		RenderGraphResource chaosCounts = 0;
+		RenderGraphResource chaosPeak = 0;
+		const RenderGraphUsage splat{ VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		if (chaosGame != nullptr)
+		{
+			chaosCounts = renderGraph.importImage("chaos counts", VK_IMAGE_ASPECT_COLOR_BIT);
+			renderGraph.setImage(chaosCounts, chaosGame->image());
+			chaosPeak = renderGraph.importBuffer("chaos peak");
+			RenderGraphPass pass = renderGraph.addPass("chaos game", [this](VkCommandBuffer commandBuffer) { recordChaosGame(commandBuffer); });
+			renderGraph.write(pass, chaosCounts, splat);
+			renderGraph.write(pass, chaosPeak, splat);
+		}
 
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		RenderGraphPass scene = renderGraph.addPass("scene", [this](VkCommandBuffer commandBuffer) { recordScene(commandBuffer); });
+		if (renderPass)
+		{
+			renderGraph.renderPassAttachment(scene, graphColor, { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+			renderGraph.renderPassAttachment(scene, graphDepth, RenderGraphUsage::depthAttachment());
+		}
+		else
+		{
+			renderGraph.write(scene, graphColor, RenderGraphUsage::colorAttachment());
+			renderGraph.write(scene, graphDepth, RenderGraphUsage::depthAttachment());
+		}
+		if (particles != nullptr)
+			renderGraph.read(scene, particleBuffers, RenderGraphUsage::vertexBuffer());
+		if (chaosGame != nullptr)
+		{
+			renderGraph.read(scene, chaosCounts, RenderGraphUsage::fragmentStorageRead());
+			renderGraph.read(scene, chaosPeak, RenderGraphUsage::fragmentStorageRead());
+		}
 
-		if (vkBeginCommandBuffer(commandBuffers[imageIndex], &beginInfo) != VK_SUCCESS)
-			throw std::runtime_error("Failed beggining command buffers");
+		if (readback != nullptr)
+		{
+			RenderGraphPass pass = renderGraph.addPass("readback", [this](VkCommandBuffer commandBuffer) { recordReadback(commandBuffer); });
+			renderGraph.read(pass, graphColor, RenderGraphUsage::transferSource());
+			renderGraph.keep(pass);
+		}
 
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = lveSwapChain->getRenderPass();
-		renderPassInfo.framebuffer = lveSwapChain->getFrameBuffer(imageIndex);
-		renderPassInfo.renderArea.offset = { 0,0 };
-		renderPassInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
+		renderGraph.compile();
+		// Every swap chain rebuild compiles again, LVE_RENDER_GRAPH=1 prints each plan
+		if (std::getenv("LVE_RENDER_GRAPH") != nullptr)
+		{
+			auto stats = renderGraph.stats();
+			std::cout << "Render graph: " << stats.passes << " passes, " << stats.culledPasses << " culled, "
+				<< stats.barriers << " barriers with " << stats.imageBarriers << " image barriers per frame\n";
+			renderGraph.printPlan(std::cout);
+		}
+	}
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.01f,0.01f,0.01f,1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+	void FirstApp::recordParticles(VkCommandBuffer commandBuffer)
+	{
+		double now = secondsSinceStart();
+		float deltaTime = static_cast<float>(std::min(now - lastParticleStep, 0.05));
+		lastParticleStep = now;
+		float angle = 0.5f * static_cast<float>(now);
+		particles->simulate(commandBuffer, deltaTime, 0.5f * glm::vec2{ std::cos(angle), std::sin(angle) },
+			static_cast<int>(lveSwapChain->currentFrameIndex()), false);
+	}
 
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
+	void FirstApp::recordChaosGame(VkCommandBuffer commandBuffer)
+	{
+		chaosGame->splat(commandBuffer, morphCorners, static_cast<uint32_t>(frameCount),
+			static_cast<int>(lveSwapChain->currentFrameIndex()), false);
+	}
 
-		vkCmdBeginRenderPass(commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	void FirstApp::recordScene(VkCommandBuffer commandBuffer)
+	{
+		if (capture != nullptr)
+			capture->beginFrame();
+		lveSwapChain->beginRendering(commandBuffer, graphImageIndex, CLEAR_COLOR, { 1.0f, 0 }, false);
 
 		// Set up dynamic viewPort and Scissor
 		VkViewport viewport{};
@@ -201,32 +1377,158 @@ namespace lve
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
 		VkRect2D scissor{ {0, 0}, lveSwapChain->getSwapChainExtent() };
-		vkCmdSetViewport(commandBuffers[imageIndex], 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffers[imageIndex], 0, 1, &scissor);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		lvePipeline->bind(commandBuffers[imageIndex]);
-		lveModel->bind(commandBuffers[imageIndex]);
+		// Sorted by state, so a bind is only needed when the packet differs from the previous one
+		uint32_t boundPipeline = ~0u;
+		ModelHandle boundModel = ~0u;
 
-		for (int j = 0; j < 4; ++j)
+		// Covers the whole screen, so it goes below everything else
+		if (chaosGame != nullptr)
+			chaosGame->draw(commandBuffer);
+		if (morphDepth > 0)
+			drawSierpinski(commandBuffer);
+		size_t packetCount = drawScene ? drawList.size() : 0;
+		// Instanced, the whole list takes one draw per run of the same model
+		if (instancedScene())
 		{
-			SimplePushConstantData push;
-			push.offset = { -0.5f + frame * 0.002f * (j + 1), -0.4f + j * 0.25f};
-			push.color =  {  0.0f + frame * 0.001f,  0.0f + frame * 0.01f, 0.2f + 0.2f * j * frame };
+			drawInstanced(commandBuffer, packetCount);
+			packetCount = 0;
+		}
+		for (size_t i = 0; i < packetCount; ++i)
+		{
+			const auto& packet = drawList[i];
+			if (packet.pipeline != boundPipeline)
+			{
+				boundPipeline = packet.pipeline;
+				pipelines[boundPipeline]->bind(commandBuffer);
+			}
+			if (packet.model != boundModel)
+			{
+				boundModel = packet.model;
+				models[boundModel]->bind(commandBuffer);
+			}
+
+			// World to clip space, the view is a square centered on view.center
+			SimplePushConstantData push{};
+			push.offset = (scene.position(packet.object) - view.center) / view.halfExtent;
+			push.color = scene.color(packet.object);
+			push.scale = scene.scale(packet.object) / view.halfExtent;
 
-			vkCmdPushConstants(commandBuffers[imageIndex], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
 			
-			lveModel->draw(commandBuffers[imageIndex]);
+			models[boundModel]->draw(commandBuffer);
+			if (capture != nullptr)
+				capture->draw(boundPipeline, boundModel, 0, &push, sizeof(push));
 		}
 
+		// Blended on top of the scene, without depth
+		if (particles != nullptr)
+			particles->draw(commandBuffer);
 
-		vkCmdEndRenderPass(commandBuffers[imageIndex]);
+		lveSwapChain->endRendering(commandBuffer, graphImageIndex, false);
+	}
+
+	void FirstApp::drawInstanced(VkCommandBuffer commandBuffer, size_t packetCount)
+	{
+		BindlessBuffer& instances = instanceBuffers[lveSwapChain->currentFrameIndex()];
+		reserveBindlessBuffer(instances, std::max<size_t>(packetCount, 1) * sizeof(BindlessInstanceData));
+
+		// In draw order, so the packets of a run with the same model are consecutive instances
+		auto* data = static_cast<BindlessInstanceData*>(instances.mapped);
+		for (size_t i = 0; i < packetCount; ++i)
+		{
+			const auto& packet = drawList[i];
+			data[i].offset = (scene.position(packet.object) - view.center) / view.halfExtent;
+			data[i].scale = scene.scale(packet.object) / view.halfExtent;
+			data[i].material = packet.pipeline;
+			data[i].color = glm::vec4(scene.color(packet.object), 1.0f);
+		}
+
+		bindlessPipeline->bind(commandBuffer);
+		bindless->bind(commandBuffer, bindlessLayout);
+		BindlessPushConstantData push{ instances.handle, materialBuffer.handle };
+		vkCmdPushConstants(commandBuffer, bindlessLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BindlessPushConstantData), &push);
 
-		if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS)
+		instancedDraws = 0;
+		for (size_t first = 0; first < packetCount;)
+		{
+			ModelHandle model = drawList[first].model;
+			size_t end = first + 1;
+			while (end < packetCount && drawList[end].model == model)
+				++end;
+			models[model]->bind(commandBuffer);
+			models[model]->draw(commandBuffer, static_cast<uint32_t>(end - first), static_cast<uint32_t>(first));
+			++instancedDraws;
+			first = end;
+		}
+	}
+
+	void FirstApp::recordReadback(VkCommandBuffer commandBuffer)
+	{
+		// The graph moved the image to TRANSFER_SRC_OPTIMAL and moves it back for presenting
+		readback->copy(commandBuffer, static_cast<uint32_t>(lveSwapChain->currentFrameIndex()), lveSwapChain->getImage(graphImageIndex),
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, lveSwapChain->getSwapChainExtent(), lveSwapChain->getSwapChainImageFormat(), frameCount,
+			[directory = readbackDirectory, raw = readbackRaw](const ReadbackImage& image)
+			{
+				char name[64];
+				if (raw)
+				{
+					const char* order = image.format == VK_FORMAT_B8G8R8A8_UNORM || image.format == VK_FORMAT_B8G8R8A8_SRGB ? "bgra" : "rgba";
+					std::snprintf(name, sizeof(name), "frame_%06llu_%ux%u_%s.raw", static_cast<unsigned long long>(image.frame), image.width, image.height, order);
+					LveReadback::writeRaw((std::filesystem::path(directory) / name).string(), image);
+				}
+				else
+				{
+					std::snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(image.frame));
+					LveReadback::writePng((std::filesystem::path(directory) / name).string(), image);
+				}
+			});
+	}
+
+	void FirstApp::recordCommandBuffer(VkCommandBuffer commandBuffer, int imageIndex)
+	{
+		LVE_TRACE_SCOPE("recordCommandBuffer");
+		// A fresh buffer from this frame's pool every frame
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("Failed beggining command buffers");
+
+		uint32_t frameIndex = static_cast<uint32_t>(lveSwapChain->currentFrameIndex());
+		frameTimer.begin(commandBuffer, frameIndex);
+		gpuTrace.beginFrame(commandBuffer, frameIndex);
+		uint32_t frameRange = gpuTrace.begin(commandBuffer, "frame");
+
+		// The passes and every barrier between them, see buildRenderGraph
+		graphImageIndex = static_cast<uint32_t>(imageIndex);
+		renderGraph.setImage(graphColor, lveSwapChain->getImage(imageIndex));
+		renderGraph.setImage(graphDepth, lveSwapChain->getDepthImage(imageIndex));
+		renderGraph.execute(commandBuffer, &gpuTrace);
+
+		gpuTrace.end(commandBuffer, frameRange);
+		frameTimer.end(commandBuffer, frameIndex);
+
+		if (capture != nullptr)
+		{
+			capture->endFrame();
+			if (--captureFramesLeft == 0)
+			{
+				std::cout << "Captured " << capture->frameCount() << " frames\n";
+				capture = nullptr;
+			}
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 			throw std::runtime_error("Failed to record command buffer");
 	}
 
 	void FirstApp::drawFrame()
 	{
+		LVE_TRACE_SCOPE("drawFrame");
 		uint32_t image_index;
 		auto result = lveSwapChain->acquireNextImage(&image_index);
 
@@ -239,12 +1541,17 @@ namespace lve
 		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 			throw std::runtime_error("Failed to acquire swap chain image");
 
+		swapRebuiltPipelines();
+		prepareFrame(static_cast<uint32_t>(lveSwapChain->currentFrameIndex()));
+
 		// Submits the Providing command buffer to the graphics queue when handling CPU and GPU sync
 		// the command buffer will then be exe
 		// And then the swap chain will present the assocated color attachment view to the display
 		// at the opropriate time
-		recordCommandBuffer(image_index);
-		result = lveSwapChain->submitCommandBuffers(&commandBuffers[image_index], &image_index);
+		commandPools.beginFrame(static_cast<uint32_t>(lveSwapChain->currentFrameIndex()));
+		VkCommandBuffer commandBuffer = commandPools.threadPool().allocate();
+		recordCommandBuffer(commandBuffer, image_index);
+		result = lveSwapChain->submitCommandBuffers(&commandBuffer, &image_index);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || lveWindow.wasWindowResized())
 		{
@@ -256,5 +1563,30 @@ namespace lve
 		if (result != VK_SUCCESS)
 			throw std::runtime_error("Failed to present swap chain image");
 
+		if (frameCount == 0)
+			LveStartupTrace::get().firstFramePresented();
+		reportMemory();
+		++frameCount;
+
+		if (!traceFile.empty() && --traceFramesLeft == 0)
+			finishTrace();
+	}
+
+	void FirstApp::reportMemory()
+	{
+		if (memoryReport.empty())
+			return;
+
+		uint64_t generation = lveDevice.memoryGeneration();
+		if (generation == reportedMemoryGeneration)
+			return;
+		reportedMemoryGeneration = generation;
+
+		auto stats = lveDevice.memoryStats();
+		std::cout << "Frame " << frameCount << " ";
+		if (memoryReport == "json")
+			LveMemoryTracker::writeJson(stats, std::cout);
+		else
+			LveMemoryTracker::printReport(stats, std::cout);
 	}
-}
+}
\ No newline at end of file
@@ -1,13 +1,38 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_bindless.hpp"
 #include "lve_pipeline.hpp"
 #include "lve_swap_chain.hpp"
 #include "lve_window.hpp"
 #include "lve_model.hpp"
+#include "lve_shader_watcher.hpp"
+#include "lve_mesh_cache.hpp"
+#include "lve_scene.hpp"
+#include "lve_culling.hpp"
+#include "lve_draw_list.hpp"
+#include "lve_dynamic_model.hpp"
+#include "lve_chaos_game.hpp"
+#include "lve_command_pool.hpp"
+#include "lve_frame_arena.hpp"
+#include "lve_frame_capture.hpp"
+#include "lve_gpu_timer.hpp"
+#include "lve_gpu_trace.hpp"
+#include "lve_job_system.hpp"
+#include "lve_particle_system.hpp"
+#include "lve_readback.hpp"
+#include "lve_regression.hpp"
+#include "lve_render_graph.hpp"
+#include "lve_trace.hpp"
+#include "lve_triple_buffer.hpp"
 
 // std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace lve
@@ -17,31 +42,241 @@ namespace lve
 	public:
 		static constexpr int  WIDTH = 800;
 		static constexpr int  HEIGHT = 600;
-	
+		// The simulation advances in fixed steps of 1 / SIMULATION_RATE seconds, whatever the frame rate
+		static constexpr int SIMULATION_RATE = 60;
+		static constexpr float SIMULATION_STEP = 1.0f / SIMULATION_RATE;
+
+		// Polls window events on the calling thread, which has to be the main one,
+		// while the simulation and rendering run on their own threads
 		void run();
+		// Builds variantCount pipeline variants serially, in parallel and again from a warm cache
+		void benchmarkPipelines(uint32_t variantCount);
+		// Steps particleCount particles on the compute queue and prints particles per ms
+		void benchmarkParticles(uint32_t particleCount);
+		// Draws only the full screen Sierpinski triangle, as a streamed mesh and procedurally,
+		// for every depth up to maxDepth and prints GPU frame time and geometry memory
+		void benchmarkSierpinski(int maxDepth);
+		// Writes the draws of the next frames frames to filePath, for LveFrameReplay
+		void startCapture(const std::string& filePath, uint32_t frames);
+		// Copies every presented frame back and writes it to directory as PNG, or as raw
+		// pixels when raw is set, on the job system's workers
+		void startReadback(const std::string& directory, bool raw);
+		// Records CPU scopes of every thread and GPU ranges of the next frames frames and
+		// writes them to filePath as a Chrome trace, or at exit when that comes first
+		void startTrace(const std::string& filePath, uint32_t frames);
+		// The triangle, Sierpinski meshes and procedural Sierpinski at several depths and a
+		// grid of objects with their own push constants, for LveRegression
+		static std::vector<RegressionScene> regressionScenes();
 
-		FirstApp();
+		// preferredDevice picks the GPU by index or name, see LveDevice
+		explicit FirstApp(const std::string& preferredDevice = "");
 		~FirstApp();
 
 		FirstApp (const FirstApp&) = delete;
 		FirstApp& operator=(const FirstApp&) = delete;
 
 	private:
+		struct ShaderCode
+		{
+			std::vector<char> vert;
+			std::vector<char> frag;
+		};
+		// The triangle, then one Sierpinski mesh per LOD, finest first
+		static std::vector<std::unique_ptr<LveMeshFile>> loadMeshFiles(LveMeshCache::LoadStats* stats);
+		static ShaderCode readSimpleShaders();
+
+		// Positions and scales at the end of one simulation tick and the tick before it,
+		// the renderer draws between the two
+		struct SimulationSnapshot
+		{
+			uint64_t tick = 0;
+			// Seconds since run() started, when this tick was due
+			double time = 0.0;
+			LveScene::Frame previous;
+			LveScene::Frame current;
+		};
+
 		void loadModels();
+		void loadScene();
+		void simulationLoop();
+		void renderLoop();
+		void prepareFrame(uint32_t frameIndex);
+		void morphSierpinski(uint32_t frameIndex);
+		void drawSierpinski(VkCommandBuffer commandBuffer);
+		void createParticles();
+		void reportParticles(uint32_t frameIndex);
+		void createChaosGame();
+		void reportChaosGame(uint32_t frameIndex);
+		void reportReadback();
+		void finishTrace();
+		// Particles, chaos game, scene and readback as far as they are enabled, again whenever
+		// the swap chain or the passes change
+		void buildRenderGraph();
+		void recordParticles(VkCommandBuffer commandBuffer);
+		void recordChaosGame(VkCommandBuffer commandBuffer);
+		void recordScene(VkCommandBuffer commandBuffer);
+		void recordReadback(VkCommandBuffer commandBuffer);
+		void drawInstanced(VkCommandBuffer commandBuffer, size_t packetCount);
+		static uint32_t sierpinskiVertexCount(int depth);
+		double secondsSinceStart() const;
 		void createPipelineLayout();
 		void createPipeline();
-		void createCommandBuffers();
-		void freeCommandBuffers();
+		std::unique_ptr<LvePipeline> makeSimplePipeline(int32_t colorMode, const ShaderCode* code = nullptr, bool depthTest = true);
+		std::unique_ptr<LvePipeline> makeBindlessPipeline();
+		std::unique_ptr<LvePipeline> makeSierpinskiPipeline();
+		void setRenderTarget(PipelineConfigInfo& configInfo);
+		void createShaderWatcher();
+		void swapRebuiltPipelines();
 		void drawFrame();
 		void recreateSwapChain();
-		void recordCommandBuffer(int imageIndex);
+		void recordCommandBuffer(VkCommandBuffer commandBuffer, int imageIndex);
+		void cullScene(LveFrameArena& arena);
+		void buildDrawList(LveFrameArena& arena);
+		void reportMemory();
+
+		// A host visible storage buffer in the bindless table
+		struct BindlessBuffer
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			void* mapped = nullptr;
+			VkDeviceSize size = 0;
+			BindlessHandle handle = LveBindlessTable::INVALID_HANDLE;
+		};
+		void createBindless();
+		void reserveBindlessBuffer(BindlessBuffer& buffer, VkDeviceSize size);
+		void destroyBindlessBuffer(BindlessBuffer& buffer);
+		// Captures store per draw push constants, so they keep to the per draw path
+		bool instancedScene() const { return bindlessPipeline != nullptr && capture == nullptr; }
+
+		// Declared first so they start before the window and device, file reads and
+		// mesh generation run on workers while the instance and device are created
+		LveMeshCache::LoadStats meshStats{};
+		std::future<std::vector<std::unique_ptr<LveMeshFile>>> pendingMeshes = std::async(std::launch::async, loadMeshFiles, &meshStats);
+		std::future<ShaderCode> pendingShaders = std::async(std::launch::async, readSimpleShaders);
 
 		LveWindow lveWindow{ WIDTH, HEIGHT, "Hello Vulkan" };
 		LveDevice lveDevice{ lveWindow };
 		std::unique_ptr<LveSwapChain> lveSwapChain;
-		std::unique_ptr<LvePipeline> lvePipeline;
+		// One pipeline per material, the same shaders with a different COLOR_MODE
+		std::vector<std::unique_ptr<LvePipeline>> pipelines;
 		VkPipelineLayout pipelineLayout;
-		std::vector<VkCommandBuffer> commandBuffers;
-		std::unique_ptr<LveModel> lveModel;
+		VkPipelineLayout sierpinskiLayout;
+		std::unique_ptr<LvePipeline> sierpinskiPipeline;
+		// The tinted material without depth, for the streamed Sierpinski mesh behind the scene
+		std::unique_ptr<LvePipeline> morphPipeline;
+		// With descriptor indexing one pipeline draws every material, the shaders read each
+		// object's offset, scale, color and material through the bindless table, so a run of
+		// the same model is one instanced draw. Without it every object has its own push constants
+		std::unique_ptr<LveBindlessTable> bindless;
+		VkPipelineLayout bindlessLayout = VK_NULL_HANDLE;
+		std::unique_ptr<LvePipeline> bindlessPipeline;
+		std::array<BindlessBuffer, LveSwapChain::MAX_FRAMES_IN_FLIGHT> instanceBuffers;
+		BindlessBuffer materialBuffer;
+		uint32_t instancedDraws = 0;
+		// Reset as a whole once the frame's fence has signaled, instead of buffer by buffer
+		LveFrameCommandPools commandPools{ lveDevice, LveSwapChain::MAX_FRAMES_IN_FLIGHT, lveDevice.findPhysicalQueueFamilies().graphicsFamily };
+		std::vector<std::unique_ptr<LveModel>> models;
+		// Kept mapped after the upload, a capture stores the models by value
+		std::vector<std::unique_ptr<LveMeshFile>> meshFiles;
+		// Only the simulation thread touches simulationScene, scene is the render
+		// thread's copy, interpolated between the snapshots it publishes
+		LveScene simulationScene;
+		LveScene scene;
+		LveTripleBuffer<SimulationSnapshot> snapshots;
+		std::chrono::steady_clock::time_point startTime;
+		std::atomic<bool> running{ true };
+		std::vector<LodGroup> lodGroups;
+		LveCulling::View view;
+		// Transient per frame data, one arena per frame in flight
+		std::array<LveFrameArena, LveSwapChain::MAX_FRAMES_IN_FLIGHT> frameArenas;
+		FrameVector<VisibleObject> visibleObjects;
+		LveCulling::Stats cullStats;
+		LveDrawList drawList;
+
+		// Hot reloaded pipelines replace the live one at a frame boundary, the old one
+		// is kept until every frame that could still be using it has finished
+		struct RetiredPipeline
+		{
+			std::unique_ptr<LvePipeline> pipeline;
+			uint64_t destroyAfterFrame;
+		};
+		std::unique_ptr<LveShaderWatcher> shaderWatcher;
+		std::vector<RetiredPipeline> retiredPipelines;
+		uint64_t frameCount = 0;
+
+		// LVE_MORPH_DEPTH=N draws a Sierpinski triangle of depth N with moving corners behind the
+		// scene. As a mesh (LVE_SIERPINSKI=mesh, the default) it is streamed through a dynamic
+		// model every frame, up to depth 12 which is 797160 vertices. LVE_SIERPINSKI=procedural
+		// draws one full screen triangle instead, the fragment shader finds the removed
+		// triangles per pixel, so depth costs no memory and goes up to 23
+		enum class SierpinskiMode
+		{
+			Mesh,
+			Procedural
+		};
+		static constexpr int MAX_MESH_DEPTH = 12;
+		static constexpr int MAX_PROCEDURAL_DEPTH = 23;
+		SierpinskiMode sierpinskiMode = SierpinskiMode::Mesh;
+		int morphDepth = 0;
+		// left, right and top, in clip space
+		std::array<glm::vec2, 3> morphCorners;
+		std::unique_ptr<LveDynamicModel> morphModel;
+		struct MorphStats
+		{
+			uint32_t frames = 0;
+			double bytes = 0.0;
+			double writeMs = 0.0;
+		} morphStats;
+
+		// LVE_PARTICLES=N simulates N particles with a compute shader, drawn over the scene
+		uint32_t particleCount = 0;
+		std::unique_ptr<LveParticleSystem> particles;
+		double lastParticleStep = 0.0;
+
+		// LVE_CHAOS_POINTS=N splats N chaos game points per frame into a square image of
+		// LVE_CHAOS_RESOLUTION pixels (LveChaosGame::DEFAULT_RESOLUTION), tone mapped behind the scene
+		uint64_t chaosPoints = 0;
+		uint32_t chaosResolution = LveChaosGame::DEFAULT_RESOLUTION;
+		std::unique_ptr<LveChaosGame> chaosGame;
+
+		// Capture pipelines are the materials, then the procedural Sierpinski triangle. The
+		// streamed Sierpinski mesh, particles and chaos game are left out
+		std::unique_ptr<LveFrameCaptureWriter> capture;
+		uint32_t captureFramesLeft = 0;
+
+		// Frames are dropped from the files rather than waited for when the workers fall behind
+		std::unique_ptr<LveReadback> readback;
+		std::string readbackDirectory;
+		bool readbackRaw = false;
+
+		// LVE_RENDER_GRAPH=1 prints the compiled passes and barriers
+		LveRenderGraph renderGraph{ lveDevice };
+		RenderGraphResource graphColor = 0;
+		RenderGraphResource graphDepth = 0;
+		// The swap chain image the graph draws into this frame
+		uint32_t graphImageIndex = 0;
+
+		std::string traceFile;
+		uint32_t traceFramesLeft = 0;
+		LveGpuTrace gpuTrace{ lveDevice, LveSwapChain::MAX_FRAMES_IN_FLIGHT };
+
+		// GPU time of whole frames, one timestamp pair per frame in flight
+		LveGpuTimer frameTimer{ lveDevice, LveSwapChain::MAX_FRAMES_IN_FLIGHT };
+		struct FrameTimes
+		{
+			uint32_t frames = 0;
+			double gpuMs = 0.0;
+		} frameTimes;
+		// Off while benchmarking what is drawn behind the scene
+		bool drawScene = true;
+
+		// LVE_MEMORY_REPORT=console or json prints GPU memory on every frame where it changed
+		std::string memoryReport;
+		// LVE_STATS=1 prints what the frame loop measures every STATS_INTERVAL frames
+		static constexpr uint64_t STATS_INTERVAL = 300;
+		bool printStats = false;
+		bool statsDue() const { return printStats && frameCount % STATS_INTERVAL == 0; }
+		uint64_t reportedMemoryGeneration = ~0ull;
 	};
 }
\ No newline at end of file
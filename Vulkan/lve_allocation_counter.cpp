@@ -0,0 +1,43 @@
+#include "lve_allocation_counter.hpp"
+
+// std
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace lve
+{
+	static thread_local uint64_t allocationCount = 0;
+	static std::atomic<uint64_t> totalAllocationCount{ 0 };
+
+	uint64_t LveAllocationCounter::threadAllocations()
+	{
+		return allocationCount;
+	}
+
+	uint64_t LveAllocationCounter::totalAllocations()
+	{
+		return totalAllocationCount.load(std::memory_order_relaxed);
+	}
+}
+
+// The replaceable forms the others forward to by default: array and nothrow new call
+// these, as do the standard containers. Over-aligned new is not counted
+void* operator new(std::size_t size)
+{
+	++lve::allocationCount;
+	lve::totalAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size == 0 ? 1 : size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+namespace lve
+{
+	// Counts calls to the global operator new, which lve_allocation_counter.cpp replaces.
+	// Counted per thread, so a loop can check it did not allocate without other threads
+	// getting in the way, e.g. around FirstApp::drawFrame. Work it hands to the job system
+	// runs on the workers and only shows up in the total over all threads
+	class LveAllocationCounter
+	{
+	public:
+		// Every allocation the calling thread made so far
+		static uint64_t threadAllocations();
+		// Every allocation any thread made so far
+		static uint64_t totalAllocations();
+	};
+}
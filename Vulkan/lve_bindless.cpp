@@ -0,0 +1,182 @@
+#include "lve_bindless.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+
+namespace lve
+{
+	LveBindlessTable::LveBindlessTable(LveDevice& device, uint32_t maxBuffers, uint32_t maxImages)
+		: lveDevice{ device }
+	{
+		if (!lveDevice.descriptorIndexingEnabled())
+			throw std::runtime_error("Bindless descriptors need VK_EXT_descriptor_indexing");
+
+		// Every stage sees the whole set, so the per stage limits apply as well
+		const auto& limits = lveDevice.descriptorIndexingProperties();
+		buffers.capacity = std::max(1u, std::min({ maxBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+			limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers }));
+		images.capacity = std::max(1u, std::min({ maxImages, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+			limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers,
+			limits.maxPerStageDescriptorUpdateAfterBindSamplers }));
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding = BUFFER_BINDING;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = buffers.capacity;
+		bindings[1].binding = IMAGE_BINDING;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = images.capacity;
+		for (auto& binding : bindings)
+			binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		// Slots nothing reads may be empty or stale, and may be written while the set is in use
+		std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags{};
+		bindingFlags.fill(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT);
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(lveDevice.device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create bindless descriptor set layout");
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[0].descriptorCount = buffers.capacity;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].descriptorCount = images.capacity;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(lveDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create bindless descriptor pool");
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &descriptorSetLayout;
+		if (vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate bindless descriptor set");
+	}
+
+	LveBindlessTable::~LveBindlessTable()
+	{
+		vkDestroyDescriptorPool(lveDevice.device(), descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(lveDevice.device(), descriptorSetLayout, nullptr);
+	}
+
+	BindlessHandle LveBindlessTable::Slots::allocate(const char* kind)
+	{
+		if (!free.empty())
+		{
+			BindlessHandle handle = free.back();
+			free.pop_back();
+			return handle;
+		}
+		if (next == capacity)
+			throw std::runtime_error(std::string("Bindless table is out of ") + kind + " slots");
+		return next++;
+	}
+
+	void LveBindlessTable::Slots::release(BindlessHandle handle, const char* kind)
+	{
+		if (handle >= next)
+			throw std::runtime_error(std::string("Invalid bindless ") + kind + " handle");
+		free.push_back(handle);
+	}
+
+	BindlessHandle LveBindlessTable::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		BindlessHandle handle = buffers.allocate("buffer");
+		writeBuffer(handle, buffer, offset, range);
+		return handle;
+	}
+
+	BindlessHandle LveBindlessTable::addImage(VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		BindlessHandle handle = images.allocate("image");
+		writeImage(handle, imageView, sampler, layout);
+		return handle;
+	}
+
+	void LveBindlessTable::updateBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		if (handle >= buffers.next)
+			throw std::runtime_error("Invalid bindless buffer handle");
+		writeBuffer(handle, buffer, offset, range);
+	}
+
+	void LveBindlessTable::updateImage(BindlessHandle handle, VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		if (handle >= images.next)
+			throw std::runtime_error("Invalid bindless image handle");
+		writeImage(handle, imageView, sampler, layout);
+	}
+
+	// The slot keeps its stale descriptor, which is fine for a partially bound array as long as nothing reads it
+	void LveBindlessTable::removeBuffer(BindlessHandle handle)
+	{
+		buffers.release(handle, "buffer");
+	}
+
+	void LveBindlessTable::removeImage(BindlessHandle handle)
+	{
+		images.release(handle, "image");
+	}
+
+	void LveBindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint, uint32_t set)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
+	}
+
+	void LveBindlessTable::writeBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = buffer;
+		bufferInfo.offset = offset;
+		bufferInfo.range = range;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = BUFFER_BINDING;
+		write.dstArrayElement = handle;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(lveDevice.device(), 1, &write, 0, nullptr);
+	}
+
+	void LveBindlessTable::writeImage(BindlessHandle handle, VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+	{
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = sampler;
+		imageInfo.imageView = imageView;
+		imageInfo.imageLayout = layout;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = IMAGE_BINDING;
+		write.dstArrayElement = handle;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(lveDevice.device(), 1, &write, 0, nullptr);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve
+{
+	using BindlessHandle = uint32_t;
+
+	// One descriptor set with every storage buffer in an array at BUFFER_BINDING and every
+	// texture in an array at IMAGE_BINDING. Shaders index the arrays with handles from push
+	// constants or instance data, so the set is bound once per command buffer instead of
+	// descriptors being bound per draw. The arrays are partially bound and written after
+	// bind: a slot may change while command buffers using the set are pending, as long as
+	// none of them reads that slot. Needs LveDevice::descriptorIndexingEnabled()
+	class LveBindlessTable
+	{
+	public:
+		static constexpr uint32_t BUFFER_BINDING = 0;
+		static constexpr uint32_t IMAGE_BINDING = 1;
+		static constexpr BindlessHandle INVALID_HANDLE = ~0u;
+
+		// Both counts are clamped to the device limits
+		LveBindlessTable(LveDevice& device, uint32_t maxBuffers = 4096, uint32_t maxImages = 4096);
+		~LveBindlessTable();
+
+		LveBindlessTable(const LveBindlessTable&) = delete;
+		LveBindlessTable& operator=(const LveBindlessTable&) = delete;
+
+		BindlessHandle addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		BindlessHandle addImage(VkImageView imageView, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// Points the handle somewhere else, no pending command buffer may still read it
+		void updateBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void updateImage(BindlessHandle handle, VkImageView imageView, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// The handle is handed out again by the next add, so the same goes for these
+		void removeBuffer(BindlessHandle handle);
+		void removeImage(BindlessHandle handle);
+
+		void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS, uint32_t set = 0);
+
+		// For the pipeline layouts of shaders using the table
+		VkDescriptorSetLayout setLayout() const { return descriptorSetLayout; }
+		uint32_t bufferCount() const { return buffers.used(); }
+		uint32_t imageCount() const { return images.used(); }
+		uint32_t maxBuffers() const { return buffers.capacity; }
+		uint32_t maxImages() const { return images.capacity; }
+
+	private:
+		// Handles of one array, removed ones are reused before the array grows
+		struct Slots
+		{
+			uint32_t capacity = 0;
+			uint32_t next = 0;
+			std::vector<BindlessHandle> free;
+
+			BindlessHandle allocate(const char* kind);
+			void release(BindlessHandle handle, const char* kind);
+			uint32_t used() const { return next - static_cast<uint32_t>(free.size()); }
+		};
+
+		void writeBuffer(BindlessHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+		void writeImage(BindlessHandle handle, VkImageView imageView, VkSampler sampler, VkImageLayout layout);
+
+		LveDevice& lveDevice;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		Slots buffers;
+		Slots images;
+	};
+}
@@ -0,0 +1,356 @@
+#include "lve_chaos_game.hpp"
+
+// std
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve
+{
+	// Matches the push constants of chaos.comp
+	struct ChaosPushConstants
+	{
+		glm::vec2 left;
+		glm::vec2 right;
+		glm::vec2 top;
+		uint32_t seed;
+		uint32_t pointsPerInvocation;
+	};
+
+	LveChaosGame::LveChaosGame(LveDevice& device, uint64_t pointsPerFrame, uint32_t resolution, uint32_t timingSlots, VkQueue queue)
+		: lveDevice(device), imageSize(resolution), timer(device, timingSlots)
+	{
+		if (pointsPerFrame == 0)
+			throw std::runtime_error("Chaos game needs at least 1 point per frame");
+		if (resolution == 0 || resolution > lveDevice.properties.limits.maxImageDimension2D)
+			throw std::runtime_error("Chaos game resolution is not supported by the device");
+		if (queue == lveDevice.graphicsQueue())
+			fragmentStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+		// Longer walks per invocation once the points no longer fit the dispatch limit
+		uint64_t maxGroups = lveDevice.properties.limits.maxComputeWorkGroupCount[0];
+		uint64_t pointsPerGroup = static_cast<uint64_t>(WORKGROUP_SIZE) * pointsPerInvocation;
+		while ((pointsPerFrame + pointsPerGroup - 1) / pointsPerGroup > maxGroups)
+		{
+			pointsPerInvocation *= 2;
+			pointsPerGroup *= 2;
+		}
+		groupCount = static_cast<uint32_t>((pointsPerFrame + pointsPerGroup - 1) / pointsPerGroup);
+
+		createImage();
+		createDescriptorSet();
+		createComputePipeline();
+	}
+
+	LveChaosGame::~LveChaosGame()
+	{
+		drawPipeline = nullptr;
+		computePipeline = nullptr;
+		vkDestroyPipelineLayout(lveDevice.device(), drawLayout, nullptr);
+		vkDestroyPipelineLayout(lveDevice.device(), computeLayout, nullptr);
+		vkDestroyDescriptorPool(lveDevice.device(), descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(lveDevice.device(), setLayout, nullptr);
+		vkDestroyBuffer(lveDevice.device(), peakBuffer, nullptr);
+		lveDevice.freeMemory(peakBufferMemory);
+		vkDestroyImageView(lveDevice.device(), countImageView, nullptr);
+		vkDestroyImage(lveDevice.device(), countImage, nullptr);
+		lveDevice.freeMemory(countImageMemory);
+	}
+
+	void LveChaosGame::createImage()
+	{
+		// R32_UINT storage images support atomics on every device
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_UINT;
+		imageInfo.extent = { imageSize, imageSize, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countImage, countImageMemory, MemoryTag::Storage);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = countImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_UINT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &countImageView) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create chaos game image view");
+
+		lveDevice.createBuffer(
+			sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			peakBuffer,
+			peakBufferMemory,
+			MemoryTag::Storage
+		);
+	}
+
+	void LveChaosGame::createDescriptorSet()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(lveDevice.device(), &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create chaos game descriptor set layout");
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 };
+		poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 };
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(lveDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create chaos game descriptor pool");
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &setLayout;
+		if (vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate chaos game descriptor set");
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageView = countImageView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = peakBuffer;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 2> writes{};
+		for (uint32_t i = 0; i < writes.size(); ++i)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = bindings[i].descriptorType;
+		}
+		writes[0].pImageInfo = &imageInfo;
+		writes[1].pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(lveDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void LveChaosGame::createComputePipeline()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ChaosPushConstants);
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &setLayout;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(lveDevice.device(), &layoutInfo, nullptr, &computeLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed creating pipeline layout");
+
+		// local_size_x_id = 0 in chaos.comp
+		SpecializationConstants specialization;
+		specialization.set(0, WORKGROUP_SIZE);
+		computePipeline = std::make_unique<LveComputePipeline>(lveDevice, "shaders/chaos.comp.spv", computeLayout, specialization);
+
+		// The draw only reads the set, the full screen triangle needs no inputs
+		VkPipelineLayoutCreateInfo drawLayoutInfo{};
+		drawLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		drawLayoutInfo.setLayoutCount = 1;
+		drawLayoutInfo.pSetLayouts = &setLayout;
+		if (vkCreatePipelineLayout(lveDevice.device(), &drawLayoutInfo, nullptr, &drawLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed creating pipeline layout");
+	}
+
+	void LveChaosGame::createDrawPipeline(PipelineConfigInfo& configInfo)
+	{
+		if (fragmentStage == 0)
+			throw std::runtime_error("A chaos game on a compute only queue cannot be drawn");
+
+		configInfo.bindingDescriptions.clear();
+		configInfo.attributeDescriptions.clear();
+		configInfo.depthStencilInfo.depthTestEnable = VK_FALSE;
+		configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		configInfo.pipelineLayout = drawLayout;
+
+		drawPipeline = std::make_unique<LvePipeline>(lveDevice, "shaders/fullscreen.vert.spv", "shaders/chaos.frag.spv", configInfo);
+	}
+
+	void LveChaosGame::splat(VkCommandBuffer commandBuffer, const std::array<glm::vec2, 3>& corners, uint32_t seed, int timingSlot, bool barriers)
+	{
+		// Every frame starts from zero, so the old contents are dropped. The last frame's
+		// draw or splat only has to be done with them
+		VkImageMemoryBarrier toClear{};
+		toClear.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toClear.srcAccessMask = 0;
+		toClear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toClear.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		toClear.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		toClear.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toClear.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toClear.image = countImage;
+		toClear.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		if (barriers)
+		{
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | fragmentStage, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &toClear);
+		}
+
+		if (timingSlot >= 0)
+			timer.begin(commandBuffer, timingSlot);
+
+		VkClearColorValue zero{};
+		vkCmdClearColorImage(commandBuffer, countImage, VK_IMAGE_LAYOUT_GENERAL, &zero, 1, &toClear.subresourceRange);
+		vkCmdFillBuffer(commandBuffer, peakBuffer, 0, sizeof(uint32_t), 0);
+
+		VkMemoryBarrier cleared{};
+		cleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &cleared, 0, nullptr, 0, nullptr);
+
+		computePipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &descriptorSet, 0, nullptr);
+		ChaosPushConstants push{ corners[0], corners[1], corners[2], seed, pointsPerInvocation };
+		vkCmdPushConstants(commandBuffer, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+		if (timingSlot >= 0)
+			timer.end(commandBuffer, timingSlot, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		if (barriers && fragmentStage != 0)
+		{
+			VkMemoryBarrier splatted{};
+			splatted.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			splatted.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			splatted.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, fragmentStage,
+				0, 1, &splatted, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	void LveChaosGame::draw(VkCommandBuffer commandBuffer)
+	{
+		if (drawPipeline == nullptr)
+			return;
+
+		drawPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+
+	void LveChaosGame::collectTimings(uint32_t timingSlot)
+	{
+		double ms;
+		if (!timer.collect(timingSlot, ms))
+			return;
+		stats.gpuMs += ms;
+		++stats.frames;
+	}
+
+	LveChaosGame::Stats LveChaosGame::takeStats()
+	{
+		Stats taken = stats;
+		stats = {};
+		return taken;
+	}
+
+	void LveChaosGame::benchmark(const std::string& preferredDevice, uint64_t pointsPerFrame, uint32_t resolution)
+	{
+		// One frame per submission like the windowed path, waited on so the GPU time of each
+		// one is known and nothing queues up behind a slow dispatch
+		constexpr uint32_t warmupFrames = 3;
+		constexpr uint32_t measuredFrames = 30;
+
+		LveDevice device{ preferredDevice };
+		VkQueue queue = device.computeQueue();
+		VkCommandPool commandPool = device.getComputeCommandPool();
+		LveChaosGame game{ device, pointsPerFrame, resolution, 1, queue };
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed allocating command buffers");
+
+		const std::array<glm::vec2, 3> corners{ glm::vec2{ -1.0f, 1.0f }, glm::vec2{ 1.0f, 1.0f }, glm::vec2{ 0.0f, -1.0f } };
+		double wallMs = 0.0;
+		for (uint32_t frame = 0; frame < warmupFrames + measuredFrames; ++frame)
+		{
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			game.splat(commandBuffer, corners, frame, 0);
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to record command buffer");
+
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			auto start = std::chrono::high_resolution_clock::now();
+			if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+				throw std::runtime_error("Failed to submit chaos game frame");
+			vkQueueWaitIdle(queue);
+
+			if (frame < warmupFrames)
+			{
+				game.collectTimings(0);
+				game.takeStats();
+				continue;
+			}
+			wallMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			game.collectTimings(0);
+		}
+
+		double points = static_cast<double>(game.pointsPerFrame());
+		std::cout << "Chaos game on " << device.properties.deviceName << " (headless), " << game.pointsPerFrame() << " points per frame, "
+			<< resolution << "x" << resolution << ", " << measuredFrames << " frames, "
+			<< (queue == device.graphicsQueue() ? "graphics" : "dedicated compute") << " queue\n";
+		std::cout << "  submit to idle: " << wallMs / measuredFrames << "ms per frame, "
+			<< points * measuredFrames / (wallMs / 1000.0) / 1e9 << " billion points per second\n";
+		auto stats = game.takeStats();
+		if (stats.frames > 0)
+		{
+			std::cout << "  GPU timestamps: " << stats.gpuMs / stats.frames << "ms per frame, "
+				<< points * stats.frames / (stats.gpuMs / 1000.0) / 1e9 << " billion points per second\n";
+		}
+		else
+		{
+			std::cout << "  GPU timestamps: not supported on this queue\n";
+		}
+
+		vkFreeCommandBuffers(device.device(), commandPool, 1, &commandBuffer);
+	}
+}
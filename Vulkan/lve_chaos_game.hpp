@@ -0,0 +1,106 @@
+#pragma once
+
+#include "lve_compute_pipeline.hpp"
+#include "lve_device.hpp"
+#include "lve_gpu_timer.hpp"
+#include "lve_pipeline.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lve
+{
+	// The Sierpinski triangle as a point cloud: chaos.comp plays the chaos game, every point
+	// jumps halfway towards a random corner, and counts the hits per pixel of a square r32ui
+	// storage image with atomics. The detail is bound by the point count and resolution, not
+	// by geometry. chaos.frag tone maps the counts against the largest one over the screen
+	class LveChaosGame
+	{
+	public:
+		// What the app and --bench-chaos use unless told otherwise
+		static constexpr uint32_t DEFAULT_RESOLUTION = 1024;
+
+		struct Stats
+		{
+			uint32_t frames = 0;
+			double gpuMs = 0.0;
+		};
+
+		// pointsPerFrame is rounded up to whole workgroups, see pointsPerFrame(). The image is
+		// exclusive to the family of queue, the graphics queue when it is also drawn
+		LveChaosGame(LveDevice& device, uint64_t pointsPerFrame, uint32_t resolution, uint32_t timingSlots, VkQueue queue);
+		~LveChaosGame();
+
+		LveChaosGame(const LveChaosGame&) = delete;
+		LveChaosGame& operator=(const LveChaosGame&) = delete;
+
+		// Only on the graphics queue. configInfo has the render target set, the vertex input,
+		// depth and layout are replaced
+		void createDrawPipeline(PipelineConfigInfo& configInfo);
+
+		// Outside of a render pass. Waits for the last draw, clears the counts and splats the
+		// points of this frame. corners are left, right and top in clip space, seed varies the
+		// random walks between frames. timingSlot < 0 records no timestamps. Without barriers
+		// the caller orders the splat against the draws and moves the image to GENERAL, e.g.
+		// a render graph, only the one between clearing and splatting is recorded
+		void splat(VkCommandBuffer commandBuffer, const std::array<glm::vec2, 3>& corners, uint32_t seed, int timingSlot = -1, bool barriers = true);
+		// Inside a render pass, one full screen triangle showing the last splat
+		void draw(VkCommandBuffer commandBuffer);
+
+		// Adds the GPU time of the last splat timed in this slot, call once its fence has signaled
+		void collectTimings(uint32_t timingSlot);
+		// Returns what collectTimings gathered since the last call
+		Stats takeStats();
+		bool hasTimestamps() const { return timer.available(); }
+
+		uint64_t pointsPerFrame() const { return static_cast<uint64_t>(groupCount) * WORKGROUP_SIZE * pointsPerInvocation; }
+		uint32_t resolution() const { return imageSize; }
+		VkImage image() const { return countImage; }
+
+		// Splats pointsPerFrame points a few dozen times on the compute queue of a headless
+		// device and prints points per second, no window or surface involved
+		static void benchmark(const std::string& preferredDevice, uint64_t pointsPerFrame, uint32_t resolution);
+
+	private:
+		void createImage();
+		void createDescriptorSet();
+		void createComputePipeline();
+
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+
+		LveDevice& lveDevice;
+		uint32_t imageSize;
+		uint32_t pointsPerInvocation = 1024;
+		uint32_t groupCount = 0;
+		// On the graphics queue the counts are also read by the fragment stage, a compute
+		// only queue has no such stage
+		VkPipelineStageFlags fragmentStage = 0;
+
+		// Hits per pixel, and the largest count of the frame in a one uint storage buffer
+		VkImage countImage = VK_NULL_HANDLE;
+		VkDeviceMemory countImageMemory = VK_NULL_HANDLE;
+		VkImageView countImageView = VK_NULL_HANDLE;
+		VkBuffer peakBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory peakBufferMemory = VK_NULL_HANDLE;
+
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+		std::unique_ptr<LveComputePipeline> computePipeline;
+
+		VkPipelineLayout drawLayout = VK_NULL_HANDLE;
+		std::unique_ptr<LvePipeline> drawPipeline;
+
+		LveGpuTimer timer;
+		Stats stats;
+	};
+}
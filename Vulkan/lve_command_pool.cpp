@@ -0,0 +1,186 @@
+#include "lve_command_pool.hpp"
+
+#include "lve_job_system.hpp"
+
+// std
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve
+{
+	LveCommandPool::LveCommandPool(LveDevice& device, uint32_t queueFamilyIndex) : lveDevice{ device }
+	{
+		// No RESET_COMMAND_BUFFER_BIT, buffers are only ever reset with the whole pool
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndex;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create command pool");
+	}
+
+	LveCommandPool::~LveCommandPool()
+	{
+		// Frees the buffers with it
+		vkDestroyCommandPool(lveDevice.device(), commandPool, nullptr);
+	}
+
+	VkCommandBuffer LveCommandPool::allocate(VkCommandBufferLevel level)
+	{
+		Level& buffers = levels[level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1];
+		if (buffers.used == buffers.buffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = level;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed allocating command buffers");
+			buffers.buffers.push_back(commandBuffer);
+		}
+		return buffers.buffers[buffers.used++];
+	}
+
+	void LveCommandPool::reset()
+	{
+		if (levels[0].used == 0 && levels[1].used == 0)
+			return;
+		// The memory stays with the pool, the next round records into it again
+		if (vkResetCommandPool(lveDevice.device(), commandPool, 0) != VK_SUCCESS)
+			throw std::runtime_error("Failed to reset command pool");
+		for (auto& level : levels)
+			level.used = 0;
+	}
+
+	void LveCommandPool::benchmark(const std::string& preferredDevice, uint32_t commandBuffers)
+	{
+		// Nothing is submitted, only the CPU side of getting a buffer ready and recording it
+		constexpr uint32_t rounds = 100;
+		constexpr uint32_t commandsPerBuffer = 16;
+
+		LveDevice device{ preferredDevice };
+		uint32_t queueFamily = device.findPhysicalQueueFamilies().graphicsFamily;
+
+		auto record = [](VkCommandBuffer commandBuffer)
+		{
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			for (uint32_t i = 0; i < commandsPerBuffer; ++i)
+			{
+				vkCmdPipelineBarrier(commandBuffer,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					0, 1, &barrier, 0, nullptr, 0, nullptr);
+			}
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to record command buffer");
+		};
+
+		auto measure = [&](const char* name, auto round)
+		{
+			round();
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < rounds; ++i)
+				round();
+			double us = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+			std::cout << "  " << name << us / (static_cast<double>(rounds) * commandBuffers) << "us per buffer\n";
+		};
+
+		std::cout << "Command recording on " << device.properties.deviceName << ", " << commandBuffers << " buffers of "
+			<< commandsPerBuffer << " commands, " << rounds << " rounds\n";
+
+		// What beginSingleTimeCommands used to do
+		{
+			LveCommandPool pool{ device, queueFamily };
+			measure("allocate and free each buffer: ", [&]
+				{
+					for (uint32_t i = 0; i < commandBuffers; ++i)
+					{
+						VkCommandBufferAllocateInfo allocInfo{};
+						allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+						allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+						allocInfo.commandPool = pool.pool();
+						allocInfo.commandBufferCount = 1;
+						VkCommandBuffer commandBuffer;
+						vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer);
+						record(commandBuffer);
+						vkFreeCommandBuffers(device.device(), pool.pool(), 1, &commandBuffer);
+					}
+				});
+		}
+
+		// What recordCommandBuffer used to do, begin implicitly resets the buffer
+		{
+			std::vector<VkCommandBuffer> buffers(commandBuffers);
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = device.getCommandPool();
+			allocInfo.commandBufferCount = commandBuffers;
+			if (vkAllocateCommandBuffers(device.device(), &allocInfo, buffers.data()) != VK_SUCCESS)
+				throw std::runtime_error("Failed allocating command buffers");
+			measure("reset each buffer:            ", [&]
+				{
+					for (auto commandBuffer : buffers)
+						record(commandBuffer);
+				});
+			vkFreeCommandBuffers(device.device(), device.getCommandPool(), commandBuffers, buffers.data());
+		}
+
+		{
+			LveCommandPool pool{ device, queueFamily };
+			measure("reset the whole pool:         ", [&]
+				{
+					pool.reset();
+					for (uint32_t i = 0; i < commandBuffers; ++i)
+						record(pool.allocate());
+				});
+		}
+
+		{
+			auto& jobs = LveJobSystem::get();
+			std::vector<std::unique_ptr<LveCommandPool>> pools;
+			for (uint32_t i = 0; i < jobs.threadCount(); ++i)
+				pools.push_back(std::make_unique<LveCommandPool>(device, queueFamily));
+			std::string name = "one pool per thread (" + std::to_string(jobs.threadCount()) + "):  ";
+			measure(name.c_str(), [&]
+				{
+					for (auto& pool : pools)
+						pool->reset();
+					jobs.parallelFor(commandBuffers, 8, [&](size_t begin, size_t end)
+						{
+							LveCommandPool& pool = *pools[jobs.threadIndex()];
+							for (size_t i = begin; i < end; ++i)
+								record(pool.allocate());
+						});
+				});
+		}
+	}
+
+	LveFrameCommandPools::LveFrameCommandPools(LveDevice& device, uint32_t frameCount, uint32_t queueFamilyIndex)
+		: threadCount{ LveJobSystem::get().threadCount() }
+	{
+		for (uint32_t i = 0; i < frameCount * threadCount; ++i)
+			pools.push_back(std::make_unique<LveCommandPool>(device, queueFamilyIndex));
+	}
+
+	void LveFrameCommandPools::beginFrame(uint32_t frameIndex)
+	{
+		currentFrame = frameIndex;
+		for (uint32_t thread = 0; thread < threadCount; ++thread)
+			pools[frameIndex * threadCount + thread]->reset();
+	}
+
+	LveCommandPool& LveFrameCommandPools::threadPool()
+	{
+		return *pools[currentFrame * threadCount + LveJobSystem::get().threadIndex()];
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve
+{
+	// A VkCommandPool whose command buffers are recycled all at once. allocate hands out
+	// buffers from earlier rounds before it allocates new ones, reset makes every one of
+	// them available again with a single vkResetCommandPool instead of resetting or freeing
+	// them one by one. Like any command pool it belongs to one thread at a time
+	class LveCommandPool
+	{
+	public:
+		LveCommandPool(LveDevice& device, uint32_t queueFamilyIndex);
+		~LveCommandPool();
+
+		LveCommandPool(const LveCommandPool&) = delete;
+		LveCommandPool& operator=(const LveCommandPool&) = delete;
+
+		// Not begun yet, valid until the next reset
+		VkCommandBuffer allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		// Only once the GPU is done with every buffer handed out since the last reset
+		void reset();
+
+		VkCommandPool pool() const { return commandPool; }
+		// Buffers the pool keeps, handed out or not
+		size_t capacity() const { return levels[0].buffers.size() + levels[1].buffers.size(); }
+
+		// Records commandBuffers buffers many times over, allocating and freeing each one,
+		// resetting each one and resetting a whole LveCommandPool, on one thread and then one
+		// pool per job system thread. Prints the CPU time per buffer, needs no window
+		static void benchmark(const std::string& preferredDevice, uint32_t commandBuffers);
+
+	private:
+		struct Level
+		{
+			std::vector<VkCommandBuffer> buffers;
+			size_t used = 0;
+		};
+
+		LveDevice& lveDevice;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		// Indexed by VkCommandBufferLevel
+		std::array<Level, 2> levels;
+	};
+
+	// One LveCommandPool per frame in flight and per job system thread. beginFrame resets
+	// the pools of a frame, which is only allowed once its fence has signaled. Worker
+	// threads each record into their own pool, every thread outside the job system shares
+	// the last one, so only one of them may record per frame
+	class LveFrameCommandPools
+	{
+	public:
+		LveFrameCommandPools(LveDevice& device, uint32_t frameCount, uint32_t queueFamilyIndex);
+
+		void beginFrame(uint32_t frameIndex);
+		// The calling thread's pool in the frame of the last beginFrame
+		LveCommandPool& threadPool();
+
+	private:
+		uint32_t threadCount;
+		uint32_t currentFrame = 0;
+		// frame * threadCount + thread
+		std::vector<std::unique_ptr<LveCommandPool>> pools;
+	};
+}
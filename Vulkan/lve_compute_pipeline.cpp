@@ -0,0 +1,66 @@
+#include "lve_compute_pipeline.hpp"
+
+#include "lve_trace.hpp"
+
+// std
+#include <stdexcept>
+
+namespace lve
+{
+	LveComputePipeline::LveComputePipeline(LveDevice& device, const std::string& compFilePath,
+		VkPipelineLayout pipelineLayout, const SpecializationConstants& specialization, VkPipelineCache pipelineCache)
+		: lveDevice(device)
+	{
+		createComputePipeline(LvePipeline::readFile(compFilePath), pipelineLayout, specialization, pipelineCache);
+	}
+
+	LveComputePipeline::LveComputePipeline(LveDevice& device, const std::vector<char>& compCode,
+		VkPipelineLayout pipelineLayout, const SpecializationConstants& specialization, VkPipelineCache pipelineCache)
+		: lveDevice(device)
+	{
+		createComputePipeline(compCode, pipelineLayout, specialization, pipelineCache);
+	}
+
+	LveComputePipeline::~LveComputePipeline()
+	{
+		vkDestroyShaderModule(lveDevice.device(), compShaderModule, nullptr);
+		vkDestroyPipeline(lveDevice.device(), computePipeline, nullptr);
+	}
+
+	void LveComputePipeline::bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
+
+	void LveComputePipeline::createComputePipeline(
+		const std::vector<char>& compCode, VkPipelineLayout pipelineLayout,
+		const SpecializationConstants& specialization, VkPipelineCache pipelineCache)
+	{
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = compCode.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+		if (vkCreateShaderModule(lveDevice.device(), &moduleInfo, nullptr, &compShaderModule) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create Shader Module");
+
+		VkSpecializationInfo specializationInfo = specialization.info();
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.stage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (pipelineCache == VK_NULL_HANDLE)
+			pipelineCache = lveDevice.getPipelineCache();
+
+		LVE_TRACE_SCOPE("createComputePipeline");
+		if (vkCreateComputePipelines(lveDevice.device(), pipelineCache, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create compute pipeline!");
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+// std
+#include <string>
+#include <vector>
+
+namespace lve
+{
+	// A single compute shader stage, the counterpart of LvePipeline for dispatches.
+	// The layout is owned by the caller, like PipelineConfigInfo::pipelineLayout
+	class LveComputePipeline
+	{
+	public:
+		// A null pipelineCache means the cache shared through LveDevice
+		LveComputePipeline(
+			LveDevice& device,
+			const std::string& compFilePath,
+			VkPipelineLayout pipelineLayout,
+			const SpecializationConstants& specialization = {},
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE
+		);
+		LveComputePipeline(
+			LveDevice& device,
+			const std::vector<char>& compCode,
+			VkPipelineLayout pipelineLayout,
+			const SpecializationConstants& specialization = {},
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE
+		);
+		~LveComputePipeline();
+
+		LveComputePipeline(const LveComputePipeline&) = delete;
+		LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+	private:
+		void createComputePipeline(
+			const std::vector<char>& compCode, VkPipelineLayout pipelineLayout,
+			const SpecializationConstants& specialization, VkPipelineCache pipelineCache
+		);
+
+		LveDevice& lveDevice;
+		VkPipeline computePipeline;
+		VkShaderModule compShaderModule;
+	};
+}
@@ -0,0 +1,146 @@
+#include "lve_culling.hpp"
+
+#include "lve_job_system.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LVE_CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+
+// std
+#include <algorithm>
+#include <chrono>
+
+namespace lve
+{
+	void LveCulling::cull(
+		const LveScene& scene, const std::vector<LodGroup>& lodGroups, const View& view,
+		FrameVector<VisibleObject>& visible, Stats& stats)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		visible.clear();
+		stats = {};
+
+		// Below this splitting the work costs more than it saves
+		constexpr size_t minObjectsPerChunk = 32768;
+		const size_t count = scene.size();
+		auto& jobs = LveJobSystem::get();
+		size_t chunkCount = std::min<size_t>(jobs.threadCount() * 4, count / minObjectsPerChunk);
+		if (chunkCount <= 1)
+			cullRange(scene, lodGroups, view, 0, count, visible, stats);
+		else
+		{
+			// Each chunk fills its own list, appended in order so the result matches a serial pass.
+			// Kept per calling thread so steady frames do not allocate
+			struct Chunk
+			{
+				FrameVector<VisibleObject> visible;
+				Stats stats;
+			};
+			static thread_local std::vector<Chunk> scratch;
+			// A reference, the workers would otherwise see their own thread_local
+			auto& chunks = scratch;
+			chunks.resize(chunkCount);
+
+			// Multiples of 4 keep every chunk but the last on the SSE path
+			size_t chunkSize = ((count + chunkCount - 1) / chunkCount + 3) & ~size_t(3);
+			jobs.parallelFor(chunkCount, 1, [&](size_t first, size_t last)
+				{
+					for (size_t c = first; c < last; ++c)
+					{
+						chunks[c].visible.clear();
+						chunks[c].stats = {};
+						size_t begin = std::min(count, c * chunkSize);
+						cullRange(scene, lodGroups, view, begin, std::min(count, begin + chunkSize), chunks[c].visible, chunks[c].stats);
+					}
+				});
+
+			for (const auto& chunk : chunks)
+			{
+				visible.insert(visible.end(), chunk.visible.begin(), chunk.visible.end());
+				for (size_t level = 0; level < MAX_LODS; ++level)
+					stats.drawnPerLod[level] += chunk.stats.drawnPerLod[level];
+			}
+		}
+
+		stats.tested = static_cast<uint32_t>(count);
+		stats.drawn = static_cast<uint32_t>(visible.size());
+		stats.culled = stats.tested - stats.drawn;
+		stats.cullMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void LveCulling::cullRange(
+		const LveScene& scene, const std::vector<LodGroup>& lodGroups, const View& view,
+		size_t begin, size_t end, FrameVector<VisibleObject>& visible, Stats& stats)
+	{
+		const float* positionsX = scene.positionsX();
+		const float* positionsY = scene.positionsY();
+		const float* scales = scene.scaleData();
+
+		// Bounding circles against the view rectangle, conservative in the corners
+		const float minX = view.center.x - view.halfExtent;
+		const float maxX = view.center.x + view.halfExtent;
+		const float minY = view.center.y - view.halfExtent;
+		const float maxY = view.center.y + view.halfExtent;
+
+		auto radiusOf = [&](size_t i) { return scales[i] * lodGroups[scene.lodGroup(i)].boundingRadius; };
+		auto keep = [&](size_t i, float radius)
+		{
+			visible.push_back({ static_cast<uint32_t>(i), selectLod(lodGroups[scene.lodGroup(i)], radius, view, stats) });
+		};
+
+		size_t i = begin;
+#if LVE_CULLING_SSE
+		const __m128 viewMinX = _mm_set1_ps(minX);
+		const __m128 viewMaxX = _mm_set1_ps(maxX);
+		const __m128 viewMinY = _mm_set1_ps(minY);
+		const __m128 viewMaxY = _mm_set1_ps(maxY);
+
+		for (; i + 4 <= end; i += 4)
+		{
+			// The radius depends on the model, the only part that is gathered
+			__m128 radius = _mm_mul_ps(_mm_loadu_ps(scales + i), _mm_setr_ps(
+				lodGroups[scene.lodGroup(i)].boundingRadius,
+				lodGroups[scene.lodGroup(i + 1)].boundingRadius,
+				lodGroups[scene.lodGroup(i + 2)].boundingRadius,
+				lodGroups[scene.lodGroup(i + 3)].boundingRadius));
+			__m128 x = _mm_loadu_ps(positionsX + i);
+			__m128 y = _mm_loadu_ps(positionsY + i);
+
+			__m128 inside = _mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(x, radius), viewMinX), _mm_cmple_ps(_mm_sub_ps(x, radius), viewMaxX)),
+				_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(y, radius), viewMinY), _mm_cmple_ps(_mm_sub_ps(y, radius), viewMaxY)));
+
+			int mask = _mm_movemask_ps(inside);
+			if (mask == 0)
+				continue;
+
+			alignas(16) float radii[4];
+			_mm_store_ps(radii, radius);
+			for (int lane = 0; lane < 4; ++lane)
+				if (mask & (1 << lane))
+					keep(i + lane, radii[lane]);
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			float radius = radiusOf(i);
+			if (positionsX[i] + radius >= minX && positionsX[i] - radius <= maxX &&
+				positionsY[i] + radius >= minY && positionsY[i] - radius <= maxY)
+				keep(i, radius);
+		}
+	}
+
+	ModelHandle LveCulling::selectLod(const LodGroup& group, float radius, const View& view, Stats& stats)
+	{
+		// Diameter in pixels, the view spans viewportHeight pixels vertically
+		float pixels = radius * view.viewportHeight / view.halfExtent;
+
+		size_t level = 0;
+		while (level + 1 < group.levels.size() && pixels < group.levels[level].minPixels)
+			++level;
+
+		stats.drawnPerLod[std::min(level, MAX_LODS - 1)]++;
+		return group.levels[level].model;
+	}
+}
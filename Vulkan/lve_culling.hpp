@@ -0,0 +1,74 @@
+#pragma once
+
+#include "lve_frame_arena.hpp"
+#include "lve_scene.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace lve
+{
+	// The models a scene object's LodGroupHandle can be drawn with, finest first. A level is used while the
+	// object covers at least minPixels on screen, the last level catches everything smaller
+	struct LodGroup
+	{
+		struct Level
+		{
+			ModelHandle model;
+			float minPixels;
+		};
+
+		std::vector<Level> levels;
+		// Around the model origin, in model units, enough to contain every level
+		float boundingRadius = 1.0f;
+	};
+
+	struct VisibleObject
+	{
+		uint32_t object;
+		ModelHandle model;
+	};
+
+	// Tests every scene object against the view and picks its LOD by projected area, between
+	// the scene update and command recording
+	class LveCulling
+	{
+	public:
+		static constexpr size_t MAX_LODS = 8;
+
+		// The part of the world shown on screen, FirstApp maps it onto clip space
+		struct View
+		{
+			glm::vec2 center{ 0.0f, 0.0f };
+			float halfExtent = 1.0f;
+			float viewportHeight = 600.0f;
+		};
+
+		struct Stats
+		{
+			uint32_t tested = 0;
+			uint32_t culled = 0;
+			uint32_t drawn = 0;
+			std::array<uint32_t, MAX_LODS> drawnPerLod{};
+			double cullMs = 0.0;
+		};
+
+		// Scene LOD group handles index lodGroups, visible gets the ModelHandle of the chosen level. visible is cleared first, reserving scene.size()
+		// in it up front means it never grows
+		static void cull(
+			const LveScene& scene, const std::vector<LodGroup>& lodGroups, const View& view,
+			FrameVector<VisibleObject>& visible, Stats& stats);
+
+	private:
+		// Appends the visible objects of [begin, end) and counts them per LOD, the other stats are left alone
+		static void cullRange(
+			const LveScene& scene, const std::vector<LodGroup>& lodGroups, const View& view,
+			size_t begin, size_t end, FrameVector<VisibleObject>& visible, Stats& stats);
+		static ModelHandle selectLod(const LodGroup& group, float radius, const View& view, Stats& stats);
+	};
+}
@@ -1,7 +1,13 @@
 #include "lve_device.hpp"
 
+#include "lve_startup_trace.hpp"
+
 // std headers
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -48,16 +54,35 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-LveDevice::LveDevice(LveWindow &window) : window{window} {
-  createInstance();
-  setupDebugMessenger();
-  createSurface();
-  pickPhysicalDevice();
-  createLogicalDevice();
-  createCommandPool();
+LveDevice::LveDevice(LveWindow &window, std::string preferredDevice)
+    : window{&window}, preferredDevice{std::move(preferredDevice)} {
+  initialize();
+}
+
+LveDevice::LveDevice(std::string preferredDevice) : preferredDevice{std::move(preferredDevice)} {
+  initialize();
+}
+
+void LveDevice::initialize() {
+  auto traced = [](const char *name, auto step) {
+    LveStartupTrace::Phase phase{name};
+    step();
+  };
+  traced("createInstance", [this] { createInstance(); });
+  traced("setupDebugMessenger", [this] { setupDebugMessenger(); });
+  traced("createSurface", [this] { createSurface(); });
+  traced("pickPhysicalDevice", [this] { pickPhysicalDevice(); });
+  traced("createLogicalDevice", [this] { createLogicalDevice(); });
+  traced("createCommandPool", [this] { createCommandPool(); });
+  traced("createPipelineCache", [this] { createPipelineCache(); });
 }
 
 LveDevice::~LveDevice() {
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache, nullptr);
+  if (computeCommandPool != commandPool) {
+    vkDestroyCommandPool(device_, computeCommandPool, nullptr);
+  }
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -65,7 +90,9 @@ LveDevice::~LveDevice() {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface_, nullptr);
+  }
   vkDestroyInstance(instance, nullptr);
 }
 
@@ -80,7 +107,8 @@ void LveDevice::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.1 for vkGetPhysicalDeviceMemoryProperties2, used to query memory budgets
+  appInfo.apiVersion = VK_API_VERSION_1_1;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -119,19 +147,166 @@ void LveDevice::pickPhysicalDevice() {
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
+  std::vector<PhysicalDeviceCandidate> candidates;
   for (const auto &device : devices) {
-    if (isDeviceSuitable(device)) {
-      physicalDevice = device;
-      break;
-    }
+    candidates.push_back(describePhysicalDevice(device));
+  }
+
+  std::string preferred = preferredDevice;
+  if (preferred.empty()) {
+    const char *fromEnvironment = std::getenv("LVE_DEVICE");
+    preferred = fromEnvironment != nullptr ? fromEnvironment : "";
   }
 
-  if (physicalDevice == VK_NULL_HANDLE) {
+  PhysicalDeviceSelection selection = selectPhysicalDevice(candidates, preferred);
+  for (size_t i = 0; i < candidates.size(); i++) {
+    std::cout << "  [" << i << "] " << candidates[i].name << ": "
+              << (selection.scores[i] < 0 ? std::string("unsuitable") : "score " + std::to_string(selection.scores[i]))
+              << (static_cast<int>(i) == selection.index ? "  <- selected" : "") << std::endl;
+  }
+
+  if (selection.index < 0) {
     throw std::runtime_error("failed to find a suitable GPU!");
   }
+  physicalDevice = devices[selection.index];
 
   vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-  std::cout << "physical device: " << properties.deviceName << std::endl;
+  std::cout << "physical device: " << properties.deviceName << " (" << selection.reason << ")" << std::endl;
+}
+
+PhysicalDeviceCandidate LveDevice::describePhysicalDevice(VkPhysicalDevice device) {
+  PhysicalDeviceCandidate candidate{};
+
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  candidate.name = deviceProperties.deviceName;
+  candidate.type = deviceProperties.deviceType;
+  candidate.maxImageDimension2D = deviceProperties.limits.maxImageDimension2D;
+  candidate.suitable = isDeviceSuitable(device);
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      candidate.deviceLocalHeapSize =
+          std::max(candidate.deviceLocalHeapSize, memoryProperties.memoryHeaps[i].size);
+    }
+  }
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+  for (const auto &queueFamily : queueFamilies) {
+    bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+    bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+    if (compute && !graphics) {
+      candidate.asyncComputeQueue = true;
+    }
+    if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !graphics && !compute) {
+      candidate.dedicatedTransferQueue = true;
+    }
+  }
+
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(device, &features);
+  for (VkBool32 feature :
+       {features.geometryShader,
+        features.tessellationShader,
+        features.multiDrawIndirect,
+        features.fillModeNonSolid,
+        features.wideLines,
+        features.largePoints,
+        features.pipelineStatisticsQuery,
+        features.fragmentStoresAndAtomics,
+        features.shaderInt64}) {
+    candidate.optionalFeatureCount += feature ? 1 : 0;
+  }
+
+  return candidate;
+}
+
+// The device type dominates, a discrete GPU beats an integrated one whatever their
+// memory, the rest only orders devices of the same type
+int64_t LveDevice::scorePhysicalDevice(const PhysicalDeviceCandidate &candidate) {
+  if (!candidate.suitable) {
+    return -1;
+  }
+
+  // Types are this far apart, more than everything below can add up to (at most 16384 for
+  // memory, 1000 for queues, 100 per optional feature and 64 for the image size)
+  constexpr int64_t typeStep = 100000;
+  int64_t score = 0;
+  switch (candidate.type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      score += 4 * typeStep;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      score += 3 * typeStep;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      score += 2 * typeStep;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      score += typeStep;
+      break;
+    default:
+      break;
+  }
+
+  // One point per 64 MiB, up to 1 TiB
+  score += static_cast<int64_t>(std::min<VkDeviceSize>(candidate.deviceLocalHeapSize >> 26, 16384));
+  score += candidate.dedicatedTransferQueue ? 500 : 0;
+  score += candidate.asyncComputeQueue ? 500 : 0;
+  score += 100 * static_cast<int64_t>(candidate.optionalFeatureCount);
+  score += std::min<uint32_t>(candidate.maxImageDimension2D / 1024, 64);
+  return score;
+}
+
+PhysicalDeviceSelection LveDevice::selectPhysicalDevice(
+    const std::vector<PhysicalDeviceCandidate> &candidates, const std::string &preferredDevice) {
+  PhysicalDeviceSelection selection{};
+  for (const auto &candidate : candidates) {
+    selection.scores.push_back(scorePhysicalDevice(candidate));
+  }
+
+  if (!preferredDevice.empty()) {
+    int preferred = -1;
+    bool isIndex = std::all_of(
+        preferredDevice.begin(), preferredDevice.end(), [](unsigned char c) { return std::isdigit(c); });
+    if (isIndex) {
+      preferred = std::atoi(preferredDevice.c_str());
+    } else {
+      auto lower = [](std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+          return static_cast<char>(std::tolower(c));
+        });
+        return text;
+      };
+      for (size_t i = 0; i < candidates.size() && preferred < 0; i++) {
+        if (lower(candidates[i].name).find(lower(preferredDevice)) != std::string::npos) {
+          preferred = static_cast<int>(i);
+        }
+      }
+    }
+
+    if (preferred >= 0 && preferred < static_cast<int>(candidates.size()) && selection.scores[preferred] >= 0) {
+      selection.index = preferred;
+      selection.reason = "requested \"" + preferredDevice + "\"";
+      return selection;
+    }
+    std::cerr << "Requested device \"" << preferredDevice
+              << "\" not found or not suitable, using the best scoring one" << std::endl;
+  }
+
+  // Ties keep enumeration order, like the old first suitable device rule
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (selection.scores[i] >= 0 && (selection.index < 0 || selection.scores[i] > selection.scores[selection.index])) {
+      selection.index = static_cast<int>(i);
+    }
+  }
+  selection.reason = "highest score";
+  return selection;
 }
 
 void LveDevice::createLogicalDevice() {
@@ -139,6 +314,9 @@ void LveDevice::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  if (indices.computeFamilyHasValue) {
+    uniqueQueueFamilies.insert(indices.computeFamily);
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -159,9 +337,91 @@ void LveDevice::createLogicalDevice() {
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+  // Memory budgets are nice to have, the tracker falls back to heap sizes without them
+  std::vector<const char *> enabledExtensions = requiredDeviceExtensions();
+  bool memoryBudgetSupported = hasDeviceExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (memoryBudgetSupported) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+
+  // Pipelines and command recording can then do without VkRenderPass and VkFramebuffer. On a
+  // 1.1 instance the extension needs VK_KHR_depth_stencil_resolve and VK_KHR_create_renderpass2
+  // enabled as well, whose own dependencies are core in 1.1
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  if (hasDeviceExtension(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+      hasDeviceExtension(physicalDevice, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+      hasDeviceExtension(physicalDevice, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME) &&
+      std::getenv("LVE_LEGACY_RENDER_PASS") == nullptr) {
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    dynamicRendering = dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+  }
+  if (dynamicRendering) {
+    enabledExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+    enabledExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+    enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    createInfo.pNext = &dynamicRenderingFeatures;
+  }
+
+  // One large, partially bound descriptor array that is written while bound, for LveBindlessTable
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+  descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  if (hasDeviceExtension(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+      std::getenv("LVE_NO_BINDLESS") == nullptr) {
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported{};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &supported;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    // Indexing the arrays with anything but a constant also needs the core dynamic indexing features
+    descriptorIndexing = features.features.shaderStorageBufferArrayDynamicIndexing == VK_TRUE &&
+                         features.features.shaderSampledImageArrayDynamicIndexing == VK_TRUE &&
+                         supported.runtimeDescriptorArray == VK_TRUE &&
+                         supported.descriptorBindingPartiallyBound == VK_TRUE &&
+                         supported.descriptorBindingUpdateUnusedWhilePending == VK_TRUE &&
+                         supported.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE &&
+                         supported.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE;
+
+    // Only what the table needs, non uniform indexing when there is for per instance textures
+    descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing =
+        supported.shaderStorageBufferArrayNonUniformIndexing;
+    descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing =
+        supported.shaderSampledImageArrayNonUniformIndexing;
+  }
+  if (descriptorIndexing) {
+    deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    descriptorIndexingFeatures.pNext = const_cast<void *>(createInfo.pNext);
+    createInfo.pNext = &descriptorIndexingFeatures;
+
+    descriptorIndexingProperties_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &descriptorIndexingProperties_;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+    descriptorIndexingProperties_.pNext = nullptr;
+  }
+
+  // Puts GPU timestamps on the CPU clock for traces
+  bool calibratedTimestampsSupported =
+      hasDeviceExtension(physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+  if (calibratedTimestampsSupported) {
+    enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+  }
+
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -178,6 +438,75 @@ void LveDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  computeQueue_ = graphicsQueue_;
+  if (indices.computeFamilyHasValue) {
+    vkGetDeviceQueue(device_, indices.computeFamily, 0, &computeQueue_);
+  }
+
+  memoryTracker.init(physicalDevice, memoryBudgetSupported);
+
+  if (dynamicRendering) {
+    beginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+        vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+    endRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+        vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+    dynamicRendering = beginRendering != nullptr && endRendering != nullptr;
+  }
+  std::cout << "Rendering path: " << (dynamicRendering ? "dynamic rendering" : "render pass") << std::endl;
+  std::cout << "Descriptors: " << (descriptorIndexing ? "bindless" : "per draw") << std::endl;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  if (indices.graphicsFamily < familyCount && families[indices.graphicsFamily].timestampValidBits > 0) {
+    timestampValidBits_ = families[indices.graphicsFamily].timestampValidBits;
+  }
+
+  if (calibratedTimestampsSupported) {
+    auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+    uint32_t domainCount = 0;
+    std::vector<VkTimeDomainEXT> domains;
+    if (getTimeDomains != nullptr && getTimeDomains(physicalDevice, &domainCount, nullptr) == VK_SUCCESS) {
+      domains.resize(domainCount);
+      getTimeDomains(physicalDevice, &domainCount, domains.data());
+      domains.resize(domainCount);
+    }
+    // Only the clocks steady_clock is built on, each platform offers one of them
+    bool hasDeviceDomain = false;
+    for (VkTimeDomainEXT domain : domains) {
+      if (domain == VK_TIME_DOMAIN_DEVICE_EXT) {
+        hasDeviceDomain = true;
+      } else if (domain == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT ||
+                 domain == VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT) {
+        hostTimeDomain_ = domain;
+      }
+    }
+    if (hasDeviceDomain && hostTimeDomain_ != VK_TIME_DOMAIN_DEVICE_EXT) {
+      getCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+          vkGetDeviceProcAddr(device_, "vkGetCalibratedTimestampsEXT"));
+    }
+  }
+}
+
+bool LveDevice::sampleCalibratedTimestamps(
+    uint64_t &deviceTicks, uint64_t &hostTicks, uint64_t &maxDeviation) {
+  if (getCalibratedTimestamps == nullptr) {
+    return false;
+  }
+  VkCalibratedTimestampInfoEXT infos[2]{};
+  infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+  infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[1].timeDomain = hostTimeDomain_;
+  uint64_t timestamps[2];
+  if (getCalibratedTimestamps(device_, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS) {
+    return false;
+  }
+  deviceTicks = timestamps[0];
+  hostTicks = timestamps[1];
+  return true;
 }
 
 void LveDevice::createCommandPool() {
@@ -192,17 +521,72 @@ void LveDevice::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+
+  computeCommandPool = commandPool;
+  if (queueFamilyIndices.computeFamilyHasValue &&
+      queueFamilyIndices.computeFamily != queueFamilyIndices.graphicsFamily) {
+    poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create compute command pool!");
+    }
+  }
 }
 
-void LveDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+// One cache shared by every pipeline build, it is internally synchronized so worker
+// threads can create pipelines against it concurrently. It is persisted between runs.
+void LveDevice::createPipelineCache() {
+  std::vector<char> initialData;
+  std::ifstream file(pipelineCachePath, std::ios::ate | std::ios::binary);
+  if (file.is_open()) {
+    initialData.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(initialData.data(), initialData.size());
+  }
+
+  // The header carries the pipelineCacheUUID, data from another driver or device is dropped
+  const size_t headerSize = 16 + VK_UUID_SIZE;
+  if (initialData.size() < headerSize ||
+      memcmp(initialData.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    initialData.clear();
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = initialData.size();
+  cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+void LveDevice::savePipelineCache() {
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+    return;
+  }
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device_, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  std::ofstream file(pipelineCachePath, std::ios::binary | std::ios::trunc);
+  file.write(data.data(), dataSize);
+}
+
+void LveDevice::createSurface() {
+  if (window != nullptr) {
+    window->createWindowSurface(instance, &surface_);
+  }
+}
 
 bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  bool swapChainAdequate = isHeadless();
+  if (extensionsSupported && !isHeadless()) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -262,11 +646,13 @@ bool LveDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> LveDevice::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+  if (window != nullptr) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -309,7 +695,8 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
       &extensionCount,
       availableExtensions.data());
 
-  std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+  std::vector<const char *> required = requiredDeviceExtensions();
+  std::set<std::string> requiredExtensions(required.begin(), required.end());
 
   for (const auto &extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
@@ -318,6 +705,32 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+std::vector<const char *> LveDevice::requiredDeviceExtensions() const {
+  if (window == nullptr) {
+    return {};
+  }
+  return deviceExtensions;
+}
+
+bool LveDevice::hasDeviceExtension(VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -334,7 +747,12 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
       indices.graphicsFamilyHasValue = true;
     }
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    if (surface_ != VK_NULL_HANDLE) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    } else {
+      // Nothing is presented headless, the graphics family stands in
+      presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+    }
     if (queueFamily.queueCount > 0 && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
@@ -346,6 +764,28 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    const auto &properties = queueFamilies[family];
+    if (properties.queueCount == 0 || !(properties.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+      continue;
+    }
+    if (indices.graphicsFamilyHasValue && family == indices.graphicsFamily) {
+      indices.graphicsFamilySupportsCompute = true;
+    }
+    bool dedicated = !(properties.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+    if (!indices.computeFamilyHasValue || dedicated) {
+      indices.computeFamily = family;
+      indices.computeFamilyHasValue = true;
+    }
+  }
+  // No dedicated family, keep compute on the graphics queue rather than another graphics family
+  if (indices.graphicsFamilySupportsCompute) {
+    const auto &properties = queueFamilies[indices.computeFamily];
+    if (properties.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      indices.computeFamily = indices.graphicsFamily;
+    }
+  }
+
   return indices;
 }
 
@@ -404,12 +844,47 @@ uint32_t LveDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags pr
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+VkMemoryPropertyFlags LveDevice::memoryTypeProperties(
+    uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return memProperties.memoryTypes[i].propertyFlags;
+    }
+  }
+  return 0;
+}
+
+uint32_t LveDevice::bufferMemoryTypeBits(VkDeviceSize size, VkBufferUsageFlags usage) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer buffer;
+  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create buffer!");
+  }
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
+  vkDestroyBuffer(device_, buffer, nullptr);
+  return memRequirements.memoryTypeBits;
+}
+
 void LveDevice::createBuffer(
     VkDeviceSize size,
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    VkDeviceMemory &bufferMemory,
+    MemoryTag tag) {
+  if (tag == MemoryTag::Unknown) {
+    tag = LveMemoryTracker::tagForBufferUsage(usage);
+  }
+
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -428,22 +903,29 @@ void LveDevice::createBuffer(
   allocInfo.allocationSize = memRequirements.size;
   allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
+  memoryTracker.fitsInBudget(allocInfo.memoryTypeIndex, allocInfo.allocationSize, tag);
   if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
     throw std::runtime_error("failed to allocate vertex buffer memory!");
   }
+  memoryTracker.onAllocate(bufferMemory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, tag);
 
   vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
 
 VkCommandBuffer LveDevice::beginSingleTimeCommands() {
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool;
-  allocInfo.commandBufferCount = 1;
-
   VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+  if (!singleTimeCommandBuffers.empty()) {
+    // commandPool has RESET_COMMAND_BUFFER_BIT, begin resets it
+    commandBuffer = singleTimeCommandBuffers.back();
+    singleTimeCommandBuffers.pop_back();
+  } else {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+    vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+  }
 
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -464,7 +946,7 @@ void LveDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
   vkQueueWaitIdle(graphicsQueue_);
 
-  vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+  singleTimeCommandBuffers.push_back(commandBuffer);
 }
 
 void LveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -510,26 +992,50 @@ void LveDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    VkDeviceMemory &imageMemory,
+    MemoryTag tag) {
+  if (tag == MemoryTag::Unknown) {
+    tag = LveMemoryTracker::tagForImageUsage(imageInfo.usage);
+  }
+
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
 
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
+  allocateMemory(memRequirements, properties, imageMemory, tag);
+
+  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind image memory!");
+  }
+}
 
+void LveDevice::allocateMemory(
+    const VkMemoryRequirements &requirements,
+    VkMemoryPropertyFlags properties,
+    VkDeviceMemory &memory,
+    MemoryTag tag) {
   VkMemoryAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
+  memoryTracker.fitsInBudget(allocInfo.memoryTypeIndex, allocInfo.allocationSize, tag);
+  if (vkAllocateMemory(device_, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate memory!");
   }
+  memoryTracker.onAllocate(memory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, tag);
+}
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
-  }
+void LveDevice::freeMemory(VkDeviceMemory memory) {
+  memoryTracker.onFree(memory);
+  vkFreeMemory(device_, memory, nullptr);
+}
+
+bool LveDevice::fitsInBudget(VkDeviceSize size, VkMemoryPropertyFlags properties, MemoryTag tag) {
+  // Any memory type with these properties lives on the same heap in practice
+  return memoryTracker.fitsInBudget(findMemoryType(~0u, properties), size, tag);
 }
 
 }  // namespace lve
\ No newline at end of file
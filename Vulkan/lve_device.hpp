@@ -1,5 +1,6 @@
 #pragma once
 
+#include "lve_memory_tracker.hpp"
 #include "lve_window.hpp"
 
 // std lib headers
@@ -14,11 +15,36 @@ struct SwapChainSupportDetails {
   std::vector<VkPresentModeKHR> presentModes;
 };
 
+// What device selection needs to know about one physical device. Filled from Vulkan
+// queries in pickPhysicalDevice, or by hand to check the scoring against made up devices
+struct PhysicalDeviceCandidate {
+  std::string name;
+  VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+  VkDeviceSize deviceLocalHeapSize = 0;  // largest DEVICE_LOCAL heap
+  bool suitable = false;                 // graphics + present queues, swapchain, required features
+  bool dedicatedTransferQueue = false;
+  bool asyncComputeQueue = false;
+  uint32_t optionalFeatureCount = 0;
+  uint32_t maxImageDimension2D = 0;
+};
+
+struct PhysicalDeviceSelection {
+  int index = -1;
+  std::vector<int64_t> scores;  // one per candidate, -1 for unsuitable ones
+  std::string reason;
+};
+
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // A family without graphics when there is one, so compute can run alongside rendering,
+  // otherwise the graphics family
+  uint32_t computeFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool computeFamilyHasValue = false;
+  // Compute can then be recorded into the same command buffers as the draws
+  bool graphicsFamilySupportsCompute = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -30,7 +56,12 @@ class LveDevice {
   const bool enableValidationLayers = true;
 #endif
 
-  LveDevice(lve::LveWindow &window);
+  // preferredDevice is a device index or part of its name, empty falls back to the
+  // LVE_DEVICE environment variable and then to the best scoring device
+  LveDevice(lve::LveWindow &window, std::string preferredDevice = "");
+  // Headless, for compute and offscreen work: no surface, swapchain or present queue, the
+  // present queue is the graphics queue. Needs no glfwInit
+  explicit LveDevice(std::string preferredDevice);
   ~LveDevice();
 
   // Not copyable or movable
@@ -42,22 +73,39 @@ class LveDevice {
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
+  bool isHeadless() const { return window == nullptr; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  // May be the graphics queue, pools and queues are not shared between threads
+  VkQueue computeQueue() { return computeQueue_; }
+  VkCommandPool getComputeCommandPool() { return computeCommandPool; }
+  VkPipelineCache getPipelineCache() { return pipelineCache; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  // Every flag of the type findMemoryType picks, e.g. whether a HOST_VISIBLE type is also
+  // HOST_COHERENT, or 0 when there is no such type
+  VkMemoryPropertyFlags memoryTypeProperties(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  // The memory types a buffer created with these could be bound to, the typeFilter to probe
+  // with before picking its properties. Buffers that differ only in size share them
+  uint32_t bufferMemoryTypeBits(VkDeviceSize size, VkBufferUsageFlags usage);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
   // Buffer Helper Functions
+  // Memory from createBuffer and createImageWithInfo is tracked, release it with freeMemory.
+  // Without a tag it is derived from the usage flags
   void createBuffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      VkDeviceMemory &bufferMemory,
+      MemoryTag tag = MemoryTag::Unknown);
+  // The buffers are kept and reused, endSingleTimeCommands waits for the queue anyway.
+  // Neither the reuse list nor the graphics queue submit is locked: only safe while no
+  // other thread submits, i.e. during setup or with the device idle, never from workers
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -68,41 +116,106 @@ class LveDevice {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      VkDeviceMemory &imageMemory,
+      MemoryTag tag = MemoryTag::Unknown);
+  // For memory that several resources are bound to, e.g. aliased images
+  void allocateMemory(
+      const VkMemoryRequirements &requirements,
+      VkMemoryPropertyFlags properties,
+      VkDeviceMemory &memory,
+      MemoryTag tag);
+  void freeMemory(VkDeviceMemory memory);
+
+  // Lets a caller reject a load up front instead of finding out from the driver
+  bool fitsInBudget(VkDeviceSize size, VkMemoryPropertyFlags properties, MemoryTag tag = MemoryTag::Unknown);
+  MemoryStats memoryStats() const { return memoryTracker.snapshot(); }
+  uint64_t memoryGeneration() const { return memoryTracker.generation(); }
+
+  // VK_KHR_dynamic_rendering, used when the device has it unless LVE_LEGACY_RENDER_PASS is set
+  bool dynamicRenderingEnabled() const { return dynamicRendering; }
+  void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR *renderingInfo) {
+    beginRendering(commandBuffer, renderingInfo);
+  }
+  void cmdEndRendering(VkCommandBuffer commandBuffer) { endRendering(commandBuffer); }
+
+  // VK_EXT_descriptor_indexing with partially bound, update after bind, dynamically indexed
+  // storage buffer and sampled image arrays, used when the device has it unless LVE_NO_BINDLESS is set
+  bool descriptorIndexingEnabled() const { return descriptorIndexing; }
+  const VkPhysicalDeviceDescriptorIndexingPropertiesEXT &descriptorIndexingProperties() const {
+    return descriptorIndexingProperties_;
+  }
+
+  // VK_EXT_calibrated_timestamps, when the device can sample its timestamp counter together
+  // with the CPU clock steady_clock reads
+  bool calibratedTimestampsEnabled() const { return getCalibratedTimestamps != nullptr; }
+  VkTimeDomainEXT hostTimeDomain() const { return hostTimeDomain_; }
+  // The device's timestamp counter and hostTimeDomain() at the same instant, give or take
+  // maxDeviation nanoseconds
+  bool sampleCalibratedTimestamps(uint64_t &deviceTicks, uint64_t &hostTicks, uint64_t &maxDeviation);
+  // Bits of a timestamp written on the graphics queue, the counter wraps above them
+  uint32_t timestampValidBits() const { return timestampValidBits_; }
+
+  // Pure functions of the candidate list, so they work without a Vulkan instance
+  static int64_t scorePhysicalDevice(const PhysicalDeviceCandidate &candidate);
+  static PhysicalDeviceSelection selectPhysicalDevice(
+      const std::vector<PhysicalDeviceCandidate> &candidates, const std::string &preferredDevice);
 
   VkPhysicalDeviceProperties properties;
 
  private:
+  void initialize();
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
+  void savePipelineCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
+  PhysicalDeviceCandidate describePhysicalDevice(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
   bool checkValidationLayerSupport();
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool hasDeviceExtension(VkPhysicalDevice device, const char *extensionName);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  lve::LveWindow &window;
+  lve::LveWindow *window = nullptr;
   VkCommandPool commandPool;
+  std::vector<VkCommandBuffer> singleTimeCommandBuffers;
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+  std::string preferredDevice;
+  LveMemoryTracker memoryTracker;
+  bool dynamicRendering = false;
+  PFN_vkCmdBeginRenderingKHR beginRendering = nullptr;
+  PFN_vkCmdEndRenderingKHR endRendering = nullptr;
+  bool descriptorIndexing = false;
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties_{};
+  PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps = nullptr;
+  VkTimeDomainEXT hostTimeDomain_ = VK_TIME_DOMAIN_DEVICE_EXT;
+  uint32_t timestampValidBits_ = 64;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue computeQueue_;
+  // The graphics pool when compute shares its family
+  VkCommandPool computeCommandPool;
 
+  const char *pipelineCachePath = "pipeline_cache.bin";
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // Headless devices need none of the above
+  std::vector<const char *> requiredDeviceExtensions() const;
 };
 
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "lve_draw_list.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+
+namespace lve
+{
+	uint64_t LveDrawList::makeKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t model, float depth)
+	{
+		uint64_t quantizedDepth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * 0xFFFFFF);
+		return (uint64_t(pipeline & 0xFFF) << 52) |
+			(uint64_t(descriptorSet & 0xFFF) << 40) |
+			(uint64_t(model & 0xFFFF) << 24) |
+			quantizedDepth;
+	}
+
+	void LveDrawList::clear(LveFrameArena& arena)
+	{
+		size_t expected = entries.size();
+		packets = FrameVector<DrawPacket>(LveArenaAllocator<DrawPacket>(arena));
+		entries = FrameVector<Entry>(LveArenaAllocator<Entry>(arena));
+		scratch = FrameVector<Entry>(LveArenaAllocator<Entry>(arena));
+		packets.reserve(expected);
+		entries.reserve(expected);
+		scratch.reserve(expected);
+	}
+
+	void LveDrawList::add(uint64_t key, const DrawPacket& packet)
+	{
+		entries.push_back({ key, static_cast<uint32_t>(packets.size()) });
+		packets.push_back(packet);
+	}
+
+	void LveDrawList::sort()
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		scratch.resize(entries.size());
+
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			const int shift = pass * 8;
+			uint32_t counts[256] = {};
+			for (const auto& entry : entries)
+				counts[(entry.key >> shift) & 0xFF]++;
+
+			// Every key has the same byte here, this pass would only copy
+			if (!entries.empty() && counts[(entries[0].key >> shift) & 0xFF] == entries.size())
+				continue;
+
+			uint32_t offsets[256];
+			uint32_t offset = 0;
+			for (int bucket = 0; bucket < 256; ++bucket)
+			{
+				offsets[bucket] = offset;
+				offset += counts[bucket];
+			}
+
+			for (const auto& entry : entries)
+				scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+			entries.swap(scratch);
+		}
+
+		lastSortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	LveDrawList::BindStats LveDrawList::countBinds() const
+	{
+		BindStats stats{};
+		stats.draws = static_cast<uint32_t>(entries.size());
+		stats.sortMs = lastSortMs;
+
+		auto count = [](uint32_t value, uint32_t& last, uint32_t& binds)
+		{
+			if (value != last)
+			{
+				last = value;
+				binds++;
+			}
+		};
+
+		uint32_t lastPipeline = ~0u, lastModel = ~0u;
+		for (const auto& entry : entries)
+		{
+			const auto& packet = packets[entry.packet];
+			count(packet.pipeline, lastPipeline, stats.pipelineBinds);
+			// A pipeline change does not unbind the vertex buffers, only a model change rebinds them
+			count(packet.model, lastModel, stats.modelBinds);
+		}
+
+		lastPipeline = ~0u;
+		lastModel = ~0u;
+		for (const auto& packet : packets)
+		{
+			count(packet.pipeline, lastPipeline, stats.unsortedPipelineBinds);
+			count(packet.model, lastModel, stats.unsortedModelBinds);
+		}
+		return stats;
+	}
+}
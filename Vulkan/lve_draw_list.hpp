@@ -0,0 +1,66 @@
+#pragma once
+
+#include "lve_frame_arena.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve
+{
+	// One draw, what to bind and which scene object supplies the push constants
+	struct DrawPacket
+	{
+		uint32_t pipeline;
+		uint32_t model;
+		uint32_t object;
+	};
+
+	// Draws collected for a frame and sorted by state, so consecutive draws share binds.
+	// Key layout, most significant first:
+	//   pipeline 12 bits | descriptor set 12 bits | model 16 bits | depth 24 bits
+	class LveDrawList
+	{
+	public:
+		struct BindStats
+		{
+			uint32_t draws = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t modelBinds = 0;
+			// What submission order would have needed, to see the savings
+			uint32_t unsortedPipelineBinds = 0;
+			uint32_t unsortedModelBinds = 0;
+			double sortMs = 0.0;
+		};
+
+		// depth is 0 (near) to 1 (far), front to back within the same state
+		static uint64_t makeKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t model, float depth);
+
+		// Empties the list and moves its storage into arena, with room for as many draws
+		// as last time, so steady frames neither touch the heap nor grow
+		void clear(LveFrameArena& arena);
+		void add(uint64_t key, const DrawPacket& packet);
+
+		// Stable LSD radix sort on the keys, byte passes that cannot change the order are skipped
+		void sort();
+
+		size_t size() const { return entries.size(); }
+		const DrawPacket& operator[](size_t i) const { return packets[entries[i].packet]; }
+
+		// Counts binds for the sorted and the submission order, call after sort
+		BindStats countBinds() const;
+
+	private:
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t packet;
+		};
+
+		FrameVector<DrawPacket> packets;
+		FrameVector<Entry> entries;
+		FrameVector<Entry> scratch;
+		double lastSortMs = 0.0;
+	};
+}
@@ -0,0 +1,95 @@
+#include "lve_dynamic_model.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve
+{
+	LveDynamicModel::LveDynamicModel(LveDevice& device, uint32_t maxVertexCount, uint32_t regionCount)
+		: lveDevice(device), maxVertexCount(maxVertexCount), regionCount(std::max(1u, regionCount))
+	{
+		if (maxVertexCount < 3)
+			throw std::runtime_error("Vertex Count has to be at least 3");
+
+		VkDeviceSize atom = std::max<VkDeviceSize>(1, lveDevice.properties.limits.nonCoherentAtomSize);
+		VkDeviceSize bytes = static_cast<VkDeviceSize>(maxVertexCount) * sizeof(LveModel::Vertex);
+		regionSize = (bytes + atom - 1) / atom * atom;
+
+		// Device local and host visible (integrated GPUs, resizable BAR) spares the GPU reading over
+		// the bus every frame, plain host visible memory always exists. Only types a vertex buffer
+		// can use count, on some devices the device local host visible ones cannot hold one
+		VkDeviceSize size = regionSize * this->regionCount;
+		uint32_t typeBits = lveDevice.bufferMemoryTypeBits(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		if (lveDevice.memoryTypeProperties(typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+			properties |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		lveDevice.createBuffer(
+			size,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			properties,
+			buffer,
+			memory,
+			MemoryTag::Vertex
+		);
+
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(lveDevice.device(), buffer, &requirements);
+		VkMemoryPropertyFlags actual = lveDevice.memoryTypeProperties(requirements.memoryTypeBits, properties);
+		coherent = (actual & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		deviceLocal = (actual & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+
+		// Stays mapped for the lifetime of the model, mapping every frame costs a driver call
+		void* pointer;
+		if (vkMapMemory(lveDevice.device(), memory, 0, VK_WHOLE_SIZE, 0, &pointer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to map dynamic vertex buffer");
+		mapped = static_cast<uint8_t*>(pointer);
+	}
+
+	LveDynamicModel::~LveDynamicModel()
+	{
+		vkUnmapMemory(lveDevice.device(), memory);
+		vkDestroyBuffer(lveDevice.device(), buffer, nullptr);
+		lveDevice.freeMemory(memory);
+	}
+
+	LveModel::Vertex* LveDynamicModel::beginWrite(uint32_t region)
+	{
+		writeRegion = region % regionCount;
+		return reinterpret_cast<LveModel::Vertex*>(mapped + writeRegion * regionSize);
+	}
+
+	void LveDynamicModel::endWrite(uint32_t count)
+	{
+		vertexCount = std::min(count, maxVertexCount);
+		drawRegion = writeRegion;
+
+		if (!coherent && vertexCount > 0)
+		{
+			// Whole atoms only, the region size is a multiple of the atom so this stays inside it
+			VkDeviceSize atom = std::max<VkDeviceSize>(1, lveDevice.properties.limits.nonCoherentAtomSize);
+			VkDeviceSize size = (lastWriteBytes() + atom - 1) / atom * atom;
+
+			VkMappedMemoryRange range{};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = memory;
+			range.offset = drawRegion * regionSize;
+			range.size = size;
+			vkFlushMappedMemoryRanges(lveDevice.device(), 1, &range);
+		}
+	}
+
+	void LveDynamicModel::bind(VkCommandBuffer commandBuffer)
+	{
+		VkBuffer buffers[] = { buffer };
+		VkDeviceSize offsets[] = { drawRegion * regionSize };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	}
+
+	void LveDynamicModel::draw(VkCommandBuffer commandBuffer)
+	{
+		if (vertexCount > 0)
+			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_model.hpp"
+
+// std
+#include <cstdint>
+
+namespace lve
+{
+	// Vertices rewritten every frame. One buffer holds a region per frame in flight and stays
+	// mapped, so the CPU writes frame N's region while the GPU still reads frame N-1's,
+	// without staging copies or reallocating. Prefers memory that is both device local and
+	// host visible, and flushes what was written when that memory is not coherent.
+	class LveDynamicModel
+	{
+	public:
+		LveDynamicModel(LveDevice& device, uint32_t maxVertexCount, uint32_t regionCount);
+		~LveDynamicModel();
+
+		LveDynamicModel(const LveDynamicModel&) = delete;
+		LveDynamicModel& operator=(const LveDynamicModel&) = delete;
+
+		// region is the frame in flight slot whose fence has signaled, the GPU is done with it.
+		// Returns room for maxVertexCount vertices, write only, the memory may be uncached
+		LveModel::Vertex* beginWrite(uint32_t region);
+		// Flushes the vertexCount vertices written when needed, bind and draw then use them
+		void endWrite(uint32_t vertexCount);
+
+		void bind(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer);
+
+		bool isCoherent() const { return coherent; }
+		bool isDeviceLocal() const { return deviceLocal; }
+		uint32_t capacity() const { return maxVertexCount; }
+		// Every region together, what the model costs in GPU memory
+		VkDeviceSize bufferSize() const { return regionSize * regionCount; }
+		// Bytes written by the last endWrite
+		VkDeviceSize lastWriteBytes() const { return static_cast<VkDeviceSize>(vertexCount) * sizeof(LveModel::Vertex); }
+
+	private:
+		LveDevice& lveDevice;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		uint8_t* mapped = nullptr;
+
+		uint32_t maxVertexCount;
+		uint32_t regionCount;
+		// Multiple of nonCoherentAtomSize, so flushes of one region never touch the next
+		VkDeviceSize regionSize;
+		bool coherent = false;
+		bool deviceLocal = false;
+
+		uint32_t writeRegion = 0;
+		uint32_t drawRegion = 0;
+		uint32_t vertexCount = 0;
+	};
+}
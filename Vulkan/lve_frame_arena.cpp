@@ -0,0 +1,41 @@
+#include "lve_frame_arena.hpp"
+
+// std
+#include <algorithm>
+
+namespace lve
+{
+	LveFrameArena::LveFrameArena(size_t capacity)
+		: block{ std::make_unique<std::byte[]>(capacity) }, blockSize{ capacity }
+	{
+	}
+
+	void* LveFrameArena::allocate(size_t size, size_t alignment)
+	{
+		// The block comes from new[], aligned for any fundamental type, so aligning the offset is enough
+		size_t start = (offset + alignment - 1) & ~(alignment - 1);
+		if (start + size <= blockSize)
+		{
+			offset = start + size;
+			return block.get() + start;
+		}
+
+		overflow.push_back(std::make_unique<std::byte[]>(size));
+		overflowBytes += size + alignment;
+		return overflow.back().get();
+	}
+
+	void LveFrameArena::reset()
+	{
+		if (!overflow.empty())
+		{
+			// Half again what the frame needed, so a slowly growing frame does not overflow every time
+			size_t needed = offset + overflowBytes;
+			blockSize = std::max(blockSize, needed + needed / 2);
+			block = std::make_unique<std::byte[]>(blockSize);
+			overflow.clear();
+			overflowBytes = 0;
+		}
+		offset = 0;
+	}
+}
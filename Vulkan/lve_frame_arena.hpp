@@ -0,0 +1,87 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace lve
+{
+	// Bump allocator for data that only lives for one frame. Allocating is moving a pointer,
+	// nothing is freed on its own and reset() releases everything at once. FirstApp keeps one
+	// per frame in flight and resets it once the fence of that frame has signaled.
+	class LveFrameArena
+	{
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+		explicit LveFrameArena(size_t capacity = DEFAULT_CAPACITY);
+
+		LveFrameArena(const LveFrameArena&) = delete;
+		LveFrameArena& operator=(const LveFrameArena&) = delete;
+
+		void* allocate(size_t size, size_t alignment);
+		// Forgets every allocation. If the last frame overflowed into extra blocks the main
+		// block grows to fit them, so only the first frames that need more touch the heap
+		void reset();
+
+		size_t used() const { return offset + overflowBytes; }
+		size_t capacity() const { return blockSize; }
+
+	private:
+		std::unique_ptr<std::byte[]> block;
+		size_t blockSize;
+		size_t offset = 0;
+		// Allocations that did not fit, freed by the next reset
+		std::vector<std::unique_ptr<std::byte[]>> overflow;
+		size_t overflowBytes = 0;
+	};
+
+	// Standard allocator on top of a frame arena. deallocate does nothing, memory comes back
+	// with the arena's reset. Without an arena it uses the heap, so containers using it also
+	// work outside of a frame
+	template<typename T>
+	class LveArenaAllocator
+	{
+	public:
+		using value_type = T;
+		// Moving or swapping a container takes the arena along with the storage
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		LveArenaAllocator() = default;
+		explicit LveArenaAllocator(LveFrameArena& arena) : arena{ &arena } {}
+		template<typename U>
+		LveArenaAllocator(const LveArenaAllocator<U>& other) : arena{ other.arena } {}
+
+		T* allocate(size_t count)
+		{
+			if (arena == nullptr)
+				return static_cast<T*>(::operator new(count * sizeof(T)));
+			return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* pointer, size_t)
+		{
+			if (arena == nullptr)
+				::operator delete(pointer);
+		}
+
+		template<typename U>
+		bool operator==(const LveArenaAllocator<U>& other) const { return arena == other.arena; }
+		template<typename U>
+		bool operator!=(const LveArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	private:
+		template<typename U>
+		friend class LveArenaAllocator;
+
+		LveFrameArena* arena = nullptr;
+	};
+
+	template<typename T>
+	using FrameVector = std::vector<T, LveArenaAllocator<T>>;
+}
@@ -0,0 +1,433 @@
+#include "lve_frame_capture.hpp"
+
+#include "lve_allocation_counter.hpp"
+#include "lve_command_pool.hpp"
+#include "lve_gpu_timer.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve
+{
+	template<typename T>
+	static void writeValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static void writeString(std::ofstream& file, const std::string& text)
+	{
+		writeValue(file, static_cast<uint32_t>(text.size()));
+		file.write(text.data(), text.size());
+	}
+
+	// Reads from a whole file in memory and throws instead of running past its end
+	class CaptureReader
+	{
+	public:
+		explicit CaptureReader(std::vector<char> bytes) : bytes{ std::move(bytes) } {}
+
+		// Counts come from the file, so whatever they size is checked against what is left
+		// before it is allocated
+		void expect(uint64_t size) const
+		{
+			if (size > bytes.size() - position)
+				throw std::runtime_error("Capture file is truncated");
+		}
+
+		void read(void* destination, size_t size)
+		{
+			expect(size);
+			std::memcpy(destination, bytes.data() + position, size);
+			position += size;
+		}
+
+		template<typename T>
+		T value()
+		{
+			T result;
+			read(&result, sizeof(T));
+			return result;
+		}
+
+		std::string string()
+		{
+			uint32_t size = value<uint32_t>();
+			expect(size);
+			std::string text(size, '\0');
+			read(text.data(), text.size());
+			return text;
+		}
+
+	private:
+		std::vector<char> bytes;
+		size_t position = 0;
+	};
+
+	LveFrameCaptureWriter::LveFrameCaptureWriter(const std::string& filePath, VkExtent2D extent, const float clearColor[4])
+		: file{ filePath, std::ios::binary | std::ios::trunc }
+	{
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open capture file: " + filePath);
+
+		header.magic = CaptureFileHeader::MAGIC;
+		header.version = CaptureFileHeader::VERSION;
+		header.width = extent.width;
+		header.height = extent.height;
+		std::copy(clearColor, clearColor + 4, header.clearColor);
+		header.vertexStride = sizeof(LveModel::Vertex);
+	}
+
+	LveFrameCaptureWriter::~LveFrameCaptureWriter()
+	{
+		writeResources();
+		file.seekp(0);
+		writeValue(file, header);
+	}
+
+	uint32_t LveFrameCaptureWriter::addModel(const LveModel::MeshView& mesh)
+	{
+		if (resourcesWritten)
+			throw std::runtime_error("Capture models have to be added before the first frame");
+
+		std::vector<uint8_t> bytes(2 * sizeof(uint32_t) + mesh.vertexCount * sizeof(LveModel::Vertex) + mesh.indexCount * sizeof(uint32_t));
+		uint8_t* out = bytes.data();
+		std::memcpy(out, &mesh.vertexCount, sizeof(uint32_t));
+		std::memcpy(out + sizeof(uint32_t), &mesh.indexCount, sizeof(uint32_t));
+		out += 2 * sizeof(uint32_t);
+		if (mesh.vertexCount > 0)
+			std::memcpy(out, mesh.vertices, mesh.vertexCount * sizeof(LveModel::Vertex));
+		out += mesh.vertexCount * sizeof(LveModel::Vertex);
+		if (mesh.indexCount > 0)
+			std::memcpy(out, mesh.indices, mesh.indexCount * sizeof(uint32_t));
+
+		models.push_back(std::move(bytes));
+		return header.modelCount++;
+	}
+
+	uint32_t LveFrameCaptureWriter::addPipeline(const CapturedPipeline& pipeline)
+	{
+		if (resourcesWritten)
+			throw std::runtime_error("Capture pipelines have to be added before the first frame");
+		pipelines.push_back(pipeline);
+		return header.pipelineCount++;
+	}
+
+	void LveFrameCaptureWriter::writeResources()
+	{
+		if (resourcesWritten)
+			return;
+		resourcesWritten = true;
+
+		// Rewritten with the final frame count when the capture ends
+		writeValue(file, header);
+		for (const auto& model : models)
+			file.write(reinterpret_cast<const char*>(model.data()), model.size());
+		for (const auto& pipeline : pipelines)
+		{
+			writeString(file, pipeline.vertFilePath);
+			writeString(file, pipeline.fragFilePath);
+			writeValue(file, pipeline.colorMode);
+			writeValue(file, pipeline.pushConstantSize);
+			writeValue(file, static_cast<uint32_t>(pipeline.pushConstantStages));
+			writeValue(file, static_cast<uint32_t>((pipeline.vertexInput ? 1u : 0u) | (pipeline.depthTest ? 2u : 0u)));
+		}
+		models.clear();
+	}
+
+	void LveFrameCaptureWriter::beginFrame()
+	{
+		writeResources();
+		frame.draws.clear();
+		frame.pushData.clear();
+	}
+
+	void LveFrameCaptureWriter::draw(uint32_t pipeline, uint32_t model, uint32_t vertexCount, const void* pushData, uint32_t pushSize)
+	{
+		CapturedDraw draw{ pipeline, model, vertexCount, static_cast<uint32_t>(frame.pushData.size()), pushSize };
+		frame.draws.push_back(draw);
+		auto bytes = static_cast<const uint8_t*>(pushData);
+		frame.pushData.insert(frame.pushData.end(), bytes, bytes + pushSize);
+	}
+
+	void LveFrameCaptureWriter::endFrame()
+	{
+		writeValue(file, static_cast<uint32_t>(frame.draws.size()));
+		writeValue(file, static_cast<uint32_t>(frame.pushData.size()));
+		file.write(reinterpret_cast<const char*>(frame.draws.data()), frame.draws.size() * sizeof(CapturedDraw));
+		file.write(reinterpret_cast<const char*>(frame.pushData.data()), frame.pushData.size());
+		++header.frameCount;
+	}
+
+	LveFrameCaptureFile LveFrameCaptureFile::load(const std::string& filePath)
+	{
+		CaptureReader reader{ LvePipeline::readFile(filePath) };
+		LveFrameCaptureFile capture;
+		capture.header = reader.value<CaptureFileHeader>();
+		if (capture.header.magic != CaptureFileHeader::MAGIC || capture.header.version != CaptureFileHeader::VERSION)
+			throw std::runtime_error("Not a capture file of this version: " + filePath);
+		if (capture.header.vertexStride != sizeof(LveModel::Vertex))
+			throw std::runtime_error("Capture was made with another vertex layout: " + filePath);
+
+		// Every model starts with its two counts
+		reader.expect(uint64_t{ capture.header.modelCount } * 2 * sizeof(uint32_t));
+		capture.models.resize(capture.header.modelCount);
+		for (auto& model : capture.models)
+		{
+			uint32_t vertexCount = reader.value<uint32_t>();
+			uint32_t indexCount = reader.value<uint32_t>();
+			reader.expect(uint64_t{ vertexCount } * sizeof(LveModel::Vertex) + uint64_t{ indexCount } * sizeof(uint32_t));
+			model.vertices.resize(vertexCount);
+			model.indices.resize(indexCount);
+			reader.read(model.vertices.data(), model.vertices.size() * sizeof(LveModel::Vertex));
+			reader.read(model.indices.data(), model.indices.size() * sizeof(uint32_t));
+		}
+
+		// Two string lengths and four values
+		reader.expect(uint64_t{ capture.header.pipelineCount } * 6 * sizeof(uint32_t));
+		capture.pipelines.resize(capture.header.pipelineCount);
+		for (auto& pipeline : capture.pipelines)
+		{
+			pipeline.vertFilePath = reader.string();
+			pipeline.fragFilePath = reader.string();
+			pipeline.colorMode = reader.value<int32_t>();
+			pipeline.pushConstantSize = reader.value<uint32_t>();
+			pipeline.pushConstantStages = reader.value<uint32_t>();
+			uint32_t flags = reader.value<uint32_t>();
+			pipeline.vertexInput = (flags & 1u) != 0;
+			pipeline.depthTest = (flags & 2u) != 0;
+		}
+
+		// Checked once here, so a replay can index without checking every draw
+		reader.expect(uint64_t{ capture.header.frameCount } * 2 * sizeof(uint32_t));
+		capture.frames.resize(capture.header.frameCount);
+		for (auto& frame : capture.frames)
+		{
+			uint32_t drawCount = reader.value<uint32_t>();
+			uint32_t pushDataSize = reader.value<uint32_t>();
+			reader.expect(uint64_t{ drawCount } * sizeof(CapturedDraw) + pushDataSize);
+			frame.draws.resize(drawCount);
+			frame.pushData.resize(pushDataSize);
+			reader.read(frame.draws.data(), frame.draws.size() * sizeof(CapturedDraw));
+			reader.read(frame.pushData.data(), frame.pushData.size());
+			for (const auto& draw : frame.draws)
+			{
+				bool valid = draw.pipeline < capture.pipelines.size() &&
+					(draw.model == CapturedDraw::NO_MODEL || draw.model < capture.models.size()) &&
+					draw.pushSize == capture.pipelines[draw.pipeline].pushConstantSize &&
+					draw.pushOffset <= frame.pushData.size() && draw.pushSize <= frame.pushData.size() - draw.pushOffset;
+				if (!valid)
+					throw std::runtime_error("Capture file has a draw with invalid references: " + filePath);
+			}
+		}
+		return capture;
+	}
+
+	LveFrameReplay::LveFrameReplay(LveDevice& device, const LveFrameCaptureFile& capture)
+		: lveDevice{ device }, capture{ capture }, offscreenTarget{ device, { capture.header.width, capture.header.height } }
+	{
+		for (const auto& model : capture.models)
+		{
+			LveModel::MeshView view{ model.vertices.data(), static_cast<uint32_t>(model.vertices.size()),
+				model.indices.data(), static_cast<uint32_t>(model.indices.size()) };
+			models.push_back(std::make_unique<LveModel>(lveDevice, view));
+		}
+
+		for (const auto& captured : capture.pipelines)
+		{
+			VkPushConstantRange pushConstantRange{};
+			pushConstantRange.stageFlags = captured.pushConstantStages;
+			pushConstantRange.offset = 0;
+			pushConstantRange.size = captured.pushConstantSize;
+
+			VkPipelineLayoutCreateInfo layoutInfo{};
+			layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			layoutInfo.pushConstantRangeCount = captured.pushConstantSize > 0 ? 1 : 0;
+			layoutInfo.pPushConstantRanges = &pushConstantRange;
+			VkPipelineLayout layout;
+			if (vkCreatePipelineLayout(lveDevice.device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+				throw std::runtime_error("Failed creating pipeline layout");
+			layouts.push_back(layout);
+
+			PipelineConfigInfo config{};
+			LvePipeline::defaultPipelineConfigInfo(config);
+			offscreenTarget.setRenderTarget(config);
+			config.pipelineLayout = layout;
+			if (captured.colorMode >= 0)
+				config.fragSpecialization.set(0, captured.colorMode);
+			if (!captured.vertexInput)
+			{
+				config.bindingDescriptions.clear();
+				config.attributeDescriptions.clear();
+			}
+			config.depthStencilInfo.depthTestEnable = captured.depthTest ? VK_TRUE : VK_FALSE;
+			config.depthStencilInfo.depthWriteEnable = captured.depthTest ? VK_TRUE : VK_FALSE;
+			pipelines.push_back(std::make_unique<LvePipeline>(lveDevice, captured.vertFilePath, captured.fragFilePath, config));
+		}
+	}
+
+	LveFrameReplay::~LveFrameReplay()
+	{
+		pipelines.clear();
+		for (auto layout : layouts)
+			vkDestroyPipelineLayout(lveDevice.device(), layout, nullptr);
+	}
+
+	void LveFrameReplay::record(VkCommandBuffer commandBuffer, uint32_t frame)
+	{
+		const auto& header = capture.header;
+		VkClearColorValue clearColor{ { header.clearColor[0], header.clearColor[1], header.clearColor[2], header.clearColor[3] } };
+		offscreenTarget.beginRendering(commandBuffer, clearColor, { 1.0f, 0 });
+
+		VkExtent2D extent = offscreenTarget.extent();
+		VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+		VkRect2D scissor{ { 0, 0 }, extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Binds only change with the draw, like the sorted draw list they were captured from
+		const auto& captured = capture.frames[frame];
+		uint32_t boundPipeline = ~0u;
+		uint32_t boundModel = CapturedDraw::NO_MODEL;
+		for (const auto& draw : captured.draws)
+		{
+			if (draw.pipeline != boundPipeline)
+			{
+				boundPipeline = draw.pipeline;
+				pipelines[boundPipeline]->bind(commandBuffer);
+			}
+			if (draw.pushSize > 0)
+			{
+				vkCmdPushConstants(commandBuffer, layouts[draw.pipeline], capture.pipelines[draw.pipeline].pushConstantStages,
+					0, draw.pushSize, captured.pushData.data() + draw.pushOffset);
+			}
+
+			if (draw.model == CapturedDraw::NO_MODEL)
+			{
+				vkCmdDraw(commandBuffer, draw.vertexCount, 1, 0, 0);
+				continue;
+			}
+			if (draw.model != boundModel)
+			{
+				boundModel = draw.model;
+				models[boundModel]->bind(commandBuffer);
+			}
+			models[boundModel]->draw(commandBuffer);
+		}
+
+		offscreenTarget.endRendering(commandBuffer);
+	}
+
+	LveFrameReplay::Timings LveFrameReplay::play(uint32_t frames, LveReadback* readback, LveReadback::Consumer consumer)
+	{
+		if (frameCount() == 0)
+			throw std::runtime_error("Capture has no frames to play");
+
+		// Frames in flight like the windowed app, the CPU records one while the GPU runs the other
+		constexpr uint32_t framesInFlight = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+		LveFrameCommandPools commandPools{ lveDevice, framesInFlight, lveDevice.findPhysicalQueueFamilies().graphicsFamily };
+		LveGpuTimer timer{ lveDevice, framesInFlight };
+		std::vector<VkFence> fences(framesInFlight);
+		for (auto& fence : fences)
+		{
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			if (vkCreateFence(lveDevice.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create fence");
+		}
+
+		Timings timings{};
+		timings.frames = frames;
+		timings.gpuMs.reserve(frames);
+		auto collect = [&](uint32_t slot)
+		{
+			double ms;
+			if (timer.collect(slot, ms))
+				timings.gpuMs.push_back(ms);
+		};
+
+		uint64_t allocations = LveAllocationCounter::threadAllocations();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			uint32_t slot = frame % framesInFlight;
+			vkWaitForFences(lveDevice.device(), 1, &fences[slot], VK_TRUE, UINT64_MAX);
+			collect(slot);
+			vkResetFences(lveDevice.device(), 1, &fences[slot]);
+
+			commandPools.beginFrame(slot);
+			VkCommandBuffer commandBuffer = commandPools.threadPool().allocate();
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			timer.begin(commandBuffer, slot);
+			record(commandBuffer, frame % frameCount());
+			timer.end(commandBuffer, slot);
+			if (readback != nullptr && frame + 1 == frames)
+			{
+				readback->copy(commandBuffer, slot, offscreenTarget.colorImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					offscreenTarget.extent(), offscreenTarget.colorFormat(), frame, std::move(consumer));
+			}
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("Failed to record command buffer");
+
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			if (vkQueueSubmit(lveDevice.graphicsQueue(), 1, &submitInfo, fences[slot]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to submit replayed frame");
+		}
+		vkDeviceWaitIdle(lveDevice.device());
+		timings.wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		timings.hostAllocations = LveAllocationCounter::threadAllocations() - allocations;
+		for (uint32_t slot = 0; slot < framesInFlight; ++slot)
+			collect(slot);
+		std::sort(timings.gpuMs.begin(), timings.gpuMs.end());
+
+		for (auto fence : fences)
+			vkDestroyFence(lveDevice.device(), fence, nullptr);
+
+		if (readback != nullptr)
+		{
+			for (uint32_t slot = 0; slot < framesInFlight; ++slot)
+				readback->complete(slot);
+			readback->flush();
+		}
+		return timings;
+	}
+
+	void LveFrameReplay::run(const std::string& preferredDevice, const std::string& filePath, uint32_t loops)
+	{
+		LveFrameCaptureFile capture = LveFrameCaptureFile::load(filePath);
+		if (capture.frames.empty())
+			throw std::runtime_error("Capture has no frames: " + filePath);
+
+		LveDevice device{ preferredDevice };
+		LveFrameReplay replay{ device, capture };
+		Timings timings = replay.play(replay.frameCount() * std::max(loops, 1u));
+
+		std::cout << "Replay of " << filePath << " on " << device.properties.deviceName << " (headless), "
+			<< capture.header.width << "x" << capture.header.height << ", " << replay.frameCount() << " frames x " << std::max(loops, 1u) << "\n";
+		std::cout << "  wall clock: " << timings.wallMs / timings.frames << "ms per frame ("
+			<< timings.frames / (timings.wallMs / 1000.0) << " fps)\n";
+		if (timings.gpuMs.empty())
+		{
+			std::cout << "  GPU timestamps: not supported on this device\n";
+			return;
+		}
+		// The median is what to compare between builds, the mean follows single slow frames
+		double sum = 0.0;
+		for (double ms : timings.gpuMs)
+			sum += ms;
+		std::cout << "  GPU: median " << timings.medianGpuMs() << "ms, mean " << sum / timings.gpuMs.size()
+			<< "ms, min " << timings.gpuMs.front() << "ms, max " << timings.gpuMs.back() << "ms per frame\n";
+	}
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_model.hpp"
+#include "lve_offscreen_target.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_readback.hpp"
+
+// std
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve
+{
+	// Layout of a capture file: the header, every model's vertices and indices, every
+	// pipeline, then the frames. Frames are a draw count, a push constant byte count, the
+	// draws and the push constant bytes they point into. Models are stored by value so a
+	// replay does not depend on how meshes are generated or cached, pipelines by the SPIR-V
+	// they are built from so every build replays with its own shaders
+	struct CaptureFileHeader
+	{
+		static constexpr uint32_t MAGIC = 0x4345564C; // "LVEC"
+		static constexpr uint32_t VERSION = 1;
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		float clearColor[4];
+		uint32_t modelCount;
+		uint32_t pipelineCount;
+		uint32_t frameCount;
+		// sizeof(LveModel::Vertex) when captured, a replay with another layout refuses the file
+		uint32_t vertexStride;
+	};
+	static_assert(sizeof(CaptureFileHeader) == 48, "CaptureFileHeader layout is part of the file format");
+
+	// What a replay builds a pipeline from. The fixed function state is the default one
+	struct CapturedPipeline
+	{
+		std::string vertFilePath;
+		std::string fragFilePath;
+		// Fragment specialization constant 0, COLOR_MODE in simple_shader.frag, < 0 for none
+		int32_t colorMode = -1;
+		uint32_t pushConstantSize = 0;
+		VkShaderStageFlags pushConstantStages = 0;
+		// LveModel::Vertex input, otherwise the vertex shader makes up its vertices
+		bool vertexInput = true;
+		bool depthTest = true;
+	};
+
+	struct CapturedDraw
+	{
+		// Draws vertexCount vertices without binding a model
+		static constexpr uint32_t NO_MODEL = ~0u;
+
+		uint32_t pipeline;
+		uint32_t model;
+		uint32_t vertexCount;
+		uint32_t pushOffset;
+		uint32_t pushSize;
+	};
+	static_assert(sizeof(CapturedDraw) == 20, "CapturedDraw layout is part of the file format");
+
+	struct CapturedFrame
+	{
+		std::vector<CapturedDraw> draws;
+		std::vector<uint8_t> pushData;
+	};
+
+	// Writes frames as they are recorded. Models and pipelines are added first, the first
+	// beginFrame writes them out and later additions throw
+	class LveFrameCaptureWriter
+	{
+	public:
+		LveFrameCaptureWriter(const std::string& filePath, VkExtent2D extent, const float clearColor[4]);
+		// Patches the frame count into the header
+		~LveFrameCaptureWriter();
+
+		LveFrameCaptureWriter(const LveFrameCaptureWriter&) = delete;
+		LveFrameCaptureWriter& operator=(const LveFrameCaptureWriter&) = delete;
+
+		uint32_t addModel(const LveModel::MeshView& mesh);
+		uint32_t addPipeline(const CapturedPipeline& pipeline);
+
+		void beginFrame();
+		void draw(uint32_t pipeline, uint32_t model, uint32_t vertexCount, const void* pushData, uint32_t pushSize);
+		void endFrame();
+
+		uint32_t frameCount() const { return header.frameCount; }
+
+	private:
+		void writeResources();
+
+		std::ofstream file;
+		CaptureFileHeader header{};
+		std::vector<std::vector<uint8_t>> models;
+		std::vector<CapturedPipeline> pipelines;
+		bool resourcesWritten = false;
+		// Reused for every frame
+		CapturedFrame frame;
+	};
+
+	// A whole capture in memory, so a replay never waits on the disk
+	struct LveFrameCaptureFile
+	{
+		struct Model
+		{
+			std::vector<LveModel::Vertex> vertices;
+			std::vector<uint32_t> indices;
+		};
+
+		CaptureFileHeader header{};
+		std::vector<Model> models;
+		std::vector<CapturedPipeline> pipelines;
+		std::vector<CapturedFrame> frames;
+
+		// Throws on a file that is not a capture or of another version
+		static LveFrameCaptureFile load(const std::string& filePath);
+	};
+
+	// Uploads the models of a capture, builds its pipelines for an offscreen target of the
+	// captured size and records its frames into it
+	class LveFrameReplay
+	{
+	public:
+		struct Timings
+		{
+			uint32_t frames = 0;
+			double wallMs = 0.0;
+			// Per frame, sorted, empty without timestamps
+			std::vector<double> gpuMs;
+			// operator new calls on the calling thread while recording and submitting
+			uint64_t hostAllocations = 0;
+
+			double medianGpuMs() const { return gpuMs.empty() ? 0.0 : gpuMs[gpuMs.size() / 2]; }
+		};
+
+		LveFrameReplay(LveDevice& device, const LveFrameCaptureFile& capture);
+		~LveFrameReplay();
+
+		LveFrameReplay(const LveFrameReplay&) = delete;
+		LveFrameReplay& operator=(const LveFrameReplay&) = delete;
+
+		// Renders capture.frames[frame] into the target, outside of any render pass
+		void record(VkCommandBuffer commandBuffer, uint32_t frame);
+
+		LveOffscreenTarget& target() { return offscreenTarget; }
+		uint32_t frameCount() const { return static_cast<uint32_t>(capture.frames.size()); }
+
+		// Renders frames frames, looping over the capture, with two in flight and waits for
+		// them. With a readback the last frame is copied out and given to consumer
+		Timings play(uint32_t frames, LveReadback* readback = nullptr, LveReadback::Consumer consumer = nullptr);
+
+		// Replays the capture loops times on a headless device, frames recorded and submitted
+		// as fast as the GPU takes them, and prints CPU and GPU frame times
+		static void run(const std::string& preferredDevice, const std::string& filePath, uint32_t loops = 1);
+
+	private:
+		LveDevice& lveDevice;
+		const LveFrameCaptureFile& capture;
+		LveOffscreenTarget offscreenTarget;
+		std::vector<std::unique_ptr<LveModel>> models;
+		// One layout per pipeline, each with the push constant range it was captured with
+		std::vector<VkPipelineLayout> layouts;
+		std::vector<std::unique_ptr<LvePipeline>> pipelines;
+	};
+}
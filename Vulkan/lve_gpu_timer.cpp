@@ -0,0 +1,58 @@
+#include "lve_gpu_timer.hpp"
+
+// std
+#include <stdexcept>
+
+namespace lve
+{
+	LveGpuTimer::LveGpuTimer(LveDevice& device, uint32_t slotCount) : lveDevice(device)
+	{
+		if (slotCount == 0 || lveDevice.properties.limits.timestampComputeAndGraphics != VK_TRUE)
+			return;
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2 * slotCount;
+		if (vkCreateQueryPool(lveDevice.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create timestamp query pool");
+		written.assign(slotCount, false);
+	}
+
+	LveGpuTimer::~LveGpuTimer()
+	{
+		if (queryPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(lveDevice.device(), queryPool, nullptr);
+	}
+
+	void LveGpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		if (!available() || slot >= written.size())
+			return;
+		vkCmdResetQueryPool(commandBuffer, queryPool, 2 * slot, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * slot);
+	}
+
+	void LveGpuTimer::end(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlagBits stage)
+	{
+		if (!available() || slot >= written.size())
+			return;
+		vkCmdWriteTimestamp(commandBuffer, stage, queryPool, 2 * slot + 1);
+		written[slot] = true;
+	}
+
+	bool LveGpuTimer::collect(uint32_t slot, double& ms, bool wait)
+	{
+		if (!available() || slot >= written.size() || !written[slot])
+			return false;
+		written[slot] = false;
+
+		uint64_t ticks[2];
+		VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0);
+		if (vkGetQueryPoolResults(lveDevice.device(), queryPool, 2 * slot, 2, sizeof(ticks), ticks, sizeof(uint64_t), flags) != VK_SUCCESS)
+			return false;
+
+		ms = (ticks[1] - ticks[0]) * static_cast<double>(lveDevice.properties.limits.timestampPeriod) / 1e6;
+		return true;
+	}
+}
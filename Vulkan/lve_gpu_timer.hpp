@@ -0,0 +1,39 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve
+{
+	// Timestamps around GPU work, one pair per slot. A slot is usually a frame in flight:
+	// its results are read once the fence of that frame has signaled, so reading never stalls
+	class LveGpuTimer
+	{
+	public:
+		LveGpuTimer(LveDevice& device, uint32_t slotCount);
+		~LveGpuTimer();
+
+		LveGpuTimer(const LveGpuTimer&) = delete;
+		LveGpuTimer& operator=(const LveGpuTimer&) = delete;
+
+		// False without timestamp support on graphics and compute queues, every call is then a no op
+		bool available() const { return queryPool != VK_NULL_HANDLE; }
+
+		// Outside of a render pass, the slot is reset here
+		void begin(VkCommandBuffer commandBuffer, uint32_t slot);
+		// stage is where the timed work ends, e.g. COMPUTE_SHADER after a dispatch
+		void end(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		// Milliseconds between the last begin and end in this slot, false when there is no new
+		// result. wait blocks until the GPU got there instead
+		bool collect(uint32_t slot, double& ms, bool wait = false);
+
+	private:
+		LveDevice& lveDevice;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		// Only slots with an end since the last collect have a result
+		std::vector<bool> written;
+	};
+}
@@ -0,0 +1,150 @@
+#include "lve_gpu_trace.hpp"
+
+#include "lve_trace.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// std
+#include <stdexcept>
+
+namespace lve
+{
+	// The CPU clock steady_clock reads, CLOCK_MONOTONIC with libstdc++ and libc++ and the
+	// performance counter with MSVC, so calibrated host timestamps are on the trace's clock
+	static bool hostTicksToNanoseconds(VkTimeDomainEXT domain, uint64_t ticks, int64_t& ns)
+	{
+		switch (domain)
+		{
+		case VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT:
+			ns = static_cast<int64_t>(ticks);
+			return true;
+#ifdef _WIN32
+		case VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT:
+		{
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			uint64_t perSecond = static_cast<uint64_t>(frequency.QuadPart);
+			ns = static_cast<int64_t>(ticks / perSecond * 1000000000ull + ticks % perSecond * 1000000000ull / perSecond);
+			return true;
+		}
+#endif
+		default:
+			return false;
+		}
+	}
+
+	LveGpuTrace::LveGpuTrace(LveDevice& device, uint32_t frameCount, const char* track)
+		: lveDevice{ device }, track{ track }, frames(frameCount)
+	{
+		if (frameCount == 0 || lveDevice.properties.limits.timestampComputeAndGraphics != VK_TRUE)
+			return;
+
+		// One more pair for the calibration without the extension
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2 * MAX_RANGES * frameCount + 1;
+		if (vkCreateQueryPool(lveDevice.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create timestamp query pool");
+		results.resize(2 * MAX_RANGES);
+
+		uint32_t validBits = lveDevice.timestampValidBits();
+		tickMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	}
+
+	LveGpuTrace::~LveGpuTrace()
+	{
+		if (queryPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(lveDevice.device(), queryPool, nullptr);
+	}
+
+	void LveGpuTrace::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		currentFrame = frameIndex;
+		Frame& frame = frames[frameIndex];
+		frame.used = 0;
+		frame.recording = queryPool != VK_NULL_HANDLE && LveTrace::enabled();
+		if (frame.recording)
+			vkCmdResetQueryPool(commandBuffer, queryPool, query(frameIndex, 0, 0), 2 * MAX_RANGES);
+	}
+
+	uint32_t LveGpuTrace::begin(VkCommandBuffer commandBuffer, const char* name)
+	{
+		Frame& frame = frames[currentFrame];
+		if (!frame.recording || frame.used == MAX_RANGES)
+			return NO_RANGE;
+		uint32_t range = frame.used++;
+		frame.names[range] = name;
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query(currentFrame, range, 0));
+		return range;
+	}
+
+	void LveGpuTrace::end(VkCommandBuffer commandBuffer, uint32_t range, VkPipelineStageFlagBits stage)
+	{
+		if (range == NO_RANGE)
+			return;
+		vkCmdWriteTimestamp(commandBuffer, stage, queryPool, query(currentFrame, range, 1));
+	}
+
+	bool LveGpuTrace::sampleCalibration()
+	{
+		if (!lveDevice.calibratedTimestampsEnabled())
+			return false;
+		uint64_t hostTicks, maxDeviation;
+		if (!lveDevice.sampleCalibratedTimestamps(calibrationTicks, hostTicks, maxDeviation) ||
+			!hostTicksToNanoseconds(lveDevice.hostTimeDomain(), hostTicks, calibrationNs))
+			return false;
+		hasCalibration = true;
+		return true;
+	}
+
+	void LveGpuTrace::calibrate()
+	{
+		if (queryPool == VK_NULL_HANDLE || sampleCalibration())
+			return;
+
+		// A timestamp at the top of an otherwise empty submit is taken about when the CPU
+		// submits it, the midpoint of submitting and waiting is the best guess without the extension
+		uint32_t calibrationQuery = 2 * MAX_RANGES * static_cast<uint32_t>(frames.size());
+		int64_t before = LveTrace::now();
+		VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+		vkCmdResetQueryPool(commandBuffer, queryPool, calibrationQuery, 1);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, calibrationQuery);
+		lveDevice.endSingleTimeCommands(commandBuffer);
+		int64_t after = LveTrace::now();
+		if (vkGetQueryPoolResults(lveDevice.device(), queryPool, calibrationQuery, 1, sizeof(uint64_t), &calibrationTicks,
+			sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+			return;
+		calibrationNs = before + (after - before) / 2;
+		hasCalibration = true;
+	}
+
+	void LveGpuTrace::collect(uint32_t frameIndex)
+	{
+		Frame& frame = frames[frameIndex];
+		if (!frame.recording || frame.used == 0)
+			return;
+		frame.recording = false;
+		if (vkGetQueryPoolResults(lveDevice.device(), queryPool, query(frameIndex, 0, 0), 2 * frame.used,
+			2 * frame.used * sizeof(uint64_t), results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+			return;
+		// Never submits here, that would wait behind the frames still in flight
+		if (!sampleCalibration() && !hasCalibration)
+			return;
+
+		// Counters narrower than 64 bits wrap, the difference to the calibration still holds within half the range
+		double nsPerTick = lveDevice.properties.limits.timestampPeriod;
+		auto toNanoseconds = [&](uint64_t ticks)
+		{
+			uint64_t delta = (ticks - calibrationTicks) & tickMask;
+			int64_t signedDelta = delta > tickMask / 2 ? -static_cast<int64_t>((calibrationTicks - ticks) & tickMask) : static_cast<int64_t>(delta);
+			return calibrationNs + static_cast<int64_t>(signedDelta * nsPerTick);
+		};
+		for (uint32_t range = 0; range < frame.used; ++range)
+			LveTrace::recordOnTrack(track, frame.names[range], toNanoseconds(results[2 * range]), toNanoseconds(results[2 * range + 1]));
+	}
+}
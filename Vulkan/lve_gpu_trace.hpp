@@ -0,0 +1,67 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve
+{
+	// Timestamp ranges in command buffers, per frame in flight, put on the trace's clock. With
+	// VK_EXT_calibrated_timestamps the device counter is sampled together with the CPU clock
+	// on every collect, otherwise once by calibrate(), which is off by up to a submit's latency.
+	// Nothing is written to command buffers while tracing is stopped
+	class LveGpuTrace
+	{
+	public:
+		static constexpr uint32_t MAX_RANGES = 32;
+		static constexpr uint32_t NO_RANGE = ~0u;
+
+		LveGpuTrace(LveDevice& device, uint32_t frameCount, const char* track = "GPU");
+		~LveGpuTrace();
+
+		LveGpuTrace(const LveGpuTrace&) = delete;
+		LveGpuTrace& operator=(const LveGpuTrace&) = delete;
+
+		// Outside of a render pass, before the frame's first range
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		// Ranges may nest, end takes what begin returned
+		uint32_t begin(VkCommandBuffer commandBuffer, const char* name);
+		void end(VkCommandBuffer commandBuffer, uint32_t range, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		// Once the fence of frameIndex has signaled. Ranges are dropped until there is a calibration
+		void collect(uint32_t frameIndex);
+
+		// Without the extension this times an empty submit on the graphics queue and waits for
+		// it, so the device has to be idle and no other thread may submit, e.g. before the frame
+		// loop starts. Queued frames would otherwise delay the timestamp and skew every range
+		void calibrate();
+
+		bool calibrated() const { return lveDevice.calibratedTimestampsEnabled(); }
+
+	private:
+		struct Frame
+		{
+			const char* names[MAX_RANGES];
+			uint32_t used = 0;
+			bool recording = false;
+		};
+
+		uint32_t query(uint32_t frameIndex, uint32_t range, uint32_t end) const { return 2 * (frameIndex * MAX_RANGES + range) + end; }
+		// With the extension, false without it or when sampling failed
+		bool sampleCalibration();
+
+		LveDevice& lveDevice;
+		const char* track;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::vector<Frame> frames;
+		uint32_t currentFrame = 0;
+
+		// A device timestamp and the trace clock at the same instant
+		bool hasCalibration = false;
+		uint64_t calibrationTicks = 0;
+		int64_t calibrationNs = 0;
+		uint64_t tickMask = ~0ull;
+		std::vector<uint64_t> results;
+	};
+}
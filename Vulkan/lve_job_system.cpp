@@ -0,0 +1,310 @@
+#include "lve_job_system.hpp"
+
+#include "lve_trace.hpp"
+
+// std
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace lve
+{
+	// Which pool and deque the current thread works from, unset outside of worker threads
+	static thread_local const LveJobSystem* currentSystem = nullptr;
+	static thread_local uint32_t currentQueue = 0;
+
+	LveJobSystem::LveJobSystem(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		uint32_t workerCount = threadCount - 1;
+
+		for (uint32_t i = 0; i <= workerCount; ++i)
+			queues.push_back(std::make_unique<Queue>());
+		for (uint32_t i = 0; i < workerCount; ++i)
+			workers.emplace_back(&LveJobSystem::workerLoop, this, i);
+	}
+
+	LveJobSystem::~LveJobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			running = false;
+		}
+		wakeUp.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+
+		// Without workers whatever is still queued runs here
+		while (runOne(ownQueue()))
+			;
+	}
+
+	LveJobSystem& LveJobSystem::get()
+	{
+		static LveJobSystem jobSystem;
+		return jobSystem;
+	}
+
+	void LveJobSystem::run(Job job, Counter* counter)
+	{
+		Task task;
+		task.job = std::move(job);
+		task.counter = counter;
+		push(std::move(task));
+	}
+
+	void LveJobSystem::runRange(RangeFunction range, void* context, size_t begin, size_t end, Counter* counter)
+	{
+		Task task;
+		task.range = range;
+		task.context = context;
+		task.begin = begin;
+		task.end = end;
+		task.counter = counter;
+		push(std::move(task));
+	}
+
+	void LveJobSystem::push(Task&& task)
+	{
+		if (task.counter != nullptr)
+			task.counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+		auto& queue = *queues[ownQueue()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.push(std::move(task));
+		}
+		queuedJobs.fetch_add(1);
+
+		// Taking the lock orders this with a worker that is about to sleep, so the wake up is not lost
+		if (sleepingWorkers.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+			}
+			wakeUp.notify_one();
+		}
+	}
+
+	void LveJobSystem::wait(Counter& counter)
+	{
+		uint32_t queue = ownQueue();
+		while (!counter.done())
+		{
+			if (!runOne(queue))
+				std::this_thread::yield();
+		}
+
+		if (counter.failed.load(std::memory_order_relaxed))
+			std::rethrow_exception(counter.error);
+	}
+
+	uint32_t LveJobSystem::ownQueue() const
+	{
+		return currentSystem == this ? currentQueue : static_cast<uint32_t>(queues.size() - 1);
+	}
+
+	void LveJobSystem::workerLoop(uint32_t index)
+	{
+		currentSystem = this;
+		currentQueue = index;
+		LveTrace::setThreadName("worker " + std::to_string(index));
+
+		while (true)
+		{
+			if (runOne(index))
+				continue;
+
+			// Jobs tend to come in bursts, a short spin saves going through the kernel for each one
+			bool found = false;
+			for (int spin = 0; spin < 64 && !found; ++spin)
+			{
+				std::this_thread::yield();
+				found = queuedJobs.load() > 0;
+			}
+			if (found)
+				continue;
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			if (!running && queuedJobs.load() == 0)
+				break;
+			sleepingWorkers.fetch_add(1);
+			wakeUp.wait(lock, [this] { return queuedJobs.load() > 0 || !running; });
+			sleepingWorkers.fetch_sub(1);
+		}
+	}
+
+	bool LveJobSystem::runOne(uint32_t queue)
+	{
+		Task task;
+		// The newest own job first, then the oldest of everyone else's, starting next door
+		bool found = pop(queue, true, task);
+		for (size_t i = 1; !found && i < queues.size(); ++i)
+			found = pop(static_cast<uint32_t>((queue + i) % queues.size()), false, task);
+		if (!found)
+			return false;
+
+		LVE_TRACE_SCOPE("job");
+		execute(task);
+		return true;
+	}
+
+	bool LveJobSystem::pop(uint32_t queue, bool back, Task& task)
+	{
+		auto& source = *queues[queue];
+		std::lock_guard<std::mutex> lock(source.mutex);
+		if (source.count == 0)
+			return false;
+
+		source.pop(back, task);
+		queuedJobs.fetch_sub(1);
+		return true;
+	}
+
+	void LveJobSystem::Queue::push(Task&& task)
+	{
+		// Only while warming up, the capacity is kept from then on
+		if (count == tasks.size())
+		{
+			std::vector<Task> grown(tasks.size() * 2);
+			for (size_t i = 0; i < count; ++i)
+				grown[i] = std::move(tasks[(head + i) % tasks.size()]);
+			tasks = std::move(grown);
+			head = 0;
+		}
+		tasks[(head + count) % tasks.size()] = std::move(task);
+		++count;
+	}
+
+	void LveJobSystem::Queue::pop(bool back, Task& task)
+	{
+		size_t slot = back ? (head + count - 1) % tasks.size() : head;
+		task = std::move(tasks[slot]);
+		// Whatever the job captured goes now, not when the slot is reused
+		tasks[slot].job = nullptr;
+		if (!back)
+			head = (head + 1) % tasks.size();
+		--count;
+	}
+
+	void LveJobSystem::execute(Task& task)
+	{
+		try
+		{
+			if (task.range != nullptr)
+				task.range(task.context, task.begin, task.end);
+			else
+				task.job();
+		}
+		catch (...)
+		{
+			// Only the first failure of a group is kept, the others are reported
+			if (task.counter != nullptr && !task.counter->failed.exchange(true, std::memory_order_relaxed))
+				task.counter->error = std::current_exception();
+			else
+			{
+				try
+				{
+					throw;
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "Job failed: " << e.what() << "\n";
+				}
+				catch (...)
+				{
+					std::cerr << "Job failed\n";
+				}
+			}
+		}
+
+		// Release publishes the job's writes, and its error, to whoever sees the counter reach 0
+		if (task.counter != nullptr)
+			task.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	void LveJobSystem::benchmark(size_t jobCount)
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		auto nanosecondsPerJob = [jobCount](Clock::time_point start)
+		{
+			return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / jobCount;
+		};
+
+		uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::cout << "Job system, " << hardwareThreads << " hardware threads\n";
+
+		{
+			LveJobSystem jobs;
+			std::atomic<size_t> ran{ 0 };
+
+			// Every job goes through the shared queue and is stolen from there
+			Counter fromOutside;
+			auto start = Clock::now();
+			for (size_t i = 0; i < jobCount; ++i)
+				jobs.run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &fromOutside);
+			jobs.wait(fromOutside);
+			std::cout << "  spawn + run from outside the pool: " << nanosecondsPerJob(start) << "ns per job\n";
+
+			// Jobs spawning jobs, the way parallel work is split up, stay on their worker's deque
+			Counter nested;
+			uint32_t spawners = jobs.threadCount();
+			start = Clock::now();
+			for (uint32_t s = 0; s < spawners; ++s)
+			{
+				jobs.run([&, s]()
+					{
+						Counter children;
+						for (size_t i = s; i < jobCount; i += spawners)
+							jobs.run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &children);
+						jobs.wait(children);
+					}, &nested);
+			}
+			jobs.wait(nested);
+			std::cout << "  spawn + run from inside jobs: " << nanosecondsPerJob(start) << "ns per job\n";
+
+			if (ran != 2 * jobCount)
+				std::cout << "  ERROR: " << ran << " of " << 2 * jobCount << " jobs ran\n";
+		}
+
+		// Compute bound parallelFor, the speedup is only interesting up to the physical core count
+		constexpr size_t elements = size_t{ 1 } << 22;
+		std::vector<float> values(elements);
+		double baselineMs = 0.0;
+		double expected = 0.0;
+		for (uint32_t threads = 1; threads <= std::min(hardwareThreads, 64u); threads *= 2)
+		{
+			LveJobSystem jobs{ threads };
+
+			constexpr int repeats = 10;
+			auto start = Clock::now();
+			for (int repeat = 0; repeat < repeats; ++repeat)
+			{
+				jobs.parallelFor(elements, 4096, [&](size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; ++i)
+						{
+							float x = static_cast<float>(i) * 1e-6f;
+							for (int k = 0; k < 16; ++k)
+								x = std::sqrt(x * x + 1.0f) - 0.5f * x;
+							values[i] = x;
+						}
+					});
+			}
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repeats;
+
+			double sum = 0.0;
+			for (float value : values)
+				sum += value;
+			if (threads == 1)
+			{
+				baselineMs = ms;
+				expected = sum;
+			}
+			std::cout << "  parallelFor, " << threads << " threads: " << ms << "ms, speedup " << baselineMs / ms
+				<< (sum == expected ? "" : " (RESULT DIFFERS)") << "\n";
+		}
+	}
+}
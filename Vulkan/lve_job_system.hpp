@@ -0,0 +1,158 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lve
+{
+	// A fixed pool of worker threads, one deque of jobs each. A worker pushes and pops
+	// its own jobs at the back, so the ones it just spawned run while their data is
+	// still in cache, and steals from the front of another deque when its own is empty.
+	// Threads outside the pool submit into a shared queue that every worker steals from.
+	// Once the deques have grown to the most jobs ever queued at once, neither run() nor
+	// parallelFor allocate, as long as run() is given jobs that fit std::function's small
+	// buffer (a couple of pointers)
+	class LveJobSystem
+	{
+	public:
+		using Job = std::function<void()>;
+
+		// Counts the unfinished jobs it was given, the way to wait for or depend on a group of jobs.
+		// Keeps the first exception one of them threw, wait() rethrows it
+		class Counter
+		{
+		public:
+			Counter() = default;
+			Counter(const Counter&) = delete;
+			Counter& operator=(const Counter&) = delete;
+
+			bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+		private:
+			friend class LveJobSystem;
+			std::atomic<uint32_t> pending{ 0 };
+			std::atomic<bool> failed{ false };
+			std::exception_ptr error;
+		};
+
+		// threadCount includes the thread that waits, so 1 means no workers and every job runs
+		// inside wait(). 0 uses one thread per hardware thread
+		explicit LveJobSystem(uint32_t threadCount = 0);
+		~LveJobSystem();
+
+		LveJobSystem(const LveJobSystem&) = delete;
+		LveJobSystem& operator=(const LveJobSystem&) = delete;
+
+		// Shared by the engine, created with the first call
+		static LveJobSystem& get();
+
+		// counter may be null for jobs nobody waits on, their exceptions are only printed
+		void run(Job job, Counter* counter = nullptr);
+		// Runs queued jobs on the calling thread until every job of counter has finished,
+		// so waiting from inside a job does not take a worker away
+		void wait(Counter& counter);
+
+		// Calls body(begin, end) over [0, count) in chunks that are a multiple of minChunk,
+		// small enough to keep every worker busy, and returns once all of them ran
+		template<typename Body>
+		void parallelFor(size_t count, size_t minChunk, Body&& body)
+		{
+			minChunk = std::max<size_t>(1, minChunk);
+			size_t target = (count + threadCount() * 4 - 1) / (threadCount() * 4);
+			size_t chunk = (std::max(target, minChunk) + minChunk - 1) / minChunk * minChunk;
+			if (chunk >= count)
+			{
+				if (count > 0)
+					body(size_t{ 0 }, count);
+				return;
+			}
+
+			// The chunks point at body instead of each wrapping it in a std::function
+			using BodyType = std::remove_reference_t<Body>;
+			auto call = [](void* context, size_t begin, size_t end) { (*static_cast<BodyType*>(context))(begin, end); };
+			void* context = const_cast<void*>(static_cast<const void*>(std::addressof(body)));
+
+			Counter counter;
+			for (size_t begin = chunk; begin < count; begin += chunk)
+				runRange(call, context, begin, std::min(count, begin + chunk), &counter);
+			// The first chunk is the caller's, it would otherwise only wait
+			try
+			{
+				body(size_t{ 0 }, chunk);
+			}
+			catch (...)
+			{
+				wait(counter);
+				throw;
+			}
+			wait(counter);
+		}
+
+		// Workers plus the thread that waits
+		uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+		// 0 to threadCount() - 1 on the workers, threadCount() - 1 on every other thread, for
+		// data kept per thread
+		uint32_t threadIndex() const { return ownQueue(); }
+
+		// Spawn cost and parallelFor scaling from 1 worker up to every hardware thread
+		static void benchmark(size_t jobCount);
+
+	private:
+		using RangeFunction = void (*)(void* context, size_t begin, size_t end);
+
+		// Either a job, or a range function called with context and [begin, end)
+		struct Task
+		{
+			Job job;
+			RangeFunction range = nullptr;
+			void* context = nullptr;
+			size_t begin = 0;
+			size_t end = 0;
+			Counter* counter = nullptr;
+		};
+
+		// A deque as a ring buffer that only grows, std::deque allocates and frees its
+		// blocks as it fills and empties
+		struct Queue
+		{
+			static constexpr size_t INITIAL_CAPACITY = 256;
+
+			std::mutex mutex;
+			std::vector<Task> tasks = std::vector<Task>(INITIAL_CAPACITY);
+			size_t head = 0;
+			size_t count = 0;
+
+			void push(Task&& task);
+			void pop(bool back, Task& task);
+		};
+
+		void push(Task&& task);
+		void runRange(RangeFunction range, void* context, size_t begin, size_t end, Counter* counter);
+		void workerLoop(uint32_t index);
+		uint32_t ownQueue() const;
+		bool runOne(uint32_t queue);
+		bool pop(uint32_t queue, bool back, Task& task);
+		void execute(Task& task);
+
+		// One per worker, the last one is shared by every other thread
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wakeUp;
+		std::atomic<bool> running{ true };
+	};
+}
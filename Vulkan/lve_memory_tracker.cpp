@@ -0,0 +1,212 @@
+#include "lve_memory_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace lve
+{
+	const char* memoryTagName(MemoryTag tag)
+	{
+		switch (tag)
+		{
+		case MemoryTag::Vertex: return "vertex";
+		case MemoryTag::Index: return "index";
+		case MemoryTag::Uniform: return "uniform";
+		case MemoryTag::Storage: return "storage";
+		case MemoryTag::Staging: return "staging";
+		case MemoryTag::Depth: return "depth";
+		case MemoryTag::ColorTarget: return "color target";
+		case MemoryTag::Texture: return "texture";
+		default: return "unknown";
+		}
+	}
+
+	void LveMemoryTracker::init(VkPhysicalDevice physicalDevice, bool budgetExtensionEnabled)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->physicalDevice = physicalDevice;
+		this->budgetExtensionEnabled = budgetExtensionEnabled;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		trackedPerMemoryType.assign(memoryProperties.memoryTypeCount, 0);
+		trackedPerHeap.assign(memoryProperties.memoryHeapCount, 0);
+		refreshBudgets();
+	}
+
+	void LveMemoryTracker::onAllocate(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryTag tag)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		allocations[memory] = { size, memoryTypeIndex, tag };
+		trackedPerMemoryType[memoryTypeIndex] += size;
+		trackedPerHeap[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+		tags[static_cast<size_t>(tag)].bytes += size;
+		tags[static_cast<size_t>(tag)].allocations++;
+		changes++;
+	}
+
+	void LveMemoryTracker::onFree(VkDeviceMemory memory)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto allocation = allocations.find(memory);
+		if (allocation == allocations.end())
+			return;
+
+		const auto& info = allocation->second;
+		trackedPerMemoryType[info.memoryTypeIndex] -= info.size;
+		trackedPerHeap[memoryProperties.memoryTypes[info.memoryTypeIndex].heapIndex] -= info.size;
+		tags[static_cast<size_t>(info.tag)].bytes -= info.size;
+		tags[static_cast<size_t>(info.tag)].allocations--;
+		allocations.erase(allocation);
+		changes++;
+	}
+
+	bool LveMemoryTracker::fitsInBudget(uint32_t memoryTypeIndex, VkDeviceSize size, MemoryTag tag) const
+	{
+		uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		VkDeviceSize used;
+		VkDeviceSize budget;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (budgetExtensionEnabled && std::chrono::steady_clock::now() - budgetsQueried > BUDGET_REFRESH)
+				refreshBudgets();
+
+			// The driver number also counts memory we did not allocate ourselves (swapchain images),
+			// what we allocated or freed since it was queried is added on top
+			const auto& heap = budgets[heapIndex];
+			VkDeviceSize tracked = trackedPerHeap[heapIndex];
+			VkDeviceSize driverUsage = tracked >= heap.trackedAtQuery ? heap.driverUsage + (tracked - heap.trackedAtQuery)
+				: heap.driverUsage - std::min(heap.driverUsage, heap.trackedAtQuery - tracked);
+			used = std::max(driverUsage, tracked);
+			budget = heap.budget;
+		}
+		if (used + size <= budget)
+			return true;
+
+		std::cerr << "Memory budget exceeded: " << memoryTagName(tag) << " allocation of " << (size >> 10) << " KiB"
+			<< " on heap " << heapIndex << " (" << (used >> 20) << " / " << (budget >> 20) << " MiB used)\n";
+		return false;
+	}
+
+	void LveMemoryTracker::refreshBudgets() const
+	{
+		MemoryStats stats{};
+		queryHeaps(stats);
+		budgets.resize(stats.heaps.size());
+		for (size_t i = 0; i < stats.heaps.size(); ++i)
+			budgets[i] = { stats.heaps[i].budget, stats.heaps[i].driverUsage, trackedPerHeap[i] };
+		budgetsQueried = std::chrono::steady_clock::now();
+	}
+
+	uint64_t LveMemoryTracker::generation() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return changes;
+	}
+
+	MemoryStats LveMemoryTracker::snapshot() const
+	{
+		MemoryStats stats{};
+		queryHeaps(stats);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.trackedPerMemoryType = trackedPerMemoryType;
+		stats.tags = tags;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+			stats.heaps[memoryProperties.memoryTypes[i].heapIndex].tracked += trackedPerMemoryType[i];
+		return stats;
+	}
+
+	void LveMemoryTracker::queryHeaps(MemoryStats& stats) const
+	{
+		stats.heaps.resize(memoryProperties.memoryHeapCount);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+		{
+			stats.heaps[i].size = memoryProperties.memoryHeaps[i].size;
+			stats.heaps[i].budget = memoryProperties.memoryHeaps[i].size;
+			stats.heaps[i].deviceLocal = memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+		}
+
+		if (!budgetExtensionEnabled)
+			return;
+
+		// Budgets move as other processes allocate, so they are asked for every time
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budget;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+		stats.budgetFromDriver = true;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+		{
+			stats.heaps[i].budget = budget.heapBudget[i];
+			stats.heaps[i].driverUsage = budget.heapUsage[i];
+		}
+	}
+
+	void LveMemoryTracker::printReport(const MemoryStats& stats, std::ostream& out)
+	{
+		auto mib = [](VkDeviceSize bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+		out << std::fixed << std::setprecision(1);
+		out << "GPU memory (" << (stats.budgetFromDriver ? "VK_EXT_memory_budget" : "no budget extension, heap size as budget") << ")\n";
+		for (size_t i = 0; i < stats.heaps.size(); ++i)
+		{
+			const auto& heap = stats.heaps[i];
+			out << "  heap " << i << (heap.deviceLocal ? " (device local)" : "") << ": tracked " << mib(heap.tracked) << " MiB";
+			if (stats.budgetFromDriver)
+				out << ", driver " << mib(heap.driverUsage) << " MiB";
+			out << ", budget " << mib(heap.budget) << " / " << mib(heap.size) << " MiB\n";
+		}
+		for (size_t i = 0; i < stats.tags.size(); ++i)
+		{
+			if (stats.tags[i].allocations == 0)
+				continue;
+			out << "  " << memoryTagName(static_cast<MemoryTag>(i)) << ": " << mib(stats.tags[i].bytes) << " MiB in "
+				<< stats.tags[i].allocations << " allocations\n";
+		}
+		out << std::defaultfloat << std::setprecision(6);
+	}
+
+	void LveMemoryTracker::writeJson(const MemoryStats& stats, std::ostream& out)
+	{
+		out << "{\"budgetFromDriver\":" << (stats.budgetFromDriver ? "true" : "false") << ",\"heaps\":[";
+		for (size_t i = 0; i < stats.heaps.size(); ++i)
+		{
+			const auto& heap = stats.heaps[i];
+			out << (i > 0 ? "," : "") << "{\"size\":" << heap.size << ",\"budget\":" << heap.budget
+				<< ",\"driverUsage\":" << heap.driverUsage << ",\"tracked\":" << heap.tracked
+				<< ",\"deviceLocal\":" << (heap.deviceLocal ? "true" : "false") << "}";
+		}
+		out << "],\"memoryTypes\":[";
+		for (size_t i = 0; i < stats.trackedPerMemoryType.size(); ++i)
+			out << (i > 0 ? "," : "") << stats.trackedPerMemoryType[i];
+		out << "],\"tags\":{";
+		for (size_t i = 0; i < stats.tags.size(); ++i)
+		{
+			out << (i > 0 ? "," : "") << "\"" << memoryTagName(static_cast<MemoryTag>(i)) << "\":{\"bytes\":"
+				<< stats.tags[i].bytes << ",\"allocations\":" << stats.tags[i].allocations << "}";
+		}
+		out << "}}\n";
+	}
+
+	MemoryTag LveMemoryTracker::tagForBufferUsage(VkBufferUsageFlags usage)
+	{
+		if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) return MemoryTag::Vertex;
+		if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) return MemoryTag::Index;
+		if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) return MemoryTag::Uniform;
+		if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) return MemoryTag::Storage;
+		if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) return MemoryTag::Staging;
+		return MemoryTag::Unknown;
+	}
+
+	MemoryTag LveMemoryTracker::tagForImageUsage(VkImageUsageFlags usage)
+	{
+		if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) return MemoryTag::Depth;
+		if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) return MemoryTag::ColorTarget;
+		if (usage & VK_IMAGE_USAGE_SAMPLED_BIT) return MemoryTag::Texture;
+		return MemoryTag::Unknown;
+	}
+}
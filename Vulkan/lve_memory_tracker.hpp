@@ -0,0 +1,120 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// std
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace lve
+{
+	// What an allocation is used for, createBuffer and createImageWithInfo derive it
+	// from the usage flags when the caller does not say
+	enum class MemoryTag : uint32_t
+	{
+		Unknown,
+		Vertex,
+		Index,
+		Uniform,
+		Storage,
+		Staging,
+		Depth,
+		ColorTarget,
+		Texture,
+		Count
+	};
+
+	const char* memoryTagName(MemoryTag tag);
+
+	struct MemoryStats
+	{
+		struct Heap
+		{
+			VkDeviceSize size = 0;
+			// From VK_EXT_memory_budget when available, otherwise the heap size
+			VkDeviceSize budget = 0;
+			// What the driver reports this process uses, 0 without VK_EXT_memory_budget
+			VkDeviceSize driverUsage = 0;
+			// What went through LveDevice
+			VkDeviceSize tracked = 0;
+			bool deviceLocal = false;
+		};
+
+		struct Tag
+		{
+			VkDeviceSize bytes = 0;
+			uint32_t allocations = 0;
+		};
+
+		std::vector<Heap> heaps;
+		std::vector<VkDeviceSize> trackedPerMemoryType;
+		std::array<Tag, static_cast<size_t>(MemoryTag::Count)> tags{};
+		bool budgetFromDriver = false;
+	};
+
+	// Keeps count of every VkDeviceMemory allocated through LveDevice, per memory type, heap and tag
+	class LveMemoryTracker
+	{
+	public:
+		void init(VkPhysicalDevice physicalDevice, bool budgetExtensionEnabled);
+
+		void onAllocate(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryTag tag);
+		void onFree(VkDeviceMemory memory);
+
+		// Warns when the allocation would take its heap over budget, so loads can be
+		// rejected before the driver starts paging. Runs before every allocation, so it goes
+		// by budgets queried at most every BUDGET_REFRESH plus what was allocated since
+		bool fitsInBudget(uint32_t memoryTypeIndex, VkDeviceSize size, MemoryTag tag) const;
+
+		MemoryStats snapshot() const;
+		// Changes with every allocation and free, to only report when something happened
+		uint64_t generation() const;
+
+		static void printReport(const MemoryStats& stats, std::ostream& out);
+		static void writeJson(const MemoryStats& stats, std::ostream& out);
+
+		static MemoryTag tagForBufferUsage(VkBufferUsageFlags usage);
+		static MemoryTag tagForImageUsage(VkImageUsageFlags usage);
+
+	private:
+		struct Allocation
+		{
+			VkDeviceSize size;
+			uint32_t memoryTypeIndex;
+			MemoryTag tag;
+		};
+
+		struct HeapBudget
+		{
+			VkDeviceSize budget = 0;
+			VkDeviceSize driverUsage = 0;
+			// tracked of the heap when driverUsage was queried
+			VkDeviceSize trackedAtQuery = 0;
+		};
+
+		static constexpr std::chrono::milliseconds BUDGET_REFRESH{ 500 };
+
+		void queryHeaps(MemoryStats& stats) const;
+		// With mutex held
+		void refreshBudgets() const;
+
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		bool budgetExtensionEnabled = false;
+
+		mutable std::mutex mutex;
+		std::unordered_map<VkDeviceMemory, Allocation> allocations;
+		std::vector<VkDeviceSize> trackedPerMemoryType;
+		std::vector<VkDeviceSize> trackedPerHeap;
+		std::array<MemoryStats::Tag, static_cast<size_t>(MemoryTag::Count)> tags{};
+		uint64_t changes = 0;
+		mutable std::vector<HeapBudget> budgets;
+		mutable std::chrono::steady_clock::time_point budgetsQueried{};
+	};
+}
@@ -0,0 +1,311 @@
+#include "lve_mesh_cache.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace lve
+{
+	LveMappedFile::LveMappedFile(const std::string& filePath)
+	{
+#ifdef _WIN32
+		fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Failed to open file: " + filePath);
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		byteCount = static_cast<size_t>(fileSize.QuadPart);
+
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr)
+		{
+			CloseHandle(fileHandle);
+			throw std::runtime_error("Failed to map file: " + filePath);
+		}
+		bytes = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+		fileDescriptor = open(filePath.c_str(), O_RDONLY);
+		if (fileDescriptor < 0)
+			throw std::runtime_error("Failed to open file: " + filePath);
+
+		struct stat fileStat;
+		fstat(fileDescriptor, &fileStat);
+		byteCount = static_cast<size_t>(fileStat.st_size);
+
+		void* mapped = byteCount > 0 ? mmap(nullptr, byteCount, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) : MAP_FAILED;
+		bytes = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapped);
+#endif
+		if (bytes == nullptr)
+		{
+			release();
+			throw std::runtime_error("Failed to map file: " + filePath);
+		}
+	}
+
+	LveMappedFile::~LveMappedFile()
+	{
+		release();
+	}
+
+	void LveMappedFile::release()
+	{
+#ifdef _WIN32
+		if (bytes != nullptr)
+			UnmapViewOfFile(bytes);
+		if (mappingHandle != nullptr)
+			CloseHandle(mappingHandle);
+		if (fileHandle != nullptr && fileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		if (bytes != nullptr)
+			munmap(const_cast<uint8_t*>(bytes), byteCount);
+		if (fileDescriptor >= 0)
+			close(fileDescriptor);
+		fileDescriptor = -1;
+#endif
+		bytes = nullptr;
+	}
+
+	LveMeshFile::LveMeshFile(const std::string& filePath)
+		: file(filePath)
+	{
+		if (file.size() < sizeof(MeshFileHeader))
+			throw std::runtime_error("Mesh file too small: " + filePath);
+
+		const auto& h = header();
+		if (h.magic != MeshFileHeader::MAGIC || h.version != MeshFileHeader::VERSION)
+			throw std::runtime_error("Mesh file has a different format version: " + filePath);
+		if (h.vertexStride != sizeof(LveModel::Vertex))
+			throw std::runtime_error("Mesh file vertex layout does not match LveModel::Vertex: " + filePath);
+		if (h.vertexOffset + uint64_t(h.vertexCount) * h.vertexStride > file.size() ||
+			h.indexOffset + uint64_t(h.indexCount) * sizeof(uint32_t) > file.size())
+			throw std::runtime_error("Mesh file is truncated: " + filePath);
+	}
+
+	LveModel::MeshView LveMeshFile::view() const
+	{
+		const auto& h = header();
+		LveModel::MeshView mesh{};
+		mesh.vertices = reinterpret_cast<const LveModel::Vertex*>(file.data() + h.vertexOffset);
+		mesh.vertexCount = h.vertexCount;
+		mesh.indices = h.indexCount > 0 ? reinterpret_cast<const uint32_t*>(file.data() + h.indexOffset) : nullptr;
+		mesh.indexCount = h.indexCount;
+		return mesh;
+	}
+
+	LveMeshCache::LveMeshCache(std::string cacheDirectory)
+		: cacheDirectory(std::move(cacheDirectory))
+	{
+		std::filesystem::create_directories(this->cacheDirectory);
+	}
+
+	std::unique_ptr<LveMeshFile> LveMeshCache::load(const std::string& key, const Generator& generate, LoadStats* stats)
+	{
+		return loadOrBuild(hash(key.data(), key.size()), generate, stats);
+	}
+
+	std::unique_ptr<LveMeshFile> LveMeshCache::loadText(const std::string& filePath, LoadStats* stats)
+	{
+		std::ifstream file(filePath, std::ios::binary);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open file: " + filePath);
+
+		std::stringstream text;
+		text << file.rdbuf();
+		std::string contents = text.str();
+
+		return loadOrBuild(hash(contents.data(), contents.size()), [&contents](auto& vertices, auto& indices)
+			{
+				parseText(contents, vertices, indices);
+			}, stats);
+	}
+
+	std::unique_ptr<LveMeshFile> LveMeshCache::loadOrBuild(uint64_t sourceHash, const Generator& generate, LoadStats* stats)
+	{
+		LoadStats localStats{};
+		auto path = pathFor(sourceHash);
+		auto start = std::chrono::high_resolution_clock::now();
+
+		if (std::filesystem::exists(path))
+		{
+			try
+			{
+				auto meshFile = std::make_unique<LveMeshFile>(path);
+				if (meshFile->header().sourceHash == sourceHash)
+				{
+					localStats.cacheHit = true;
+					localStats.mapMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+					if (stats) *stats = localStats;
+					return meshFile;
+				}
+			}
+			catch (const std::exception& e)
+			{
+				// Stale or damaged entries are simply rebuilt
+				std::cerr << "Rebuilding mesh cache entry: " << e.what() << "\n";
+			}
+		}
+
+		std::vector<LveModel::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		generate(vertices, indices);
+		write(path, sourceHash, vertices, indices);
+		auto built = std::chrono::high_resolution_clock::now();
+
+		auto meshFile = std::make_unique<LveMeshFile>(path);
+		localStats.buildMs = std::chrono::duration<double, std::milli>(built - start).count();
+		localStats.mapMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - built).count();
+		if (stats) *stats = localStats;
+		return meshFile;
+	}
+
+	std::string LveMeshCache::pathFor(uint64_t sourceHash) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.lvem", static_cast<unsigned long long>(sourceHash));
+		return (std::filesystem::path(cacheDirectory) / name).string();
+	}
+
+	void LveMeshCache::write(
+		const std::string& filePath, uint64_t sourceHash,
+		const std::vector<LveModel::Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		// Blobs start on 16 byte boundaries so the mapped pointers are suitably aligned
+		auto alignUp = [](uint64_t value) { return (value + 15) & ~uint64_t(15); };
+
+		MeshFileHeader header{};
+		header.magic = MeshFileHeader::MAGIC;
+		header.version = MeshFileHeader::VERSION;
+		header.vertexStride = sizeof(LveModel::Vertex);
+		header.vertexCount = static_cast<uint32_t>(vertices.size());
+		header.indexCount = static_cast<uint32_t>(indices.size());
+		header.sourceHash = sourceHash;
+		header.vertexOffset = alignUp(sizeof(MeshFileHeader));
+		header.indexOffset = alignUp(header.vertexOffset + vertices.size() * sizeof(LveModel::Vertex));
+
+		glm::vec2 boundsMin{ vertices.empty() ? 0.0f : vertices[0].position.x, vertices.empty() ? 0.0f : vertices[0].position.y };
+		glm::vec2 boundsMax = boundsMin;
+		for (const auto& vertex : vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+		header.boundsMin[0] = boundsMin.x;
+		header.boundsMin[1] = boundsMin.y;
+		header.boundsMax[0] = boundsMax.x;
+		header.boundsMax[1] = boundsMax.y;
+
+		// Written next to the final name and renamed, so a reader never maps a half written file
+		auto tempPath = filePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				throw std::runtime_error("Failed to write mesh cache file: " + tempPath);
+
+			const char padding[16] = {};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(padding, header.vertexOffset - sizeof(header));
+			file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(LveModel::Vertex));
+			file.write(padding, header.indexOffset - (header.vertexOffset + vertices.size() * sizeof(LveModel::Vertex)));
+			file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+			if (!file)
+				throw std::runtime_error("Failed to write mesh cache file: " + tempPath);
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, filePath, error);
+		if (error)
+		{
+			std::filesystem::remove(filePath);
+			std::filesystem::rename(tempPath, filePath);
+		}
+	}
+
+	void LveMeshCache::parseText(const std::string& text, std::vector<LveModel::Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::istringstream input(text);
+		std::string line;
+		while (std::getline(input, line))
+		{
+			std::istringstream tokens(line);
+			std::string type;
+			tokens >> type;
+
+			if (type == "v")
+			{
+				// Positions are 2D, a z component is accepted and dropped, colors are the common OBJ extension
+				std::vector<float> values;
+				float value;
+				while (tokens >> value)
+					values.push_back(value);
+				if (values.size() < 2)
+					throw std::runtime_error("Mesh text vertex needs at least 2 components: " + line);
+
+				LveModel::Vertex vertex{};
+				vertex.position = { values[0], values[1] };
+				vertex.color = { 1.0f, 1.0f, 1.0f };
+				if (values.size() >= 6)
+					vertex.color = { values[3], values[4], values[5] };
+				else if (values.size() == 5)
+					vertex.color = { values[2], values[3], values[4] };
+				vertices.push_back(vertex);
+			}
+			else if (type == "f")
+			{
+				std::vector<uint32_t> face;
+				std::string corner;
+				while (tokens >> corner)
+				{
+					// "a/b/c" only refers to the position index, negative indices count from the end
+					long index = std::stol(corner.substr(0, corner.find('/')));
+					index = index < 0 ? static_cast<long>(vertices.size()) + index : index - 1;
+					if (index < 0 || index >= static_cast<long>(vertices.size()))
+						throw std::runtime_error("Mesh text face index out of range: " + line);
+					face.push_back(static_cast<uint32_t>(index));
+				}
+
+				// Polygons are triangulated as a fan
+				for (size_t i = 2; i < face.size(); ++i)
+				{
+					indices.push_back(face[0]);
+					indices.push_back(face[i - 1]);
+					indices.push_back(face[i]);
+				}
+			}
+		}
+	}
+
+	// 64 bit FNV-1a, cheap and good enough to name cache entries
+	uint64_t LveMeshCache::hash(const void* data, size_t size, uint64_t seed)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		uint64_t result = seed;
+		for (size_t i = 0; i < size; ++i)
+		{
+			result ^= bytes[i];
+			result *= 0x100000001b3ull;
+		}
+		return result;
+	}
+}
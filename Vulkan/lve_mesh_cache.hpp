@@ -0,0 +1,109 @@
+#pragma once
+
+#include "lve_model.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve
+{
+	// Layout of a cached mesh on disk. The vertex and index blobs are stored exactly as
+	// LveModel uploads them, so loading is only a memory map and one memcpy into staging
+	struct MeshFileHeader
+	{
+		static constexpr uint32_t MAGIC = 0x4D45564C; // "LVEM"
+		static constexpr uint32_t VERSION = 1;
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexStride;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t reserved;
+		uint64_t sourceHash;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		float boundsMin[2];
+		float boundsMax[2];
+	};
+	static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader layout is part of the file format");
+
+	// Read only memory mapping of a whole file, the pages are only touched when copied
+	class LveMappedFile
+	{
+	public:
+		explicit LveMappedFile(const std::string& filePath);
+		~LveMappedFile();
+
+		LveMappedFile(const LveMappedFile&) = delete;
+		LveMappedFile& operator=(const LveMappedFile&) = delete;
+
+		const uint8_t* data() const { return bytes; }
+		size_t size() const { return byteCount; }
+
+	private:
+		void release();
+
+		const uint8_t* bytes = nullptr;
+		size_t byteCount = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+
+	// A validated mesh file, its view points straight into the mapped pages
+	class LveMeshFile
+	{
+	public:
+		explicit LveMeshFile(const std::string& filePath);
+
+		const MeshFileHeader& header() const { return *reinterpret_cast<const MeshFileHeader*>(file.data()); }
+		LveModel::MeshView view() const;
+		glm::vec2 boundsMin() const { return { header().boundsMin[0], header().boundsMin[1] }; }
+		glm::vec2 boundsMax() const { return { header().boundsMax[0], header().boundsMax[1] }; }
+
+	private:
+		LveMappedFile file;
+	};
+
+	class LveMeshCache
+	{
+	public:
+		using Generator = std::function<void(std::vector<LveModel::Vertex>& vertices, std::vector<uint32_t>& indices)>;
+
+		struct LoadStats
+		{
+			bool cacheHit = false;
+			double buildMs = 0.0;
+			double mapMs = 0.0;
+		};
+
+		explicit LveMeshCache(std::string cacheDirectory = "cache");
+
+		// Generated meshes are keyed by a description of their parameters and the generator's
+		// version, e.g. "sierpinski:depth=10:v=1". A key that stays the same keeps the cached mesh.
+		// Different keys can be loaded from several threads at once
+		std::unique_ptr<LveMeshFile> load(const std::string& key, const Generator& generate, LoadStats* stats = nullptr);
+		// Text meshes (an OBJ subset, "v x y [z] [r g b]" and "f a b c ...") are keyed by their content
+		std::unique_ptr<LveMeshFile> loadText(const std::string& filePath, LoadStats* stats = nullptr);
+
+		static void write(
+			const std::string& filePath, uint64_t sourceHash,
+			const std::vector<LveModel::Vertex>& vertices, const std::vector<uint32_t>& indices);
+		static void parseText(const std::string& text, std::vector<LveModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+		static uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+	private:
+		std::unique_ptr<LveMeshFile> loadOrBuild(uint64_t sourceHash, const Generator& generate, LoadStats* stats);
+		std::string pathFor(uint64_t sourceHash) const;
+
+		std::string cacheDirectory;
+	};
+}
@@ -1,19 +1,35 @@
 #include "lve_model.hpp"
 
+#include "lve_trace.hpp"
+
+#include <cstring>
 #include <stdexcept>
 
 namespace lve
 {
 	LveModel::LveModel(LveDevice& device, const std::vector<Vertex>& vertices)
+		: LveModel(device, MeshView{ vertices.data(), static_cast<uint32_t>(vertices.size()) })
+	{
+	}
+
+	LveModel::LveModel(LveDevice& device, const MeshView& mesh)
 		: lveDevice(device)
 	{
-		createVertexBuffers(vertices);	
+		LVE_TRACE_SCOPE("uploadModel");
+		createVertexBuffers(mesh.vertices, mesh.vertexCount);
+		createIndexBuffers(mesh.indices, mesh.indexCount);
 	}
 
 	LveModel::~LveModel()
 	{
 		vkDestroyBuffer(lveDevice.device(), vertexBuffer, nullptr);
-		vkFreeMemory(lveDevice.device(), vertexBufferMemory, nullptr);
+		lveDevice.freeMemory(vertexBufferMemory);
+
+		if (hasIndexBuffer)
+		{
+			vkDestroyBuffer(lveDevice.device(), indexBuffer, nullptr);
+			lveDevice.freeMemory(indexBufferMemory);
+		}
 	}
 
 	void LveModel::bind(VkCommandBuffer commandBuffer)
@@ -22,37 +38,77 @@ namespace lve
 		VkDeviceSize offsets[] = { 0 };
 
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+		if (hasIndexBuffer)
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 	}
 
-	void LveModel::draw(VkCommandBuffer commandBuffer)
+	void LveModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
 	{
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+		if (hasIndexBuffer)
+			vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
+		else
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 	}
 
-	void LveModel::createVertexBuffers(const std::vector<Vertex>& vertices)
+	void LveModel::createVertexBuffers(const Vertex* vertices, uint32_t count)
 	{
-		vertexCount = static_cast<uint32_t>(vertices.size());
+		vertexCount = count;
 		if (vertexCount < 3)
 			throw std::runtime_error("Vertex Count has to be at least 3");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+		VkDeviceSize bufferSize = sizeof(Vertex) * vertexCount;
+
+		uploadThroughStaging(vertices, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+	}
+
+	void LveModel::createIndexBuffers(const uint32_t* indices, uint32_t count)
+	{
+		indexCount = count;
+		hasIndexBuffer = indexCount > 0;
+		if (!hasIndexBuffer)
+			return;
+		VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
+
+		uploadThroughStaging(indices, bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+	}
 
+	// The source is copied once, directly into a host visible staging buffer,
+	// and the GPU copies it into device local memory that is faster to read from
+	void LveModel::uploadThroughStaging(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+		VkBuffer& buffer, VkDeviceMemory& memory)
+	{
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
 		lveDevice.createBuffer(
-			bufferSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vertexBuffer,
-			vertexBufferMemory
+			stagingBuffer,
+			stagingBufferMemory
 		);
 
-		void* data;
-		vkMapMemory(lveDevice.device(), vertexBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), static_cast<uint32_t>(bufferSize));
-		vkUnmapMemory(lveDevice.device(), vertexBufferMemory);
+		void* mapped;
+		vkMapMemory(lveDevice.device(), stagingBufferMemory, 0, size, 0, &mapped);
+		memcpy(mapped, data, static_cast<size_t>(size));
+		vkUnmapMemory(lveDevice.device(), stagingBufferMemory);
+
+		lveDevice.createBuffer(
+			size,
+			usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			buffer,
+			memory
+		);
+
+		lveDevice.copyBuffer(stagingBuffer, buffer, size);
+
+		vkDestroyBuffer(lveDevice.device(), stagingBuffer, nullptr);
+		lveDevice.freeMemory(stagingBufferMemory);
 	}
 
-	std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getBindingDescriptions()
+	std::array<VkVertexInputBindingDescription, 1> LveModel::Vertex::getBindingDescriptions()
 	{
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		std::array<VkVertexInputBindingDescription, 1> bindingDescriptions{};
 		bindingDescriptions[0].binding = 0;
 		bindingDescriptions[0].stride = sizeof(Vertex);
 		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
@@ -60,9 +116,9 @@ namespace lve
 
 	}
 
-	std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDescriptions()
+	std::array<VkVertexInputAttributeDescription, 2> LveModel::Vertex::getAttributeDescriptions()
 	{
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
 		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
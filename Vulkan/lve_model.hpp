@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 
 // std
+#include <array>
 #include <vector>
 
 namespace lve
@@ -23,26 +24,46 @@ namespace lve
 			glm::vec2 position;
 			glm::vec3 color;
 
-			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			static std::array<VkVertexInputBindingDescription, 1> getBindingDescriptions();
+			static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+		};
+
+		// Non owning view over vertex and index data already in the layout we upload,
+		// so a memory mapped mesh file can be copied straight into the staging buffer
+		struct MeshView
+		{
+			const Vertex* vertices = nullptr;
+			uint32_t vertexCount = 0;
+			const uint32_t* indices = nullptr;
+			uint32_t indexCount = 0;
 		};
 
 		LveModel(LveDevice& device, const std::vector<Vertex>& vertices);
+		LveModel(LveDevice& device, const MeshView& mesh);
 		~LveModel();
 
 		LveModel(const LveModel&) = delete;
 		LveModel& operator=(const LveModel&) = delete;
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		// Instances are told apart by gl_InstanceIndex, which starts at firstInstance
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
 
 	private:
-		void createVertexBuffers(const std::vector<Vertex>& vertices);
+		void createVertexBuffers(const Vertex* vertices, uint32_t count);
+		void createIndexBuffers(const uint32_t* indices, uint32_t count);
+		void uploadThroughStaging(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+			VkBuffer& buffer, VkDeviceMemory& memory);
 
 		// So as most class we already have, it needs a reference to the device
 		LveDevice& lveDevice;
 		VkBuffer vertexBuffer;
 		VkDeviceMemory vertexBufferMemory;
 		uint32_t vertexCount;
+
+		bool hasIndexBuffer = false;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+		uint32_t indexCount = 0;
 	};
 }
\ No newline at end of file
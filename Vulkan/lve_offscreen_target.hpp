@@ -0,0 +1,52 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+namespace lve
+{
+	// A color and a depth image to render into without a window, the headless counterpart
+	// of the swap chain images. Uses dynamic rendering when the device does, a render pass
+	// and framebuffer otherwise. After endRendering the color image is in
+	// TRANSFER_SRC_OPTIMAL, ready to be copied out
+	class LveOffscreenTarget
+	{
+	public:
+		LveOffscreenTarget(LveDevice& device, VkExtent2D extent, VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM);
+		~LveOffscreenTarget();
+
+		LveOffscreenTarget(const LveOffscreenTarget&) = delete;
+		LveOffscreenTarget& operator=(const LveOffscreenTarget&) = delete;
+
+		// The render pass or the attachment formats, like FirstApp::setRenderTarget for the swap chain
+		void setRenderTarget(PipelineConfigInfo& configInfo) const;
+
+		// Waits for the last frame's rendering and copies out of the image, which is then cleared
+		void beginRendering(VkCommandBuffer commandBuffer, VkClearColorValue clearColor, VkClearDepthStencilValue clearDepthStencil);
+		void endRendering(VkCommandBuffer commandBuffer);
+
+		VkImage colorImage() const { return color; }
+		VkFormat colorFormat() const { return colorImageFormat; }
+		VkExtent2D extent() const { return targetExtent; }
+
+	private:
+		void createImages();
+		void createRenderPass();
+
+		LveDevice& lveDevice;
+		VkExtent2D targetExtent;
+		VkFormat colorImageFormat;
+		VkFormat depthFormat;
+
+		VkImage color = VK_NULL_HANDLE;
+		VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+		VkImageView colorView = VK_NULL_HANDLE;
+		VkImage depth = VK_NULL_HANDLE;
+		VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+		VkImageView depthView = VK_NULL_HANDLE;
+
+		// Only without dynamic rendering
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	};
+}
@@ -0,0 +1,328 @@
+#include "lve_particle_system.hpp"
+
+#include "lve_job_system.hpp"
+
+// std
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+namespace lve
+{
+	struct ParticlePushConstants
+	{
+		glm::vec2 attractor;
+		float deltaTime;
+		uint32_t count;
+	};
+
+	// Integer hash to a float in [0, 1), so every particle can be generated on its own
+	static float random01(uint32_t seed)
+	{
+		seed ^= seed >> 16;
+		seed *= 0x7feb352du;
+		seed ^= seed >> 15;
+		seed *= 0x846ca68bu;
+		seed ^= seed >> 16;
+		return static_cast<float>(seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	LveParticleSystem::LveParticleSystem(LveDevice& device, uint32_t particleCount, uint32_t timingSlots, VkQueue queue, VkCommandPool commandPool)
+		: lveDevice(device), particleCount(particleCount), timer(device, timingSlots)
+	{
+		if (particleCount == 0)
+			throw std::runtime_error("Particle Count has to be at least 1");
+		if (queue == lveDevice.graphicsQueue())
+			vertexStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+		createBuffers(queue, commandPool);
+		createDescriptorSets();
+		createComputePipeline();
+	}
+
+	LveParticleSystem::~LveParticleSystem()
+	{
+		drawPipeline = nullptr;
+		computePipeline = nullptr;
+		vkDestroyPipelineLayout(lveDevice.device(), drawLayout, nullptr);
+		vkDestroyPipelineLayout(lveDevice.device(), computeLayout, nullptr);
+		vkDestroyDescriptorPool(lveDevice.device(), descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(lveDevice.device(), setLayout, nullptr);
+		for (size_t i = 0; i < buffers.size(); ++i)
+		{
+			vkDestroyBuffer(lveDevice.device(), buffers[i], nullptr);
+			lveDevice.freeMemory(memories[i]);
+		}
+	}
+
+	void LveParticleSystem::createBuffers(VkQueue queue, VkCommandPool commandPool)
+	{
+		VkDeviceSize size = static_cast<VkDeviceSize>(particleCount) * sizeof(Particle);
+
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		lveDevice.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer,
+			stagingBufferMemory
+		);
+
+		// A disc of particles slowly circling its center, colored by where they start
+		void* mapped;
+		vkMapMemory(lveDevice.device(), stagingBufferMemory, 0, size, 0, &mapped);
+		auto particles = static_cast<Particle*>(mapped);
+		LveJobSystem::get().parallelFor(particleCount, 65536, [particles](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					uint32_t seed = static_cast<uint32_t>(i) * 2;
+					float radius = 0.8f * std::sqrt(random01(seed));
+					float angle = 6.2831853f * random01(seed + 1);
+					glm::vec2 direction{ std::cos(angle), std::sin(angle) };
+
+					Particle particle{};
+					particle.position = radius * direction;
+					particle.velocity = 0.25f * glm::vec2{ -direction.y, direction.x };
+					particle.color = { 0.5f + 0.5f * direction.x, 0.5f + 0.5f * direction.y, 1.0f - radius, 1.0f };
+					particles[i] = particle;
+				}
+			});
+		vkUnmapMemory(lveDevice.device(), stagingBufferMemory);
+
+		for (size_t i = 0; i < buffers.size(); ++i)
+		{
+			lveDevice.createBuffer(
+				size,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				buffers[i],
+				memories[i],
+				MemoryTag::Storage
+			);
+		}
+
+		// Copied on the queue that will use the buffers, they are exclusive to its family.
+		// Both start out the same, so the first step can read either
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Failed allocating command buffers");
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		VkBufferCopy copyRegion{};
+		copyRegion.size = size;
+		for (auto buffer : buffers)
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+		VkMemoryBarrier uploaded{};
+		uploaded.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		uploaded.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		uploaded.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &uploaded, 0, nullptr, 0, nullptr);
+		vkEndCommandBuffer(commandBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+		vkQueueWaitIdle(queue);
+		vkFreeCommandBuffers(lveDevice.device(), commandPool, 1, &commandBuffer);
+
+		vkDestroyBuffer(lveDevice.device(), stagingBuffer, nullptr);
+		lveDevice.freeMemory(stagingBufferMemory);
+	}
+
+	void LveParticleSystem::createDescriptorSets()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); ++i)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(lveDevice.device(), &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create particle descriptor set layout");
+
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = static_cast<uint32_t>(sets.size() * bindings.size());
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = static_cast<uint32_t>(sets.size());
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		if (vkCreateDescriptorPool(lveDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create particle descriptor pool");
+
+		std::array<VkDescriptorSetLayout, 2> layouts{ setLayout, setLayout };
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(sets.size());
+		allocInfo.pSetLayouts = layouts.data();
+		if (vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, sets.data()) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate particle descriptor sets");
+
+		for (uint32_t set = 0; set < sets.size(); ++set)
+		{
+			std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+			bufferInfos[0].buffer = buffers[set];
+			bufferInfos[0].range = VK_WHOLE_SIZE;
+			bufferInfos[1].buffer = buffers[set ^ 1];
+			bufferInfos[1].range = VK_WHOLE_SIZE;
+
+			std::array<VkWriteDescriptorSet, 2> writes{};
+			for (uint32_t i = 0; i < writes.size(); ++i)
+			{
+				writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[i].dstSet = sets[set];
+				writes[i].dstBinding = i;
+				writes[i].descriptorCount = 1;
+				writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writes[i].pBufferInfo = &bufferInfos[i];
+			}
+			vkUpdateDescriptorSets(lveDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+	}
+
+	void LveParticleSystem::createComputePipeline()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ParticlePushConstants);
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &setLayout;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(lveDevice.device(), &layoutInfo, nullptr, &computeLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed creating pipeline layout");
+
+		// local_size_x_id = 0 in particles.comp
+		SpecializationConstants specialization;
+		specialization.set(0, WORKGROUP_SIZE);
+		computePipeline = std::make_unique<LveComputePipeline>(lveDevice, "shaders/particles.comp.spv", computeLayout, specialization);
+
+		// Nothing bound for the draw, the particles come in as vertices
+		VkPipelineLayoutCreateInfo drawLayoutInfo{};
+		drawLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		if (vkCreatePipelineLayout(lveDevice.device(), &drawLayoutInfo, nullptr, &drawLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed creating pipeline layout");
+	}
+
+	void LveParticleSystem::createDrawPipeline(PipelineConfigInfo& configInfo)
+	{
+		if (vertexStage == 0)
+			throw std::runtime_error("Particles on a compute only queue cannot be drawn");
+
+		configInfo.bindingDescriptions = { { 0, sizeof(Particle), VK_VERTEX_INPUT_RATE_VERTEX } };
+		configInfo.attributeDescriptions = {
+			{ 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Particle, position) },
+			{ 1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Particle, color) },
+		};
+		configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+		// Dense regions glow instead of the last particle hiding the ones below it
+		configInfo.colorBlendAttachment.blendEnable = VK_TRUE;
+		configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.depthStencilInfo.depthTestEnable = VK_FALSE;
+		configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		configInfo.pipelineLayout = drawLayout;
+
+		drawPipeline = std::make_unique<LvePipeline>(lveDevice, "shaders/particles.vert.spv", "shaders/particles.frag.spv", configInfo);
+	}
+
+	void LveParticleSystem::simulate(VkCommandBuffer commandBuffer, float deltaTime, glm::vec2 attractor, int timingSlot, bool barriers)
+	{
+		// The last step's output is read now, and the buffer written now was read as vertices
+		// by the last draw, which only needs it to have finished
+		if (barriers)
+		{
+			VkMemoryBarrier before{};
+			before.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			before.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			before.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | vertexStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &before, 0, nullptr, 0, nullptr);
+		}
+
+		if (timingSlot >= 0)
+			timer.begin(commandBuffer, timingSlot);
+
+		computePipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &sets[source], 0, nullptr);
+		ParticlePushConstants push{ attractor, deltaTime, particleCount };
+		vkCmdPushConstants(commandBuffer, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(commandBuffer, (particleCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+		if (timingSlot >= 0)
+			timer.end(commandBuffer, timingSlot, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		if (barriers && vertexStage != 0)
+		{
+			VkMemoryBarrier after{};
+			after.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			after.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			after.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, vertexStage,
+				0, 1, &after, 0, nullptr, 0, nullptr);
+		}
+
+		source ^= 1;
+	}
+
+	void LveParticleSystem::draw(VkCommandBuffer commandBuffer)
+	{
+		if (drawPipeline == nullptr)
+			return;
+
+		drawPipeline->bind(commandBuffer);
+		VkBuffer vertexBuffers[] = { buffers[source] };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdDraw(commandBuffer, particleCount, 1, 0, 0);
+	}
+
+	void LveParticleSystem::collectTimings(uint32_t timingSlot)
+	{
+		double ms;
+		if (!timer.collect(timingSlot, ms))
+			return;
+		stats.gpuMs += ms;
+		++stats.steps;
+	}
+
+	LveParticleSystem::Stats LveParticleSystem::takeStats()
+	{
+		Stats taken = stats;
+		stats = {};
+		return taken;
+	}
+}
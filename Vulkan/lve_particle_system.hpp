@@ -0,0 +1,101 @@
+#pragma once
+
+#include "lve_compute_pipeline.hpp"
+#include "lve_device.hpp"
+#include "lve_gpu_timer.hpp"
+#include "lve_pipeline.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+
+namespace lve
+{
+	// Particles that never leave the GPU. particles.comp moves them from one storage buffer
+	// into the other, the buffers swap after every step, and the one written last is bound
+	// as the vertex buffer of a point list draw. Nothing is read back to the CPU.
+	class LveParticleSystem
+	{
+	public:
+		// Matches the std430 struct in particles.comp and the vertex inputs of particles.vert
+		struct Particle
+		{
+			glm::vec2 position;
+			glm::vec2 velocity;
+			glm::vec4 color;
+		};
+
+		struct Stats
+		{
+			uint32_t steps = 0;
+			double gpuMs = 0.0;
+		};
+
+		// timingSlots is the number of frames in flight, each gets its own pair of timestamps.
+		// The buffers are exclusive to the family of queue, the graphics queue when the
+		// particles are simulated in the same command buffers they are drawn from
+		LveParticleSystem(LveDevice& device, uint32_t particleCount, uint32_t timingSlots, VkQueue queue, VkCommandPool commandPool);
+		~LveParticleSystem();
+
+		LveParticleSystem(const LveParticleSystem&) = delete;
+		LveParticleSystem& operator=(const LveParticleSystem&) = delete;
+
+		// Only for particles on the graphics queue. configInfo has the render target set,
+		// the vertex input, topology, blending and layout are replaced
+		void createDrawPipeline(PipelineConfigInfo& configInfo);
+
+		// Outside of a render pass. Waits for the previous step and the draws reading its
+		// output, advances every particle by deltaTime and makes the result readable as
+		// vertices. timingSlot < 0 records no timestamps. Without barriers only the step is
+		// recorded, the caller orders it against the draws, e.g. a render graph
+		void simulate(VkCommandBuffer commandBuffer, float deltaTime, glm::vec2 attractor, int timingSlot = -1, bool barriers = true);
+		// Inside a render pass, draws the output of the last simulate
+		void draw(VkCommandBuffer commandBuffer);
+
+		// Adds the GPU time of the last step timed in this slot, call once its fence has signaled
+		void collectTimings(uint32_t timingSlot);
+		// Returns what collectTimings gathered since the last call
+		Stats takeStats();
+		bool hasTimestamps() const { return timer.available(); }
+
+		uint32_t size() const { return particleCount; }
+
+	private:
+		void createBuffers(VkQueue queue, VkCommandPool commandPool);
+		void createDescriptorSets();
+		void createComputePipeline();
+
+		static constexpr uint32_t WORKGROUP_SIZE = 256;
+
+		LveDevice& lveDevice;
+		uint32_t particleCount;
+		// On the graphics queue the steps also wait for and feed the vertex input stage,
+		// a compute only queue has no such stage
+		VkPipelineStageFlags vertexStage = 0;
+
+		// The step reads buffers[source] and writes the other one, draw reads buffers[source]
+		// after the swap
+		std::array<VkBuffer, 2> buffers{};
+		std::array<VkDeviceMemory, 2> memories{};
+		uint32_t source = 0;
+
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		// sets[i] reads buffers[i] and writes the other one
+		std::array<VkDescriptorSet, 2> sets{};
+		VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+		std::unique_ptr<LveComputePipeline> computePipeline;
+
+		VkPipelineLayout drawLayout = VK_NULL_HANDLE;
+		std::unique_ptr<LvePipeline> drawPipeline;
+
+		LveGpuTimer timer;
+		Stats stats;
+	};
+}
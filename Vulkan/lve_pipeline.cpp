@@ -1,21 +1,109 @@
 #include "lve_pipeline.hpp"
 
+#include "lve_job_system.hpp"
 #include "lve_model.hpp"
+#include "lve_trace.hpp"
 
 // std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <unordered_map>
+#include <cstring>
 #include<cassert>
 
 namespace lve
 {
+	static std::atomic<uint64_t> pipelinesCreated{ 0 };
+
+	// FNV-1a over the fields that make two pipelines different
+	static void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+
+	template<typename T>
+	static void hashValue(uint64_t& hash, const T& value)
+	{
+		hashBytes(hash, &value, sizeof(value));
+	}
+
+	// Runs task(i) for every i in [0, count), on the calling thread when threadCount is 1
+	// and spread over the job system otherwise. The first exception thrown by a task is
+	// rethrown once every task finished
+	template<typename Task>
+	static void runParallel(size_t count, uint32_t threadCount, Task task)
+	{
+		if (threadCount == 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+				task(i);
+			return;
+		}
+
+		LveJobSystem::get().parallelFor(count, 1, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					task(i);
+			});
+	}
+
+	void SpecializationConstants::setBytes(uint32_t constantId, const void* value, size_t size)
+	{
+		auto entry = std::lower_bound(entries.begin(), entries.end(), constantId,
+			[](const VkSpecializationMapEntry& item, uint32_t id) { return item.constantID < id; });
+
+		if (entry != entries.end() && entry->constantID == constantId && entry->size == size)
+		{
+			std::memcpy(data.data() + entry->offset, value, size);
+			return;
+		}
+		if (entry != entries.end() && entry->constantID == constantId)
+			entry = entries.erase(entry);
+
+		// Values are appended, a replaced one of another size just leaves its old bytes unused
+		VkSpecializationMapEntry newEntry{};
+		newEntry.constantID = constantId;
+		newEntry.offset = static_cast<uint32_t>(data.size());
+		newEntry.size = size;
+		entries.insert(entry, newEntry);
+
+		auto bytes = static_cast<const uint8_t*>(value);
+		data.insert(data.end(), bytes, bytes + size);
+	}
+
+	VkSpecializationInfo SpecializationConstants::info() const
+	{
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+		specializationInfo.pMapEntries = entries.data();
+		specializationInfo.dataSize = data.size();
+		specializationInfo.pData = data.data();
+		return specializationInfo;
+	}
+
 	LvePipeline::LvePipeline(LveDevice& device,
 		const std::string& vertFilePath, const std::string& fragFilePath,
-		const PipelineConfigInfo& configInfo)
+		const PipelineConfigInfo& configInfo, VkPipelineCache pipelineCache)
+		: lveDevice(device)
+	{
+		createGraphicsPipeline(readFile(vertFilePath), readFile(fragFilePath), configInfo, pipelineCache);
+	}
+
+	LvePipeline::LvePipeline(LveDevice& device,
+		const std::vector<char>& vertCode, const std::vector<char>& fragCode,
+		const PipelineConfigInfo& configInfo, VkPipelineCache pipelineCache)
 		: lveDevice(device)
 	{
-		createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
+		createGraphicsPipeline(vertCode, fragCode, configInfo, pipelineCache);
 	}
 
 	LvePipeline::~LvePipeline()
@@ -32,6 +120,11 @@ namespace lve
 
 	void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
 	{
+		auto bindings = LveModel::Vertex::getBindingDescriptions();
+		auto attributes = LveModel::Vertex::getAttributeDescriptions();
+		configInfo.bindingDescriptions.assign(bindings.begin(), bindings.end());
+		configInfo.attributeDescriptions.assign(attributes.begin(), attributes.end());
+
 		// This is the first stahe of our pipeline
 		// it takes the list of vertices and group as geometry
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -124,10 +217,147 @@ namespace lve
 		return buffer;
 	}
 
-	void LvePipeline::createGraphicsPipeline(
+	std::vector<PipelineBuildResult> LvePipeline::createBatch(
+		LveDevice& device,
+		const std::vector<PipelineBuildRequest>& requests,
+		uint32_t threadCount,
+		VkPipelineCache pipelineCache)
+	{
+		std::vector<PipelineBuildResult> results(requests.size());
+		std::vector<size_t> toBuild;
+		std::unordered_map<uint64_t, size_t> firstWithKey;
+		std::unordered_map<std::string, std::vector<char>> code;
+
+		for (size_t i = 0; i < requests.size(); ++i)
+		{
+			const auto& request = requests[i];
+			results[i].key = cacheKey(request.vertFilePath, request.fragFilePath, *request.configInfo);
+
+			auto [first, inserted] = firstWithKey.emplace(results[i].key, i);
+			if (!inserted)
+			{
+				results[i].duplicateOf = static_cast<int>(first->second);
+				continue;
+			}
+			toBuild.push_back(i);
+			code.emplace(request.vertFilePath, std::vector<char>{});
+			code.emplace(request.fragFilePath, std::vector<char>{});
+		}
+
+		// Variants mostly share shaders, so each file is read once, in parallel
+		std::vector<std::pair<const std::string, std::vector<char>>*> files;
+		for (auto& file : code)
+			files.push_back(&file);
+		runParallel(files.size(), threadCount, [&](size_t i)
+			{
+				files[i]->second = readFile(files[i]->first);
+			});
+
+		runParallel(toBuild.size(), threadCount, [&](size_t i)
+			{
+				const auto& request = requests[toBuild[i]];
+				auto& result = results[toBuild[i]];
+
+				auto start = std::chrono::high_resolution_clock::now();
+				result.pipeline = std::make_unique<LvePipeline>(
+					device, code.at(request.vertFilePath), code.at(request.fragFilePath), *request.configInfo, pipelineCache);
+				std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+				result.compileMs = duration.count();
+			});
+
+		return results;
+	}
+
+	uint64_t LvePipeline::cacheKey(
 		const std::string& vertFilePath, const std::string& fragFilePath,
 		const PipelineConfigInfo& configInfo)
 	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		hashBytes(hash, vertFilePath.data(), vertFilePath.size() + 1);
+		hashBytes(hash, fragFilePath.data(), fragFilePath.size() + 1);
+
+		for (const auto& binding : configInfo.bindingDescriptions)
+		{
+			hashValue(hash, binding.binding);
+			hashValue(hash, binding.stride);
+			hashValue(hash, binding.inputRate);
+		}
+		for (const auto& attribute : configInfo.attributeDescriptions)
+		{
+			hashValue(hash, attribute.location);
+			hashValue(hash, attribute.binding);
+			hashValue(hash, attribute.format);
+			hashValue(hash, attribute.offset);
+		}
+
+		hashValue(hash, configInfo.inputAssemblyInfo.topology);
+		hashValue(hash, configInfo.inputAssemblyInfo.primitiveRestartEnable);
+
+		const auto& raster = configInfo.rasterizationInfo;
+		hashValue(hash, raster.depthClampEnable);
+		hashValue(hash, raster.rasterizerDiscardEnable);
+		hashValue(hash, raster.polygonMode);
+		hashValue(hash, raster.cullMode);
+		hashValue(hash, raster.frontFace);
+		hashValue(hash, raster.depthBiasEnable);
+		hashValue(hash, raster.depthBiasConstantFactor);
+		hashValue(hash, raster.depthBiasClamp);
+		hashValue(hash, raster.depthBiasSlopeFactor);
+		hashValue(hash, raster.lineWidth);
+
+		hashValue(hash, configInfo.multisampleInfo.rasterizationSamples);
+		hashValue(hash, configInfo.multisampleInfo.sampleShadingEnable);
+		hashValue(hash, configInfo.multisampleInfo.alphaToCoverageEnable);
+
+		const auto& blend = configInfo.colorBlendAttachment;
+		hashValue(hash, blend.blendEnable);
+		hashValue(hash, blend.srcColorBlendFactor);
+		hashValue(hash, blend.dstColorBlendFactor);
+		hashValue(hash, blend.colorBlendOp);
+		hashValue(hash, blend.srcAlphaBlendFactor);
+		hashValue(hash, blend.dstAlphaBlendFactor);
+		hashValue(hash, blend.alphaBlendOp);
+		hashValue(hash, blend.colorWriteMask);
+		hashValue(hash, configInfo.colorBlendInfo.logicOpEnable);
+		hashValue(hash, configInfo.colorBlendInfo.logicOp);
+
+		const auto& depth = configInfo.depthStencilInfo;
+		hashValue(hash, depth.depthTestEnable);
+		hashValue(hash, depth.depthWriteEnable);
+		hashValue(hash, depth.depthCompareOp);
+		hashValue(hash, depth.depthBoundsTestEnable);
+		hashValue(hash, depth.stencilTestEnable);
+
+		for (auto state : configInfo.dynamicsStateEnables)
+			hashValue(hash, state);
+
+		// Only the values matter, not where they sit in the data blob
+		for (const auto* specialization : { &configInfo.vertSpecialization, &configInfo.fragSpecialization })
+		{
+			hashValue(hash, specialization->mapEntries().size());
+			for (const auto& entry : specialization->mapEntries())
+			{
+				hashValue(hash, entry.constantID);
+				hashValue(hash, entry.size);
+				hashBytes(hash, specialization->bytes().data() + entry.offset, entry.size);
+			}
+		}
+
+		hashValue(hash, configInfo.pipelineLayout);
+		hashValue(hash, configInfo.renderPass);
+		hashValue(hash, configInfo.subpass);
+		for (auto format : configInfo.colorAttachmentFormats)
+			hashValue(hash, format);
+		hashValue(hash, configInfo.depthAttachmentFormat);
+		hashValue(hash, configInfo.stencilAttachmentFormat);
+		return hash;
+	}
+
+	void LvePipeline::createGraphicsPipeline(
+		const std::vector<char>& vertCode, const std::vector<char>& fragCode,
+		const PipelineConfigInfo& configInfo, VkPipelineCache pipelineCache)
+	{
+		LVE_TRACE_SCOPE("createGraphicsPipeline");
 
 		/*assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
 			"Cannor create Graphics pipeline: No pipeline layout provided in configInfo");
@@ -135,12 +365,12 @@ namespace lve
 		assert(configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannor create Graphics pipeline: No pipeline renderPass provided in configInfo");*/
 
-		auto vertCode = readFile(vertFilePath);
-		auto fragCode = readFile(fragFilePath);
-
 		createShaderModule(vertCode, &vertShaderModule);
 		createShaderModule(fragCode, &fragShaderModule);
 
+		VkSpecializationInfo vertSpecializationInfo = configInfo.vertSpecialization.info();
+		VkSpecializationInfo fragSpecializationInfo = configInfo.fragSpecialization.info();
+
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		// Vertex Shader
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -149,7 +379,7 @@ namespace lve
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = configInfo.vertSpecialization.empty() ? nullptr : &vertSpecializationInfo;
 		
 		// Fragment Shader
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -158,10 +388,10 @@ namespace lve
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo = configInfo.fragSpecialization.empty() ? nullptr : &fragSpecializationInfo;
 
-		auto bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
-		auto attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
+		const auto& bindingDescriptions = configInfo.bindingDescriptions;
+		const auto& attributeDescriptions = configInfo.attributeDescriptions;
 
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -187,14 +417,35 @@ namespace lve
 		pipelineInfo.renderPass = configInfo.renderPass;
 		pipelineInfo.subpass = configInfo.subpass;
 
+		// Without a render pass the pipeline only needs to know the attachment formats
+		VkPipelineRenderingCreateInfoKHR renderingInfo{};
+		if (configInfo.renderPass == VK_NULL_HANDLE)
+		{
+			renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+			renderingInfo.colorAttachmentCount = static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+			renderingInfo.pColorAttachmentFormats = configInfo.colorAttachmentFormats.data();
+			renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+			renderingInfo.stencilAttachmentFormat = configInfo.stencilAttachmentFormat;
+			pipelineInfo.pNext = &renderingInfo;
+		}
+
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-		if (vkCreateGraphicsPipelines(lveDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+		if (pipelineCache == VK_NULL_HANDLE)
+			pipelineCache = lveDevice.getPipelineCache();
+
+		if (vkCreateGraphicsPipelines(lveDevice.device(), pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create graphics pipeline!");
 		}
+		pipelinesCreated.fetch_add(1, std::memory_order_relaxed);
+
+	}
 
+	uint64_t LvePipeline::createdCount()
+	{
+		return pipelinesCreated.load(std::memory_order_relaxed);
 	}
 
 	void LvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
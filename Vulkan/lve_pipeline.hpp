@@ -1,12 +1,49 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <iostream>
 
 namespace lve
 {
+	// Values for the "layout (constant_id = N) const ..." declarations of one shader stage.
+	// They are baked in when the pipeline is created, so the driver folds them like literals
+	class SpecializationConstants
+	{
+	public:
+		// bool, int32_t, uint32_t, float, int64_t, uint64_t and double, matching the GLSL types
+		template<typename T>
+		void set(uint32_t constantId, T value)
+		{
+			static_assert(std::is_arithmetic_v<T> && (sizeof(T) == 4 || sizeof(T) == 8 || std::is_same_v<T, bool>),
+				"Specialization constants are bool or 32/64 bit scalars");
+			if constexpr (std::is_same_v<T, bool>)
+			{
+				VkBool32 word = value ? VK_TRUE : VK_FALSE;
+				setBytes(constantId, &word, sizeof(word));
+			}
+			else
+				setBytes(constantId, &value, sizeof(T));
+		}
+
+		bool empty() const { return entries.empty(); }
+		const std::vector<VkSpecializationMapEntry>& mapEntries() const { return entries; }
+		const std::vector<uint8_t>& bytes() const { return data; }
+
+		// Points into this object, it has to outlive the pipeline creation
+		VkSpecializationInfo info() const;
+
+	private:
+		void setBytes(uint32_t constantId, const void* value, size_t size);
+
+		// Kept sorted by constantID so equal sets of constants hash the same
+		std::vector<VkSpecializationMapEntry> entries;
+		std::vector<uint8_t> data;
+	};
 
 	struct PipelineConfigInfo
 	{
@@ -14,6 +51,9 @@ namespace lve
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
 		PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
+		// LveModel::Vertex by default, pipelines reading other buffers replace them
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 		VkPipelineViewportStateCreateInfo viewportInfo;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -26,16 +66,50 @@ namespace lve
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// Used instead of renderPass when it is null, for dynamic rendering
+		std::vector<VkFormat> colorAttachmentFormats;
+		VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+		VkFormat stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+		SpecializationConstants vertSpecialization;
+		SpecializationConstants fragSpecialization;
+	};
+
+	class LvePipeline;
+
+	// One entry of a batch build, configInfo is owned by the caller and must outlive the build
+	struct PipelineBuildRequest
+	{
+		std::string vertFilePath;
+		std::string fragFilePath;
+		const PipelineConfigInfo* configInfo = nullptr;
+	};
+
+	struct PipelineBuildResult
+	{
+		std::unique_ptr<LvePipeline> pipeline;
+		uint64_t key = 0;
+		double compileMs = 0.0;
+		// Requests with the same key are built once, the others point at that result
+		int duplicateOf = -1;
 	};
 
 	class LvePipeline
 	{
 	public:
+		// A null pipelineCache means the cache shared through LveDevice
 		LvePipeline(
 			LveDevice& device,
 			const std::string& vertFilePath, 
 			const std::string& fragFilePath,
-			const PipelineConfigInfo& configInfo
+			const PipelineConfigInfo& configInfo,
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE
+		);
+		LvePipeline(
+			LveDevice& device,
+			const std::vector<char>& vertCode,
+			const std::vector<char>& fragCode,
+			const PipelineConfigInfo& configInfo,
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE
 		);
 		~LvePipeline();
 
@@ -45,12 +119,28 @@ namespace lve
 		void bind(VkCommandBuffer commandBuffer);
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
-	private:
-		static std::vector<char> readFile(const std::string& filePath);
-		void createGraphicsPipeline(
+		// Reads every distinct SPIR-V file once and creates the pipelines concurrently on
+		// the job system, threadCount 1 builds them one after another on the calling thread
+		static std::vector<PipelineBuildResult> createBatch(
+			LveDevice& device,
+			const std::vector<PipelineBuildRequest>& requests,
+			uint32_t threadCount = 0,
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE
+		);
+		// Identifies the shaders and fixed function state a pipeline is built from
+		static uint64_t cacheKey(
 			const std::string& vertFilePath, const std::string& fragFilePath,
 			const PipelineConfigInfo& configInfo
 		);
+		static std::vector<char> readFile(const std::string& filePath);
+		// Graphics pipelines created since the start of the process, on any thread
+		static uint64_t createdCount();
+
+	private:
+		void createGraphicsPipeline(
+			const std::vector<char>& vertCode, const std::vector<char>& fragCode,
+			const PipelineConfigInfo& configInfo, VkPipelineCache pipelineCache
+		);
 
 		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 
@@ -0,0 +1,434 @@
+#include "lve_readback.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace lve
+{
+	LveReadback::LveReadback(LveDevice& device, uint32_t bufferCount) : lveDevice{ device }
+	{
+		for (uint32_t i = 0; i < std::max(bufferCount, 1u); ++i)
+			buffers.push_back(std::make_unique<Buffer>());
+	}
+
+	LveReadback::~LveReadback()
+	{
+		// The consumers read the mapped buffers, they have to be done before those go
+		try
+		{
+			flush();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Readback: " << e.what() << "\n";
+		}
+		for (auto& buffer : buffers)
+			release(*buffer);
+	}
+
+	bool LveReadback::supportsFormat(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void LveReadback::allocate(Buffer& buffer, VkDeviceSize size)
+	{
+		release(buffer);
+
+		// The CPU reads every byte, from uncached memory that is many times slower than the copy itself.
+		// Only the types a transfer destination can be bound to count
+		uint32_t typeBits = lveDevice.bufferMemoryTypeBits(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		if (lveDevice.memoryTypeProperties(typeBits, properties) == 0)
+			properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		lveDevice.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, buffer.buffer, buffer.memory, MemoryTag::Staging);
+
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(lveDevice.device(), buffer.buffer, &requirements);
+		buffer.coherent = (lveDevice.memoryTypeProperties(requirements.memoryTypeBits, properties) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+		// Stays mapped, like the dynamic model's buffer
+		void* pointer;
+		if (vkMapMemory(lveDevice.device(), buffer.memory, 0, VK_WHOLE_SIZE, 0, &pointer) != VK_SUCCESS)
+			throw std::runtime_error("Failed to map readback buffer");
+		buffer.mapped = static_cast<const uint8_t*>(pointer);
+		buffer.size = size;
+	}
+
+	void LveReadback::release(Buffer& buffer)
+	{
+		if (buffer.buffer == VK_NULL_HANDLE)
+			return;
+		vkUnmapMemory(lveDevice.device(), buffer.memory);
+		vkDestroyBuffer(lveDevice.device(), buffer.buffer, nullptr);
+		lveDevice.freeMemory(buffer.memory);
+		buffer.buffer = VK_NULL_HANDLE;
+		buffer.memory = VK_NULL_HANDLE;
+		buffer.mapped = nullptr;
+		buffer.size = 0;
+	}
+
+	bool LveReadback::copy(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image, VkImageLayout layout,
+		VkExtent2D extent, VkFormat format, uint64_t frame, Consumer consumer)
+	{
+		if (!supportsFormat(format))
+			throw std::runtime_error("Readback only supports 8 bit RGBA and BGRA images");
+
+		Buffer* target = nullptr;
+		uint32_t count = static_cast<uint32_t>(buffers.size());
+		for (uint32_t i = 0; i < count && target == nullptr; ++i)
+		{
+			uint32_t index = (nextBuffer + i) % count;
+			if (buffers[index]->state.load(std::memory_order_acquire) == State::Free)
+			{
+				target = buffers[index].get();
+				nextBuffer = (index + 1) % count;
+			}
+		}
+		if (target == nullptr)
+		{
+			++dropped;
+			return false;
+		}
+
+		VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+		if (target->size < size)
+			allocate(*target, size);
+		target->state.store(State::Copying, std::memory_order_relaxed);
+		target->frameIndex = frameIndex;
+		target->image = { nullptr, extent.width, extent.height, format, frame };
+		target->consumer = std::move(consumer);
+
+		VkImageMemoryBarrier toTransfer{};
+		toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		toTransfer.oldLayout = layout;
+		toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.image = image;
+		toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		bool transition = layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		if (transition)
+		{
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+		}
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target->buffer, 1, &region);
+
+		// Back to where it was, presentation waits on the semaphore so nothing has to wait here
+		if (transition)
+		{
+			VkImageMemoryBarrier back = toTransfer;
+			back.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			back.dstAccessMask = 0;
+			back.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			back.newLayout = layout;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &back);
+		}
+
+		// The fence only orders the copy with the host, this makes its writes visible to it
+		VkBufferMemoryBarrier toHost{};
+		toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toHost.buffer = target->buffer;
+		toHost.offset = 0;
+		toHost.size = size;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+			0, 0, nullptr, 1, &toHost, 0, nullptr);
+		return true;
+	}
+
+	void LveReadback::complete(uint32_t frameIndex)
+	{
+		for (auto& buffer : buffers)
+		{
+			if (buffer->state.load(std::memory_order_relaxed) != State::Copying || buffer->frameIndex != frameIndex)
+				continue;
+			buffer->state.store(State::Consuming, std::memory_order_relaxed);
+			LveJobSystem::get().run([this, target = buffer.get()]() { consume(*target); }, &consumers);
+		}
+	}
+
+	void LveReadback::consume(Buffer& buffer)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!buffer.coherent)
+		{
+			VkMappedMemoryRange range{};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = buffer.memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(lveDevice.device(), 1, &range);
+		}
+
+		// Freed even when the consumer throws, the job system keeps the exception for flush()
+		struct Release
+		{
+			std::atomic<State>& state;
+			~Release() { state.store(State::Free, std::memory_order_release); }
+		} release{ buffer.state };
+
+		ReadbackImage image = buffer.image;
+		image.pixels = buffer.mapped;
+		try
+		{
+			buffer.consumer(image);
+		}
+		catch (...)
+		{
+			failed.fetch_add(1, std::memory_order_relaxed);
+			throw;
+		}
+
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		consumeMicroseconds.fetch_add(static_cast<uint64_t>(us), std::memory_order_relaxed);
+		copied.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void LveReadback::flush()
+	{
+		LveJobSystem::get().wait(consumers);
+	}
+
+	LveReadback::Stats LveReadback::takeStats()
+	{
+		Stats stats{};
+		stats.copied = copied.exchange(0, std::memory_order_relaxed);
+		stats.dropped = dropped;
+		stats.failed = failed.exchange(0, std::memory_order_relaxed);
+		stats.consumeMs = consumeMicroseconds.exchange(0, std::memory_order_relaxed) / 1000.0;
+		dropped = 0;
+		return stats;
+	}
+
+	static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		static const auto table = []
+		{
+			std::array<uint32_t, 256> entries{};
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int bit = 0; bit < 8; ++bit)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				entries[i] = c;
+			}
+			return entries;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	static uint32_t adler32(const uint8_t* data, size_t size)
+	{
+		// 5552 bytes is the most that can be summed before the 32 bit sums could overflow
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while (size > 0)
+		{
+			size_t block = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < block; ++i)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += block;
+			size -= block;
+		}
+		return (b << 16) | a;
+	}
+
+	static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	static void appendChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+	{
+		appendBigEndian(out, static_cast<uint32_t>(size));
+		size_t typeStart = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		appendBigEndian(out, crc32(out.data() + typeStart, size + 4));
+	}
+
+	void LveReadback::writePng(const std::string& filePath, const ReadbackImage& image)
+	{
+		// RGB, the alpha of a presented image means nothing. Every row starts with filter 0
+		bool bgra = image.format == VK_FORMAT_B8G8R8A8_UNORM || image.format == VK_FORMAT_B8G8R8A8_SRGB;
+		size_t rowBytes = 1 + static_cast<size_t>(image.width) * 3;
+		std::vector<uint8_t> rows(rowBytes * image.height);
+		for (uint32_t y = 0; y < image.height; ++y)
+		{
+			const uint8_t* in = image.pixels + static_cast<size_t>(y) * image.width * 4;
+			uint8_t* out = rows.data() + y * rowBytes;
+			*out++ = 0;
+			for (uint32_t x = 0; x < image.width; ++x, in += 4, out += 3)
+			{
+				out[0] = in[bgra ? 2 : 0];
+				out[1] = in[1];
+				out[2] = in[bgra ? 0 : 2];
+			}
+		}
+
+		// zlib stream of stored blocks, at most 65535 bytes each
+		constexpr size_t maxBlock = 65535;
+		size_t blockCount = std::max<size_t>(1, (rows.size() + maxBlock - 1) / maxBlock);
+		std::vector<uint8_t> zlib;
+		zlib.reserve(2 + rows.size() + blockCount * 5 + 4);
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+		for (size_t offset = 0, block = 0; block < blockCount; ++block, offset += maxBlock)
+		{
+			size_t size = std::min(maxBlock, rows.size() - offset);
+			uint16_t length = static_cast<uint16_t>(size);
+			uint16_t inverse = static_cast<uint16_t>(~length);
+			zlib.push_back(block + 1 == blockCount ? 1 : 0);
+			zlib.push_back(static_cast<uint8_t>(length));
+			zlib.push_back(static_cast<uint8_t>(length >> 8));
+			zlib.push_back(static_cast<uint8_t>(inverse));
+			zlib.push_back(static_cast<uint8_t>(inverse >> 8));
+			zlib.insert(zlib.end(), rows.begin() + offset, rows.begin() + offset + size);
+		}
+		appendBigEndian(zlib, adler32(rows.data(), rows.size()));
+
+		std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		png.reserve(png.size() + 25 + zlib.size() + 12 + 12);
+		std::vector<uint8_t> header;
+		appendBigEndian(header, image.width);
+		appendBigEndian(header, image.height);
+		// 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+		header.insert(header.end(), { 8, 2, 0, 0, 0 });
+		appendChunk(png, "IHDR", header.data(), header.size());
+		appendChunk(png, "IDAT", zlib.data(), zlib.size());
+		appendChunk(png, "IEND", nullptr, 0);
+
+		std::ofstream file{ filePath, std::ios::binary | std::ios::trunc };
+		if (!file.write(reinterpret_cast<const char*>(png.data()), png.size()))
+			throw std::runtime_error("Failed to write " + filePath);
+	}
+
+	void LveReadback::writeRaw(const std::string& filePath, const ReadbackImage& image)
+	{
+		std::ofstream file{ filePath, std::ios::binary | std::ios::trunc };
+		size_t size = static_cast<size_t>(image.width) * image.height * 4;
+		if (!file.write(reinterpret_cast<const char*>(image.pixels), size))
+			throw std::runtime_error("Failed to write " + filePath);
+	}
+
+	static uint32_t readBigEndian(const uint8_t* data)
+	{
+		return (uint32_t{ data[0] } << 24) | (uint32_t{ data[1] } << 16) | (uint32_t{ data[2] } << 8) | data[3];
+	}
+
+	std::vector<uint8_t> LveReadback::readPng(const std::string& filePath, uint32_t& width, uint32_t& height)
+	{
+		std::ifstream file{ filePath, std::ios::binary };
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open " + filePath);
+		std::vector<uint8_t> png{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+		auto unsupported = [&filePath]() { return std::runtime_error(filePath + " is not a PNG as writePng writes them"); };
+
+		const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (png.size() < sizeof(signature) || !std::equal(std::begin(signature), std::end(signature), png.begin()))
+			throw unsupported();
+
+		// Chunks as written, the IDAT ones are one zlib stream
+		std::vector<uint8_t> zlib;
+		bool header = false;
+		for (size_t offset = sizeof(signature); offset + 12 <= png.size();)
+		{
+			uint32_t size = readBigEndian(png.data() + offset);
+			if (size > png.size() - offset - 12)
+				throw unsupported();
+			const uint8_t* type = png.data() + offset + 4;
+			const uint8_t* data = type + 4;
+			if (std::equal(type, type + 4, "IHDR"))
+			{
+				const uint8_t rgb8[] = { 8, 2, 0, 0, 0 };
+				if (size != 13 || !std::equal(std::begin(rgb8), std::end(rgb8), data + 8))
+					throw unsupported();
+				width = readBigEndian(data);
+				height = readBigEndian(data + 4);
+				header = true;
+			}
+			else if (std::equal(type, type + 4, "IDAT"))
+				zlib.insert(zlib.end(), data, data + size);
+			offset += 12 + size;
+		}
+		if (!header || zlib.size() < 6)
+			throw unsupported();
+
+		// Stored blocks only, each a final flag, the length and its complement
+		size_t rowBytes = 1 + static_cast<size_t>(width) * 3;
+		std::vector<uint8_t> rows;
+		rows.reserve(rowBytes * height);
+		size_t offset = 2;
+		bool final = false;
+		while (!final)
+		{
+			if (offset + 5 > zlib.size() || (zlib[offset] & 0x06) != 0)
+				throw unsupported();
+			final = (zlib[offset] & 1) != 0;
+			size_t length = zlib[offset + 1] | (zlib[offset + 2] << 8);
+			offset += 5;
+			if (length > zlib.size() - offset)
+				throw unsupported();
+			rows.insert(rows.end(), zlib.begin() + offset, zlib.begin() + offset + length);
+			offset += length;
+		}
+		if (rows.size() != rowBytes * height)
+			throw unsupported();
+
+		std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			if (rows[y * rowBytes] != 0)
+				throw unsupported();
+			std::copy_n(rows.begin() + y * rowBytes + 1, rowBytes - 1, rgb.begin() + y * (rowBytes - 1));
+		}
+		return rgb;
+	}
+}
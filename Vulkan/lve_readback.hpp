@@ -0,0 +1,116 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_job_system.hpp"
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve
+{
+	// Pixels of a copied image, 4 bytes per pixel in the image's own channel order, rows
+	// packed without padding. Only valid inside the consumer it is given to
+	struct ReadbackImage
+	{
+		const uint8_t* pixels;
+		uint32_t width;
+		uint32_t height;
+		VkFormat format;
+		// What copy() was given, to name or order the images by
+		uint64_t frame;
+	};
+
+	// Copies rendered images into a ring of host visible buffers without waiting for them.
+	// The copy is recorded into the frame's command buffer, once the frame's fence has
+	// signaled a worker maps the buffer and hands the pixels to a consumer, which encodes
+	// or compares them off the render thread. When every buffer is still in use the image
+	// is dropped instead of stalling the frame
+	class LveReadback
+	{
+	public:
+		using Consumer = std::function<void(const ReadbackImage&)>;
+
+		struct Stats
+		{
+			uint32_t copied = 0;
+			uint32_t dropped = 0;
+			// Consumers that threw, e.g. a file that could not be written
+			uint32_t failed = 0;
+			// Time the consumers took, on the workers
+			double consumeMs = 0.0;
+		};
+
+		// bufferCount is how many images can be in flight or waiting for a worker at once
+		LveReadback(LveDevice& device, uint32_t bufferCount);
+		// Waits for the consumers that are already running, copies that never completed are lost
+		~LveReadback();
+
+		LveReadback(const LveReadback&) = delete;
+		LveReadback& operator=(const LveReadback&) = delete;
+
+		// 8 bit RGBA or BGRA, the formats the encoders understand
+		static bool supportsFormat(VkFormat format);
+
+		// Records a copy of image, which is in layout before and after. Images in
+		// TRANSFER_SRC_OPTIMAL have to be made visible to transfers already, every other
+		// layout is taken as the end of color attachment writes. Returns false when no
+		// buffer is free and the image is dropped
+		bool copy(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image, VkImageLayout layout,
+			VkExtent2D extent, VkFormat format, uint64_t frame, Consumer consumer);
+		// Call once the fence of frameIndex has signaled, its copies go to the workers.
+		// Consumers run concurrently and in any order
+		void complete(uint32_t frameIndex);
+		// Waits for every consumer that was started and rethrows the first exception one threw
+		void flush();
+
+		Stats takeStats();
+
+		// Stored deflate blocks, no compression, so writing costs little more than the copy
+		static void writePng(const std::string& filePath, const ReadbackImage& image);
+		// The pixels as they are, for tools that are told the size and format
+		static void writeRaw(const std::string& filePath, const ReadbackImage& image);
+		// Reads back what writePng wrote, 8 bit RGB rows, and throws on any other PNG
+		static std::vector<uint8_t> readPng(const std::string& filePath, uint32_t& width, uint32_t& height);
+
+	private:
+		enum class State : uint32_t
+		{
+			Free,
+			Copying,
+			Consuming
+		};
+
+		struct Buffer
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			const uint8_t* mapped = nullptr;
+			VkDeviceSize size = 0;
+			bool coherent = true;
+			std::atomic<State> state{ State::Free };
+			uint32_t frameIndex = 0;
+			ReadbackImage image{};
+			Consumer consumer;
+		};
+
+		void allocate(Buffer& buffer, VkDeviceSize size);
+		void release(Buffer& buffer);
+		void consume(Buffer& buffer);
+
+		LveDevice& lveDevice;
+		std::vector<std::unique_ptr<Buffer>> buffers;
+		// Where the search for a free buffer starts, so they are used round robin
+		uint32_t nextBuffer = 0;
+		LveJobSystem::Counter consumers;
+
+		uint32_t dropped = 0;
+		std::atomic<uint32_t> copied{ 0 };
+		std::atomic<uint32_t> failed{ 0 };
+		std::atomic<uint64_t> consumeMicroseconds{ 0 };
+	};
+}
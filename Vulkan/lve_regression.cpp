@@ -0,0 +1,226 @@
+#include "lve_regression.hpp"
+
+#include "lve_readback.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace lve
+{
+	// Frames rendered before measuring, so pipelines and memory are warm
+	static constexpr uint32_t WARMUP_FRAMES = 10;
+	static constexpr uint32_t MEASURED_FRAMES = 100;
+	// Rasterizers may round edges differently between versions, a few pixels may differ by a little
+	static constexpr int PIXEL_TOLERANCE = 2;
+	static constexpr double DIFFERENT_PIXELS_TOLERANCE = 0.001;
+	// Frame times are noisy even on a software rasterizer, counts have to be exact
+	static constexpr double FRAME_TIME_TOLERANCE = 0.2;
+	static constexpr double FRAME_TIME_SLACK_MS = 0.05;
+
+	struct Baseline
+	{
+		std::string device;
+		// "<scene> <metric>" to the stored value
+		std::map<std::string, double> values;
+	};
+
+	static Baseline loadBaseline(const std::filesystem::path& path)
+	{
+		std::ifstream file{ path };
+		if (!file.is_open())
+			throw std::runtime_error("No baseline at " + path.string() + ", store one with --regress-update first");
+
+		Baseline baseline;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+			if (line.rfind("device ", 0) == 0)
+			{
+				baseline.device = line.substr(7);
+				continue;
+			}
+			std::istringstream fields{ line };
+			std::string scene, metric;
+			double value;
+			if (fields >> scene >> metric >> value)
+				baseline.values[scene + " " + metric] = value;
+		}
+		return baseline;
+	}
+
+	static uint32_t deviceAllocations(const LveDevice& device)
+	{
+		uint32_t count = 0;
+		for (const auto& tag : device.memoryStats().tags)
+			count += tag.allocations;
+		return count;
+	}
+
+	struct ImageDifference
+	{
+		uint32_t differentPixels = 0;
+		int maxDifference = 0;
+	};
+
+	static ImageDifference compareImages(const std::vector<uint8_t>& goldenRgb, const ReadbackImage& image)
+	{
+		bool bgra = image.format == VK_FORMAT_B8G8R8A8_UNORM || image.format == VK_FORMAT_B8G8R8A8_SRGB;
+		ImageDifference difference{};
+		size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			const uint8_t* actual = image.pixels + i * 4;
+			const uint8_t* golden = goldenRgb.data() + i * 3;
+			int rgb[] = { actual[bgra ? 2 : 0], actual[1], actual[bgra ? 0 : 2] };
+			int pixelDifference = 0;
+			for (int channel = 0; channel < 3; ++channel)
+				pixelDifference = std::max(pixelDifference, std::abs(rgb[channel] - golden[channel]));
+			difference.maxDifference = std::max(difference.maxDifference, pixelDifference);
+			if (pixelDifference > PIXEL_TOLERANCE)
+				++difference.differentPixels;
+		}
+		return difference;
+	}
+
+	bool LveRegression::run(const std::string& preferredDevice, const std::string& directory,
+		const std::vector<RegressionScene>& scenes, bool update)
+	{
+		// lavapipe unless asked otherwise, the stored results come from it. Without lavapipe
+		// device selection falls back to the best device, which the check below rejects
+		LveDevice device{ preferredDevice.empty() ? "llvmpipe" : preferredDevice };
+		std::string deviceName = device.properties.deviceName;
+		std::filesystem::path root{ directory };
+		std::filesystem::create_directories(root);
+
+		// Another rasterizer, or another lavapipe version, draws different pixels at different
+		// speeds, comparing with it would only report noise
+		Baseline baseline;
+		if (!update)
+		{
+			baseline = loadBaseline(root / "baseline.txt");
+			if (baseline.device != deviceName)
+				throw std::runtime_error("Baseline in " + directory + " is from " + baseline.device + ", not " + deviceName +
+					". Run on that device (--device) or store a new baseline with --regress-update");
+		}
+		std::cout << (update ? "Storing" : "Checking") << " " << scenes.size() << " scenes on " << deviceName
+			<< " in " << directory << "\n";
+
+		std::ostringstream newBaseline;
+		newBaseline << "# Written by --regress-update, compared by --regress\n";
+		newBaseline << "device " << deviceName << "\n";
+
+		LveReadback readback{ device, LveSwapChain::MAX_FRAMES_IN_FLIGHT };
+		uint32_t regressions = 0;
+		auto regressed = [&regressions](const std::string& scene, const std::string& what)
+		{
+			std::cout << "  REGRESSION " << scene << ": " << what << "\n";
+			++regressions;
+		};
+
+		for (const auto& scene : scenes)
+		{
+			if (scene.capture.header.width != WIDTH || scene.capture.header.height != HEIGHT)
+				throw std::runtime_error("Regression scene " + scene.name + " is not " + std::to_string(WIDTH) + "x" + std::to_string(HEIGHT));
+
+			uint64_t pipelinesBefore = LvePipeline::createdCount();
+			uint32_t allocationsBefore = deviceAllocations(device);
+			LveFrameReplay replay{ device, scene.capture };
+			double pipelines = static_cast<double>(LvePipeline::createdCount() - pipelinesBefore);
+			double allocations = static_cast<double>(deviceAllocations(device)) - allocationsBefore;
+
+			replay.play(WARMUP_FRAMES);
+			LveFrameReplay::Timings timings = replay.play(MEASURED_FRAMES);
+
+			std::vector<uint8_t> pixels;
+			ReadbackImage image{};
+			replay.play(1, &readback, [&pixels, &image](const ReadbackImage& copied)
+				{
+					image = copied;
+					pixels.assign(copied.pixels, copied.pixels + static_cast<size_t>(copied.width) * copied.height * 4);
+				});
+			image.pixels = pixels.data();
+			if (pixels.empty())
+				throw std::runtime_error("Readback of " + scene.name + " did not complete");
+
+			// Timestamps measure the GPU alone, without them the wall clock is all there is
+			double frameMs = timings.gpuMs.empty() ? timings.wallMs / timings.frames : timings.medianGpuMs();
+			const std::pair<const char*, double> metrics[] = {
+				{ "frame_ms", frameMs },
+				{ "host_allocations", static_cast<double>(timings.hostAllocations) },
+				{ "device_allocations", allocations },
+				{ "pipelines", pipelines },
+			};
+			for (const auto& [metric, value] : metrics)
+				newBaseline << scene.name << " " << metric << " " << value << "\n";
+
+			std::filesystem::path golden = root / (scene.name + ".png");
+			std::cout << "  " << scene.name << ": " << frameMs << "ms per frame, " << timings.hostAllocations
+				<< " host allocations in " << MEASURED_FRAMES << " frames, " << allocations << " device allocations, "
+				<< pipelines << " pipelines\n";
+			if (update)
+			{
+				LveReadback::writePng(golden.string(), image);
+				continue;
+			}
+
+			if (!std::filesystem::exists(golden))
+				regressed(scene.name, "no golden image, store one with --regress-update");
+			else
+			{
+				uint32_t width, height;
+				std::vector<uint8_t> goldenRgb = LveReadback::readPng(golden.string(), width, height);
+				bool sameSize = width == image.width && height == image.height;
+				ImageDifference difference = sameSize ? compareImages(goldenRgb, image) : ImageDifference{};
+				double differentFraction = static_cast<double>(difference.differentPixels) / (static_cast<double>(image.width) * image.height);
+				if (!sameSize || differentFraction > DIFFERENT_PIXELS_TOLERANCE)
+				{
+					std::filesystem::path actual = root / (scene.name + ".actual.png");
+					LveReadback::writePng(actual.string(), image);
+					regressed(scene.name, sameSize
+						? std::to_string(difference.differentPixels) + " pixels differ by up to " + std::to_string(difference.maxDifference) + ", see " + actual.string()
+						: "image is " + std::to_string(image.width) + "x" + std::to_string(image.height) + ", the golden one " + std::to_string(width) + "x" + std::to_string(height));
+				}
+			}
+
+			for (const auto& [metric, value] : metrics)
+			{
+				auto stored = baseline.values.find(scene.name + " " + metric);
+				if (stored == baseline.values.end())
+				{
+					std::cout << "  " << scene.name << ": no baseline for " << metric << "\n";
+					continue;
+				}
+				bool timing = std::string{ metric } == "frame_ms";
+				double limit = timing ? stored->second * (1.0 + FRAME_TIME_TOLERANCE) + FRAME_TIME_SLACK_MS : stored->second;
+				if (value > limit)
+				{
+					std::ostringstream what;
+					what << metric << " " << value << ", baseline " << stored->second;
+					regressed(scene.name, what.str());
+				}
+			}
+		}
+
+		if (update)
+		{
+			std::ofstream file{ root / "baseline.txt", std::ios::trunc };
+			file << newBaseline.str();
+			if (!file)
+				throw std::runtime_error("Failed to write " + (root / "baseline.txt").string());
+			std::cout << "Stored " << scenes.size() << " golden images and baseline.txt\n";
+			return true;
+		}
+		std::cout << (regressions == 0 ? "No regressions\n" : std::to_string(regressions) + " regressions\n");
+		return regressions == 0;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "lve_frame_capture.hpp"
+
+// std
+#include <string>
+#include <vector>
+
+namespace lve
+{
+	// One frame or more, replayed headless like any other capture
+	struct RegressionScene
+	{
+		std::string name;
+		LveFrameCaptureFile capture;
+	};
+
+	// Renders scenes on a headless device and compares them with what a known good build
+	// stored in a directory: <scene>.png for the last frame and baseline.txt for frame
+	// times, host allocations per frame, device allocations and pipelines. Meant for a
+	// software rasterizer (lavapipe) so it runs where there is no GPU. The images and
+	// times are only comparable on the device they were stored from, checking on any
+	// other device throws
+	class LveRegression
+	{
+	public:
+		static constexpr uint32_t WIDTH = 256;
+		static constexpr uint32_t HEIGHT = 256;
+
+		// update stores the images and metrics instead of comparing with them. Returns
+		// false when an image or a metric regressed beyond its tolerance
+		static bool run(const std::string& preferredDevice, const std::string& directory,
+			const std::vector<RegressionScene>& scenes, bool update);
+	};
+}
@@ -0,0 +1,615 @@
+#include "lve_render_graph.hpp"
+
+#include "lve_gpu_trace.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve
+{
+	static constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+		VK_ACCESS_MEMORY_WRITE_BIT;
+
+	RenderGraphUsage RenderGraphUsage::colorAttachment()
+	{
+		// Blending reads what is there
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	}
+
+	RenderGraphUsage RenderGraphUsage::depthAttachment()
+	{
+		return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	}
+
+	RenderGraphUsage RenderGraphUsage::vertexBuffer()
+	{
+		return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+	}
+
+	RenderGraphUsage RenderGraphUsage::computeStorage()
+	{
+		return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	}
+
+	RenderGraphUsage RenderGraphUsage::fragmentStorageRead()
+	{
+		return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	}
+
+	RenderGraphUsage RenderGraphUsage::transferSource()
+	{
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+	}
+
+	LveRenderGraph::LveRenderGraph(LveDevice& device) : lveDevice{ device }
+	{
+	}
+
+	LveRenderGraph::~LveRenderGraph()
+	{
+		destroyTransients();
+	}
+
+	RenderGraphResource LveRenderGraph::addResource(const char* name, ResourceKind kind)
+	{
+		if (isCompiled)
+			throw std::runtime_error("Render graph is compiled, reset it before adding to it");
+		Resource resource{};
+		resource.name = name;
+		resource.kind = kind;
+		resources.push_back(resource);
+		return static_cast<RenderGraphResource>(resources.size() - 1);
+	}
+
+	RenderGraphResource LveRenderGraph::importImage(const char* name, VkImageAspectFlags aspect)
+	{
+		RenderGraphResource handle = addResource(name, ResourceKind::Image);
+		resources[handle].aspect = aspect;
+		return handle;
+	}
+
+	RenderGraphResource LveRenderGraph::importExternalImage(const char* name, VkImageAspectFlags aspect,
+		VkImageLayout finalLayout, VkPipelineStageFlags waitStages)
+	{
+		RenderGraphResource handle = addResource(name, ResourceKind::ExternalImage);
+		resources[handle].aspect = aspect;
+		resources[handle].finalLayout = finalLayout;
+		resources[handle].waitStages = waitStages;
+		return handle;
+	}
+
+	RenderGraphResource LveRenderGraph::importBuffer(const char* name)
+	{
+		return addResource(name, ResourceKind::Buffer);
+	}
+
+	RenderGraphResource LveRenderGraph::createImage(const char* name, const TransientImageInfo& info)
+	{
+		RenderGraphResource handle = addResource(name, ResourceKind::TransientImage);
+		resources[handle].aspect = info.aspect;
+		resources[handle].transient = info;
+		return handle;
+	}
+
+	void LveRenderGraph::setImage(RenderGraphResource resource, VkImage image)
+	{
+		if (resources[resource].kind == ResourceKind::TransientImage)
+			throw std::runtime_error(std::string("Render graph image ") + resources[resource].name + " is transient");
+		resources[resource].image = image;
+	}
+
+	VkImage LveRenderGraph::image(RenderGraphResource resource) const
+	{
+		return resources[resource].image;
+	}
+
+	VkImageView LveRenderGraph::imageView(RenderGraphResource resource) const
+	{
+		return resources[resource].view;
+	}
+
+	RenderGraphPass LveRenderGraph::addPass(const char* name, Record record)
+	{
+		if (isCompiled)
+			throw std::runtime_error("Render graph is compiled, reset it before adding to it");
+		Pass pass{};
+		pass.name = name;
+		pass.record = std::move(record);
+		passes.push_back(std::move(pass));
+		return static_cast<RenderGraphPass>(passes.size() - 1);
+	}
+
+	void LveRenderGraph::addUse(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage, UseKind kind)
+	{
+		if (isCompiled)
+			throw std::runtime_error("Render graph is compiled, reset it before adding to it");
+		passes[pass].uses.push_back({ resource, usage, kind });
+	}
+
+	void LveRenderGraph::read(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage)
+	{
+		addUse(pass, resource, usage, UseKind::Read);
+	}
+
+	void LveRenderGraph::write(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage)
+	{
+		addUse(pass, resource, usage, UseKind::Write);
+	}
+
+	void LveRenderGraph::readWrite(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage)
+	{
+		addUse(pass, resource, usage, UseKind::ReadWrite);
+	}
+
+	void LveRenderGraph::renderPassAttachment(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage)
+	{
+		addUse(pass, resource, usage, UseKind::RenderPassAttachment);
+	}
+
+	void LveRenderGraph::keep(RenderGraphPass pass)
+	{
+		passes[pass].kept = true;
+	}
+
+	void LveRenderGraph::output(RenderGraphResource resource)
+	{
+		resources[resource].isOutput = true;
+	}
+
+	bool LveRenderGraph::writes(const Use& use)
+	{
+		return use.kind != UseKind::Read;
+	}
+
+	void LveRenderGraph::cullPasses()
+	{
+		// Walked backwards, a pass stays when it writes something a later pass or the outside
+		// reads. Writing everything anew hides the earlier writers from the passes after it
+		std::vector<bool> needed(resources.size());
+		for (size_t i = 0; i < resources.size(); ++i)
+			needed[i] = resources[i].isOutput;
+
+		for (size_t p = passes.size(); p-- > 0;)
+		{
+			Pass& pass = passes[p];
+			bool used = pass.kept;
+			for (const auto& use : pass.uses)
+				used = used || (writes(use) && needed[use.resource]);
+			pass.culled = !used;
+			if (pass.culled)
+				continue;
+
+			for (const auto& use : pass.uses)
+			{
+				if (use.kind == UseKind::Write)
+					needed[use.resource] = false;
+			}
+			for (const auto& use : pass.uses)
+			{
+				if (reads(use.kind))
+					needed[use.resource] = true;
+			}
+		}
+
+		for (auto& resource : resources)
+		{
+			resource.firstUse = ~0u;
+			resource.lastUse = 0;
+		}
+		for (uint32_t p = 0; p < passes.size(); ++p)
+		{
+			if (passes[p].culled)
+				continue;
+			for (const auto& use : passes[p].uses)
+			{
+				Resource& resource = resources[use.resource];
+				resource.firstUse = std::min(resource.firstUse, p);
+				resource.lastUse = std::max(resource.lastUse, p);
+			}
+		}
+	}
+
+	void LveRenderGraph::allocateTransients()
+	{
+		struct Placement
+		{
+			RenderGraphResource resource;
+			VkMemoryRequirements requirements;
+		};
+		std::vector<Placement> placements;
+
+		for (uint32_t i = 0; i < resources.size(); ++i)
+		{
+			Resource& resource = resources[i];
+			if (resource.kind != ResourceKind::TransientImage || resource.firstUse == ~0u)
+				continue;
+
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = resource.transient.format;
+			imageInfo.extent = { resource.transient.extent.width, resource.transient.extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = resource.transient.usage;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			if (vkCreateImage(lveDevice.device(), &imageInfo, nullptr, &resource.image) != VK_SUCCESS)
+				throw std::runtime_error(std::string("Failed to create render graph image ") + resource.name);
+
+			Placement placement{ i, {} };
+			vkGetImageMemoryRequirements(lveDevice.device(), resource.image, &placement.requirements);
+			placements.push_back(placement);
+			graphStats.unaliasedBytes += placement.requirements.size;
+		}
+
+		// Largest first, each goes into the first heap whose images are all dead while it is
+		// alive. Everything sits at offset 0, so alignment takes care of itself
+		std::sort(placements.begin(), placements.end(), [](const Placement& a, const Placement& b)
+			{
+				return a.requirements.size > b.requirements.size;
+			});
+		std::vector<std::vector<RenderGraphResource>> occupants;
+		for (const auto& placement : placements)
+		{
+			Resource& resource = resources[placement.resource];
+			uint32_t heap = 0;
+			for (; heap < heaps.size(); ++heap)
+			{
+				if ((heaps[heap].memoryTypeBits & placement.requirements.memoryTypeBits) == 0)
+					continue;
+				bool overlaps = false;
+				for (RenderGraphResource other : occupants[heap])
+				{
+					const Resource& occupant = resources[other];
+					overlaps = overlaps || (resource.firstUse <= occupant.lastUse && occupant.firstUse <= resource.lastUse);
+				}
+				if (!overlaps)
+					break;
+			}
+			if (heap == heaps.size())
+			{
+				heaps.push_back({});
+				occupants.emplace_back();
+			}
+			heaps[heap].size = std::max(heaps[heap].size, placement.requirements.size);
+			heaps[heap].memoryTypeBits &= placement.requirements.memoryTypeBits;
+			occupants[heap].push_back(placement.resource);
+			resource.heap = heap;
+		}
+
+		for (uint32_t heap = 0; heap < heaps.size(); ++heap)
+		{
+			VkMemoryRequirements requirements{ heaps[heap].size, 1, heaps[heap].memoryTypeBits };
+			const Resource& largest = resources[occupants[heap].front()];
+			lveDevice.allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, heaps[heap].memory,
+				LveMemoryTracker::tagForImageUsage(largest.transient.usage));
+			graphStats.transientBytes += heaps[heap].size;
+
+			for (RenderGraphResource handle : occupants[heap])
+			{
+				Resource& resource = resources[handle];
+				if (vkBindImageMemory(lveDevice.device(), resource.image, heaps[heap].memory, 0) != VK_SUCCESS)
+					throw std::runtime_error(std::string("Failed to bind render graph image ") + resource.name);
+
+				VkImageViewCreateInfo viewInfo{};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = resource.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.transient.format;
+				viewInfo.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+				if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &resource.view) != VK_SUCCESS)
+					throw std::runtime_error(std::string("Failed to create render graph image view ") + resource.name);
+				++graphStats.transientImages;
+			}
+		}
+	}
+
+	std::vector<LveRenderGraph::State> LveRenderGraph::initialStates(const std::vector<State>& finalStates) const
+	{
+		std::vector<State> states(resources.size());
+		for (size_t i = 0; i < resources.size(); ++i)
+		{
+			const Resource& resource = resources[i];
+			State& state = states[i];
+			switch (resource.kind)
+			{
+			case ResourceKind::Image:
+			case ResourceKind::Buffer:
+				state = finalStates[i];
+				break;
+			case ResourceKind::ExternalImage:
+				// The semaphore made everything before it visible
+				state.layout = resource.finalLayout;
+				state.writeStages = resource.waitStages;
+				break;
+			case ResourceKind::TransientImage:
+				// Whatever shares the memory has to be done with it, in this frame or the last.
+				// The contents are gone either way
+				for (size_t j = 0; j < resources.size(); ++j)
+				{
+					if (resources[j].kind != ResourceKind::TransientImage || resources[j].heap != resource.heap)
+						continue;
+					state.writeStages |= finalStates[j].writeStages | finalStates[j].readStages;
+					state.writeAccess |= finalStates[j].writeAccess;
+				}
+				break;
+			}
+		}
+		return states;
+	}
+
+	void LveRenderGraph::simulate(std::vector<State>& states, bool plan)
+	{
+		for (uint32_t p = 0; p < passes.size(); ++p)
+		{
+			Pass& pass = passes[p];
+			if (pass.culled)
+				continue;
+			Barrier barrier{};
+
+			for (const auto& use : pass.uses)
+			{
+				const Resource& resource = resources[use.resource];
+				const RenderGraphUsage& usage = use.usage;
+				State& state = states[use.resource];
+
+				if (plan && resource.kind == ResourceKind::TransientImage && resource.firstUse == p && reads(use.kind))
+					throw std::runtime_error(std::string("Render graph image ") + resource.name + " is read by " + pass.name + " before it is written");
+
+				if (use.kind == UseKind::RenderPassAttachment)
+				{
+					// The render pass waited on and transitioned it, the graph only learns where it ends up
+					state.layout = usage.layout;
+					state.writeStages = usage.stages;
+					state.writeAccess = usage.access & WRITE_ACCESS;
+					state.readStages = 0;
+					state.visibleStages = 0;
+					state.visibleAccess = 0;
+					continue;
+				}
+
+				// A write that drops the contents always starts from UNDEFINED, which costs no more
+				// than a memory barrier and also covers imported images that change between frames
+				bool image = isImage(resource);
+				bool transition = image && (usage.layout != state.layout || use.kind == UseKind::Write);
+				bool write = writes(use);
+				bool needed;
+				VkPipelineStageFlags srcStages;
+				if (write || transition)
+				{
+					// Writes and layout transitions wait for the reads since the last write too
+					srcStages = state.writeStages | state.readStages;
+					needed = transition || srcStages != 0;
+				}
+				else
+				{
+					srcStages = state.writeStages;
+					needed = state.writeAccess != 0 &&
+						((usage.stages & ~state.visibleStages) != 0 || (usage.access & ~state.visibleAccess) != 0);
+				}
+
+				if (needed)
+				{
+					barrier.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+					barrier.dstStages |= usage.stages;
+					if (transition)
+					{
+						VkImageLayout oldLayout = use.kind == UseKind::Write ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+						barrier.images.push_back({ use.resource, state.writeAccess, usage.access, oldLayout, usage.layout });
+					}
+					else
+					{
+						barrier.srcMemoryAccess |= state.writeAccess;
+						barrier.dstMemoryAccess |= usage.access;
+					}
+				}
+
+				if (write)
+				{
+					state.writeStages = usage.stages;
+					state.writeAccess = usage.access & WRITE_ACCESS;
+					state.readStages = 0;
+					state.visibleStages = 0;
+					state.visibleAccess = 0;
+				}
+				else
+				{
+					// Later barriers have to chain after the transition
+					if (transition)
+					{
+						state.writeStages |= usage.stages;
+						state.visibleStages = 0;
+						state.visibleAccess = 0;
+					}
+					if (needed)
+					{
+						state.visibleStages |= usage.stages;
+						state.visibleAccess |= usage.access;
+					}
+					state.readStages |= usage.stages;
+				}
+				if (image)
+					state.layout = usage.layout;
+			}
+
+			if (plan)
+				pass.barrier = std::move(barrier);
+		}
+
+		// Presentation waits on a semaphore, the transition only has to come after the last use
+		Barrier final{};
+		for (uint32_t i = 0; i < resources.size(); ++i)
+		{
+			const Resource& resource = resources[i];
+			State& state = states[i];
+			if (resource.kind != ResourceKind::ExternalImage || resource.firstUse == ~0u || state.layout == resource.finalLayout)
+				continue;
+			final.srcStages |= state.writeStages | state.readStages;
+			final.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			final.images.push_back({ i, state.writeAccess, 0, state.layout, resource.finalLayout });
+			state.layout = resource.finalLayout;
+		}
+		if (plan)
+			finalBarrier = std::move(final);
+	}
+
+	void LveRenderGraph::compile()
+	{
+		destroyTransients();
+		graphStats = {};
+
+		cullPasses();
+		allocateTransients();
+
+		// Once to learn how a frame leaves every resource, then again from there, which is
+		// how every frame after the first one starts
+		std::vector<State> states(resources.size());
+		simulate(states, false);
+		states = initialStates(states);
+		simulate(states, true);
+
+		size_t maxImageBarriers = finalBarrier.images.size();
+		auto count = [this](const Barrier& barrier)
+		{
+			if (barrier.empty())
+				return;
+			++graphStats.barriers;
+			graphStats.imageBarriers += static_cast<uint32_t>(barrier.images.size());
+		};
+		for (const auto& pass : passes)
+		{
+			if (pass.culled)
+			{
+				++graphStats.culledPasses;
+				continue;
+			}
+			++graphStats.passes;
+			count(pass.barrier);
+			maxImageBarriers = std::max(maxImageBarriers, pass.barrier.images.size());
+		}
+		count(finalBarrier);
+		imageBarriers.resize(maxImageBarriers);
+		isCompiled = true;
+	}
+
+	void LveRenderGraph::recordBarrier(VkCommandBuffer commandBuffer, const Barrier& barrier)
+	{
+		for (size_t i = 0; i < barrier.images.size(); ++i)
+		{
+			const ImageBarrier& source = barrier.images[i];
+			const Resource& resource = resources[source.resource];
+			VkImageMemoryBarrier& imageBarrier = imageBarriers[i];
+			imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = source.srcAccess;
+			imageBarrier.dstAccessMask = source.dstAccess;
+			imageBarrier.oldLayout = source.oldLayout;
+			imageBarrier.newLayout = source.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+		}
+
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = barrier.srcMemoryAccess;
+		memoryBarrier.dstAccessMask = barrier.dstMemoryAccess;
+		uint32_t memoryBarrierCount = barrier.srcMemoryAccess != 0 ? 1 : 0;
+
+		vkCmdPipelineBarrier(commandBuffer, barrier.srcStages, barrier.dstStages, 0,
+			memoryBarrierCount, &memoryBarrier, 0, nullptr,
+			static_cast<uint32_t>(barrier.images.size()), imageBarriers.data());
+	}
+
+	void LveRenderGraph::execute(VkCommandBuffer commandBuffer, LveGpuTrace* trace)
+	{
+		if (!isCompiled)
+			throw std::runtime_error("Render graph has to be compiled before it is executed");
+
+		for (auto& pass : passes)
+		{
+			if (pass.culled)
+				continue;
+			if (!pass.barrier.empty())
+				recordBarrier(commandBuffer, pass.barrier);
+
+			uint32_t range = trace != nullptr ? trace->begin(commandBuffer, pass.name) : LveGpuTrace::NO_RANGE;
+			pass.record(commandBuffer);
+			if (trace != nullptr)
+				trace->end(commandBuffer, range);
+		}
+		if (!finalBarrier.empty())
+			recordBarrier(commandBuffer, finalBarrier);
+	}
+
+	void LveRenderGraph::destroyTransients()
+	{
+		for (auto& resource : resources)
+		{
+			if (resource.kind != ResourceKind::TransientImage)
+				continue;
+			if (resource.view != VK_NULL_HANDLE)
+				vkDestroyImageView(lveDevice.device(), resource.view, nullptr);
+			if (resource.image != VK_NULL_HANDLE)
+				vkDestroyImage(lveDevice.device(), resource.image, nullptr);
+			resource.view = VK_NULL_HANDLE;
+			resource.image = VK_NULL_HANDLE;
+			resource.heap = ~0u;
+		}
+		for (auto& heap : heaps)
+			lveDevice.freeMemory(heap.memory);
+		heaps.clear();
+		isCompiled = false;
+	}
+
+	void LveRenderGraph::reset()
+	{
+		destroyTransients();
+		resources.clear();
+		passes.clear();
+		finalBarrier = {};
+		graphStats = {};
+	}
+
+	void LveRenderGraph::printPlan(std::ostream& out) const
+	{
+		auto printBarrier = [this, &out](const Barrier& barrier)
+		{
+			if (barrier.empty())
+				return;
+			out << "  barrier stages 0x" << std::hex << barrier.srcStages << " -> 0x" << barrier.dstStages;
+			if (barrier.srcMemoryAccess != 0)
+				out << ", memory 0x" << barrier.srcMemoryAccess << " -> 0x" << barrier.dstMemoryAccess;
+			out << std::dec << "\n";
+			for (const auto& image : barrier.images)
+				out << "    " << resources[image.resource].name << " layout " << image.oldLayout << " -> " << image.newLayout << "\n";
+		};
+
+		for (const auto& pass : passes)
+		{
+			if (pass.culled)
+			{
+				out << pass.name << " (culled)\n";
+				continue;
+			}
+			printBarrier(pass.barrier);
+			out << pass.name << "\n";
+		}
+		printBarrier(finalBarrier);
+		for (const auto& resource : resources)
+		{
+			if (resource.kind == ResourceKind::TransientImage && resource.heap != ~0u)
+				out << resource.name << ": heap " << resource.heap << ", passes " << resource.firstUse << " to " << resource.lastUse << "\n";
+		}
+	}
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lve
+{
+	class LveGpuTrace;
+
+	using RenderGraphResource = uint32_t;
+	using RenderGraphPass = uint32_t;
+
+	// How a pass touches a resource. layout is ignored for buffers
+	struct RenderGraphUsage
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+
+		static RenderGraphUsage colorAttachment();
+		static RenderGraphUsage depthAttachment();
+		static RenderGraphUsage vertexBuffer();
+		static RenderGraphUsage computeStorage();
+		static RenderGraphUsage fragmentStorageRead();
+		static RenderGraphUsage transferSource();
+	};
+
+	// The passes of a frame and the images and buffers they read and write. compile() puts
+	// them in the order they were added, drops passes nothing kept depends on, works out
+	// the fewest barriers between them and puts transient images whose lifetimes do not
+	// overlap in the same memory. execute() then records the passes with one
+	// vkCmdPipelineBarrier in front of each pass that needs one, every frame, allocation free.
+	//
+	// Resources live across frames on one queue: the first use in a frame waits on the last
+	// one of the frame before, transient images included. Buffer hazards become one global
+	// memory barrier per pass, images get their own barriers for layout transitions
+	class LveRenderGraph
+	{
+	public:
+		using Record = std::function<void(VkCommandBuffer)>;
+
+		struct TransientImageInfo
+		{
+			VkFormat format;
+			VkExtent2D extent;
+			VkImageUsageFlags usage;
+			VkImageAspectFlags aspect;
+		};
+
+		struct Stats
+		{
+			uint32_t passes = 0;
+			uint32_t culledPasses = 0;
+			// vkCmdPipelineBarrier calls and the image barriers in them, per frame
+			uint32_t barriers = 0;
+			uint32_t imageBarriers = 0;
+			uint32_t transientImages = 0;
+			// What the transient images take with aliasing, and would take without
+			VkDeviceSize transientBytes = 0;
+			VkDeviceSize unaliasedBytes = 0;
+		};
+
+		explicit LveRenderGraph(LveDevice& device);
+		~LveRenderGraph();
+
+		LveRenderGraph(const LveRenderGraph&) = delete;
+		LveRenderGraph& operator=(const LveRenderGraph&) = delete;
+
+		// An image the graph does not own that stays on this queue, it is in the layout of
+		// its last use from the frame before. setImage before every execute when it changes
+		RenderGraphResource importImage(const char* name, VkImageAspectFlags aspect);
+		// An image that leaves the queue in finalLayout after the graph, e.g. to be presented,
+		// and comes back through a semaphore that is waited on at waitStages
+		RenderGraphResource importExternalImage(const char* name, VkImageAspectFlags aspect,
+			VkImageLayout finalLayout, VkPipelineStageFlags waitStages);
+		RenderGraphResource importBuffer(const char* name);
+		// Created and bound to memory by compile(), the first pass using it has to write it
+		RenderGraphResource createImage(const char* name, const TransientImageInfo& info);
+
+		void setImage(RenderGraphResource resource, VkImage image);
+		VkImage image(RenderGraphResource resource) const;
+		// Only for transient images
+		VkImageView imageView(RenderGraphResource resource) const;
+
+		RenderGraphPass addPass(const char* name, Record record);
+		void read(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage);
+		// The earlier contents are not needed, images may start from UNDEFINED
+		void write(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage);
+		void readWrite(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage);
+		// An attachment of a VkRenderPass that the pass begins and ends itself. Its subpass
+		// dependencies and layout transitions cover it, usage.layout is its finalLayout
+		void renderPassAttachment(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage);
+		// Passes with effects outside of the graph, e.g. copies to the host, are never culled
+		void keep(RenderGraphPass pass);
+		// Read after the graph, the passes writing it are kept
+		void output(RenderGraphResource resource);
+
+		void compile();
+		// trace gets a GPU range per pass when given
+		void execute(VkCommandBuffer commandBuffer, LveGpuTrace* trace = nullptr);
+		// Drops every pass and resource and frees the transient memory, the GPU has to be done with them
+		void reset();
+
+		bool compiled() const { return isCompiled; }
+		Stats stats() const { return graphStats; }
+		// The kept passes in order with the barriers in front of them
+		void printPlan(std::ostream& out) const;
+
+	private:
+		enum class ResourceKind : uint32_t
+		{
+			Image,
+			ExternalImage,
+			TransientImage,
+			Buffer
+		};
+
+		struct Resource
+		{
+			const char* name;
+			ResourceKind kind;
+			VkImageAspectFlags aspect = 0;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags waitStages = 0;
+			bool isOutput = false;
+			TransientImageInfo transient{};
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			// Index into heaps, for transient images
+			uint32_t heap = ~0u;
+			// Kept passes using it, first and last
+			uint32_t firstUse = ~0u;
+			uint32_t lastUse = 0;
+		};
+
+		enum class UseKind : uint32_t
+		{
+			Read,
+			Write,
+			ReadWrite,
+			RenderPassAttachment
+		};
+
+		struct Use
+		{
+			RenderGraphResource resource;
+			RenderGraphUsage usage;
+			UseKind kind;
+		};
+
+		struct ImageBarrier
+		{
+			RenderGraphResource resource;
+			VkAccessFlags srcAccess;
+			VkAccessFlags dstAccess;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+		};
+
+		// Everything one vkCmdPipelineBarrier records
+		struct Barrier
+		{
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+			VkAccessFlags srcMemoryAccess = 0;
+			VkAccessFlags dstMemoryAccess = 0;
+			std::vector<ImageBarrier> images;
+
+			bool empty() const { return srcStages == 0 && dstStages == 0 && images.empty(); }
+		};
+
+		struct Pass
+		{
+			const char* name;
+			Record record;
+			std::vector<Use> uses;
+			bool kept = false;
+			bool culled = false;
+			Barrier barrier;
+		};
+
+		// Transient images whose lifetimes do not overlap, all bound at offset 0 of one allocation
+		struct Heap
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = ~0u;
+		};
+
+		// Where a resource stands between passes while compiling
+		struct State
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			// The last write and the reads since, a write has to wait for both
+			VkPipelineStageFlags writeStages = 0;
+			VkAccessFlags writeAccess = 0;
+			VkPipelineStageFlags readStages = 0;
+			// What the last write has already been made visible to
+			VkPipelineStageFlags visibleStages = 0;
+			VkAccessFlags visibleAccess = 0;
+		};
+
+		static bool isImage(const Resource& resource) { return resource.kind != ResourceKind::Buffer; }
+		static bool reads(UseKind kind) { return kind == UseKind::Read || kind == UseKind::ReadWrite || kind == UseKind::RenderPassAttachment; }
+		static bool writes(const Use& use);
+
+		RenderGraphResource addResource(const char* name, ResourceKind kind);
+		void addUse(RenderGraphPass pass, RenderGraphResource resource, const RenderGraphUsage& usage, UseKind kind);
+		void cullPasses();
+		void allocateTransients();
+		std::vector<State> initialStates(const std::vector<State>& finalStates) const;
+		// Runs the kept passes over states, filling in their barriers when plan is set
+		void simulate(std::vector<State>& states, bool plan);
+		void recordBarrier(VkCommandBuffer commandBuffer, const Barrier& barrier);
+		void destroyTransients();
+
+		LveDevice& lveDevice;
+		std::vector<Resource> resources;
+		std::vector<Pass> passes;
+		std::vector<Heap> heaps;
+		// Into the external images once the last pass is done
+		Barrier finalBarrier;
+		Stats graphStats;
+		bool isCompiled = false;
+		// Sized by compile(), so execute() does not allocate
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+	};
+}
@@ -0,0 +1,235 @@
+#include "lve_scene.hpp"
+
+#include "lve_job_system.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LVE_SCENE_SSE 1
+#include <emmintrin.h>
+#endif
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace lve
+{
+	// Scale pulses between 0.75 and 1.25 of the base scale, this many times per second
+	static constexpr float PULSE_RATE = 0.5f;
+
+	size_t LveScene::add(glm::vec2 position, glm::vec2 velocity, float scale, glm::vec3 color, LodGroupHandle lodGroup, uint32_t material)
+	{
+		positionX.push_back(position.x);
+		positionY.push_back(position.y);
+		velocityX.push_back(velocity.x);
+		velocityY.push_back(velocity.y);
+		baseScales.push_back(scale);
+		scales.push_back(scale);
+		phases.push_back(0.0f);
+		colorR.push_back(color.x);
+		colorG.push_back(color.y);
+		colorB.push_back(color.z);
+		lodGroups.push_back(lodGroup);
+		materials.push_back(material);
+		return positionX.size() - 1;
+	}
+
+	void LveScene::clear()
+	{
+		for (auto* array : { &positionX, &positionY, &velocityX, &velocityY, &baseScales, &scales, &phases, &colorR, &colorG, &colorB })
+			array->clear();
+		lodGroups.clear();
+		materials.clear();
+	}
+
+	void LveScene::reserve(size_t count)
+	{
+		for (auto* array : { &positionX, &positionY, &velocityX, &velocityY, &baseScales, &scales, &phases, &colorR, &colorG, &colorB })
+			array->reserve(count);
+		lodGroups.reserve(count);
+		materials.reserve(count);
+	}
+
+	void LveScene::update(float dt, uint32_t threadCount)
+	{
+		if (threadCount == 1)
+		{
+			updateRange(0, size(), dt);
+			return;
+		}
+
+		// Below 16384 objects per chunk the jobs cost more than they save, a multiple
+		// of 4 also keeps the scalar tail in the last chunk only
+		LveJobSystem::get().parallelFor(size(), 16384, [this, dt](size_t begin, size_t end)
+			{
+				updateRange(begin, end, dt);
+			});
+	}
+
+	void LveScene::updateScalar(float dt)
+	{
+		updateRangeScalar(0, size(), dt);
+	}
+
+	void LveScene::saveFrame(Frame& frame) const
+	{
+		frame.positionX.assign(positionX.begin(), positionX.end());
+		frame.positionY.assign(positionY.begin(), positionY.end());
+		frame.scales.assign(scales.begin(), scales.end());
+	}
+
+	void LveScene::interpolate(const Frame& from, const Frame& to, float alpha)
+	{
+		auto lerp = [alpha, count = size()](const std::vector<float>& a, const std::vector<float>& b, std::vector<float>& out)
+		{
+			size_t i = 0;
+#if LVE_SCENE_SSE
+			const __m128 t = _mm_set1_ps(alpha);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 start = _mm_loadu_ps(a.data() + i);
+				__m128 difference = _mm_sub_ps(_mm_loadu_ps(b.data() + i), start);
+				_mm_storeu_ps(out.data() + i, _mm_add_ps(start, _mm_mul_ps(difference, t)));
+			}
+#endif
+			for (; i < count; ++i)
+				out[i] = a[i] + (b[i] - a[i]) * alpha;
+		};
+		lerp(from.positionX, to.positionX, positionX);
+		lerp(from.positionY, to.positionY, positionY);
+		lerp(from.scales, to.scales, scales);
+	}
+
+	void LveScene::updateRange(size_t begin, size_t end, float dt)
+	{
+#if LVE_SCENE_SSE
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 minusOne = _mm_set1_ps(-1.0f);
+		const __m128 minusTwo = _mm_set1_ps(-2.0f);
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 delta = _mm_set1_ps(dt);
+		const __m128 phaseDelta = _mm_set1_ps(dt * PULSE_RATE);
+		const __m128 pulseBase = _mm_set1_ps(0.75f);
+		const __m128 pulseRange = _mm_set1_ps(0.5f);
+
+		// Reflects positions that left [-1, 1] back inside and flips their velocity, branch free
+		auto bounce = [&](float* position, float* velocity, size_t i)
+		{
+			__m128 p = _mm_loadu_ps(position + i);
+			__m128 v = _mm_loadu_ps(velocity + i);
+			p = _mm_add_ps(p, _mm_mul_ps(v, delta));
+
+			__m128 over = _mm_cmpgt_ps(p, one);
+			__m128 under = _mm_cmplt_ps(p, minusOne);
+			__m128 outside = _mm_or_ps(over, under);
+			__m128 reflected = _mm_or_ps(
+				_mm_and_ps(over, _mm_sub_ps(two, p)),
+				_mm_and_ps(under, _mm_sub_ps(minusTwo, p)));
+			p = _mm_or_ps(reflected, _mm_andnot_ps(outside, p));
+			v = _mm_xor_ps(v, _mm_and_ps(outside, signMask));
+
+			_mm_storeu_ps(position + i, p);
+			_mm_storeu_ps(velocity + i, v);
+		};
+
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			bounce(positionX.data(), velocityX.data(), i);
+			bounce(positionY.data(), velocityY.data(), i);
+
+			// Phases are never negative, so truncation is floor
+			__m128 phase = _mm_add_ps(_mm_loadu_ps(phases.data() + i), phaseDelta);
+			phase = _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+			_mm_storeu_ps(phases.data() + i, phase);
+
+			__m128 triangle = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_mul_ps(two, phase), one));
+			__m128 pulse = _mm_add_ps(pulseBase, _mm_mul_ps(pulseRange, triangle));
+			_mm_storeu_ps(scales.data() + i, _mm_mul_ps(_mm_loadu_ps(baseScales.data() + i), pulse));
+		}
+		updateRangeScalar(i, end, dt);
+#else
+		updateRangeScalar(begin, end, dt);
+#endif
+	}
+
+	void LveScene::updateRangeScalar(size_t begin, size_t end, float dt)
+	{
+		auto bounce = [dt](float& position, float& velocity)
+		{
+			position += velocity * dt;
+			if (position > 1.0f)
+			{
+				position = 2.0f - position;
+				velocity = -velocity;
+			}
+			else if (position < -1.0f)
+			{
+				position = -2.0f - position;
+				velocity = -velocity;
+			}
+		};
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			bounce(positionX[i], velocityX[i]);
+			bounce(positionY[i], velocityY[i]);
+
+			phases[i] += dt * PULSE_RATE;
+			phases[i] -= std::floor(phases[i]);
+			scales[i] = baseScales[i] * (0.75f + 0.5f * std::abs(2.0f * phases[i] - 1.0f));
+		}
+	}
+
+	void LveScene::benchmark(size_t objectCount)
+	{
+		std::mt19937 random{ 42 };
+		std::uniform_real_distribution<float> unit{ -1.0f, 1.0f };
+
+		LveScene scene;
+		scene.reserve(objectCount);
+		for (size_t i = 0; i < objectCount; ++i)
+		{
+			scene.add({ unit(random), unit(random) }, { unit(random), unit(random) }, 0.01f,
+				{ 0.5f + 0.5f * unit(random), 0.5f, 0.5f }, 0);
+		}
+		LveScene reference = scene;
+
+		constexpr int frames = 100;
+		constexpr float dt = 1.0f / 60.0f;
+		auto measure = [&](const char* label, auto&& step)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < frames; ++frame)
+				step();
+			std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+			std::cout << "  " << label << ": " << duration.count() / frames << "ms per frame\n";
+		};
+
+		uint32_t threadCount = LveJobSystem::get().threadCount();
+		std::cout << "Scene update, " << objectCount << " objects"
+#if LVE_SCENE_SSE
+			<< " (SSE)"
+#else
+			<< " (no SSE, kernels are scalar)"
+#endif
+			<< "\n";
+		measure("scalar", [&] { reference.updateScalar(dt); });
+		measure("simd, 1 thread", [&] { scene.update(dt, 1); });
+		measure(("simd, " + std::to_string(threadCount) + " threads").c_str(), [&] { scene.update(dt, threadCount); });
+
+		// Catch the reference up, both then ran the same steps from the same start
+		for (int frame = 0; frame < frames; ++frame)
+			reference.updateScalar(dt);
+		float maxError = 0.0f;
+		for (size_t i = 0; i < objectCount; ++i)
+		{
+			maxError = std::max(maxError, std::abs(scene.positionX[i] - reference.positionX[i]));
+			maxError = std::max(maxError, std::abs(scene.scales[i] - reference.scales[i]));
+		}
+		std::cout << "  max difference to scalar: " << maxError << "\n";
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve
+{
+	// Index into the models FirstApp owns, what is drawn
+	using ModelHandle = uint32_t;
+	// Index into the LOD groups FirstApp owns, what scene objects refer to. Culling picks
+	// the ModelHandle of one of its levels per frame
+	using LodGroupHandle = uint32_t;
+
+	// Objects stored as structure of arrays, one array per component, so per frame updates
+	// stream through memory and run 4 objects at a time with SSE
+	class LveScene
+	{
+	public:
+		// What a simulation tick changes: the position and scale of every object
+		struct Frame
+		{
+			std::vector<float> positionX;
+			std::vector<float> positionY;
+			std::vector<float> scales;
+		};
+
+		// material picks the pipeline, an index into the ones FirstApp owns
+		size_t add(glm::vec2 position, glm::vec2 velocity, float scale, glm::vec3 color, LodGroupHandle lodGroup, uint32_t material = 0);
+		void clear();
+		void reserve(size_t count);
+		size_t size() const { return positionX.size(); }
+
+		// Moves every object, bouncing them off the edges of clip space, and pulses their scale.
+		// threadCount 1 runs on the calling thread, anything else on the job system
+		void update(float dt, uint32_t threadCount = 1);
+		// Same result, one object at a time, kept to compare against and for non SSE targets
+		void updateScalar(float dt);
+
+		// Copies the per tick state out, only allocates the first time frame is used
+		void saveFrame(Frame& frame) const;
+		// Replaces positions and scales with from + (to - from) * alpha, both the size of this scene
+		void interpolate(const Frame& from, const Frame& to, float alpha);
+
+		glm::vec2 position(size_t i) const { return { positionX[i], positionY[i] }; }
+		glm::vec3 color(size_t i) const { return { colorR[i], colorG[i], colorB[i] }; }
+		float scale(size_t i) const { return scales[i]; }
+		LodGroupHandle lodGroup(size_t i) const { return lodGroups[i]; }
+		uint32_t material(size_t i) const { return materials[i]; }
+
+		// Read by the culling kernels, which also want whole arrays
+		const float* positionsX() const { return positionX.data(); }
+		const float* positionsY() const { return positionY.data(); }
+		const float* scaleData() const { return scales.data(); }
+
+		// Times the update kernels over objectCount random objects
+		static void benchmark(size_t objectCount);
+
+	private:
+		void updateRange(size_t begin, size_t end, float dt);
+		void updateRangeScalar(size_t begin, size_t end, float dt);
+
+		std::vector<float> positionX;
+		std::vector<float> positionY;
+		std::vector<float> velocityX;
+		std::vector<float> velocityY;
+		std::vector<float> baseScales;
+		std::vector<float> scales;
+		// 0 to 1, drives the scale pulse
+		std::vector<float> phases;
+		std::vector<float> colorR;
+		std::vector<float> colorG;
+		std::vector<float> colorB;
+		std::vector<LodGroupHandle> lodGroups;
+		std::vector<uint32_t> materials;
+	};
+}
@@ -0,0 +1,273 @@
+#include "lve_shader_watcher.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace lve
+{
+	static bool isGlslSource(const std::filesystem::path& path)
+	{
+		auto extension = path.extension().string();
+		return extension == ".vert" || extension == ".frag" || extension == ".comp" ||
+			extension == ".geom" || extension == ".tesc" || extension == ".tese";
+	}
+
+	LveShaderWatcher::LveShaderWatcher(std::string shaderDirectory)
+		: shaderDirectory(std::move(shaderDirectory))
+	{
+#ifdef __linux__
+		inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyDescriptor < 0)
+			throw std::runtime_error("Failed to watch shader directory: " + this->shaderDirectory.string());
+		if (inotify_add_watch(inotifyDescriptor, this->shaderDirectory.string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			close(inotifyDescriptor);
+			throw std::runtime_error("Failed to watch shader directory: " + this->shaderDirectory.string());
+		}
+#else
+		// Without inotify the directory is polled, so remember where every source starts from
+		for (const auto& entry : std::filesystem::directory_iterator(this->shaderDirectory))
+			if (isGlslSource(entry.path()))
+				writeTimes.emplace_back(entry.path(), entry.last_write_time());
+#endif
+		worker = std::thread(&LveShaderWatcher::workerLoop, this);
+	}
+
+	LveShaderWatcher::~LveShaderWatcher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		buildFinished.notify_all();
+		worker.join();
+
+#ifdef __linux__
+		close(inotifyDescriptor);
+#endif
+	}
+
+	void LveShaderWatcher::watch(const std::string& name, const std::vector<std::string>& glslSources, PipelineFactory factory)
+	{
+		WatchedPipeline pipeline{ name, {}, std::move(factory) };
+		for (const auto& source : glslSources)
+			pipeline.sources.push_back(std::filesystem::path(source).lexically_normal());
+
+		std::lock_guard<std::mutex> lock(mutex);
+		watched.push_back(std::move(pipeline));
+	}
+
+	std::vector<LveShaderWatcher::RebuiltPipeline> LveShaderWatcher::takeRebuiltPipelines()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		rebuiltReady.store(false, std::memory_order_release);
+		std::vector<RebuiltPipeline> taken;
+		taken.swap(rebuilt);
+		return taken;
+	}
+
+	void LveShaderWatcher::pause()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		paused = true;
+		buildFinished.wait(lock, [this] { return !building; });
+	}
+
+	void LveShaderWatcher::resume()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			paused = false;
+		}
+		buildFinished.notify_all();
+	}
+
+	void LveShaderWatcher::workerLoop()
+	{
+		while (running)
+		{
+			auto changed = waitForChanges();
+			if (changed.empty())
+				continue;
+
+			// Editors often save in several writes, give them a moment to settle
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			auto more = waitForChanges();
+			changed.insert(changed.end(), more.begin(), more.end());
+			std::sort(changed.begin(), changed.end());
+			changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+			std::vector<std::filesystem::path> compiled;
+			for (const auto& source : changed)
+				if (compile(source))
+					compiled.push_back(source);
+
+			if (!compiled.empty())
+				rebuild(compiled);
+		}
+	}
+
+	std::vector<std::filesystem::path> LveShaderWatcher::waitForChanges()
+	{
+		std::vector<std::filesystem::path> changed;
+#ifdef __linux__
+		pollfd descriptor{ inotifyDescriptor, POLLIN, 0 };
+		if (poll(&descriptor, 1, 250) <= 0)
+			return changed;
+
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(inotifyDescriptor, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* cursor = buffer; cursor < buffer + length;)
+			{
+				auto event = reinterpret_cast<const inotify_event*>(cursor);
+				if (event->len > 0)
+				{
+					auto path = (shaderDirectory / event->name).lexically_normal();
+					if (isGlslSource(path))
+						changed.push_back(path);
+				}
+				cursor += sizeof(inotify_event) + event->len;
+			}
+		}
+#else
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(shaderDirectory, error))
+		{
+			if (!isGlslSource(entry.path()))
+				continue;
+
+			auto writeTime = entry.last_write_time(error);
+			auto known = std::find_if(writeTimes.begin(), writeTimes.end(),
+				[&](const auto& item) { return item.first == entry.path(); });
+			if (known == writeTimes.end())
+				writeTimes.emplace_back(entry.path(), writeTime);
+			else if (known->second != writeTime)
+				known->second = writeTime;
+			else
+				continue;
+			changed.push_back(entry.path().lexically_normal());
+		}
+#endif
+		return changed;
+	}
+
+	// Runs glslc itself rather than a shell, so nothing in the paths is interpreted. Returns its
+	// exit code, or -1 when it could not be started
+	static int runGlslc(const std::string& source, const std::string& output)
+	{
+#ifdef _WIN32
+		// _spawnlp joins the arguments with spaces, Windows paths cannot contain quotes
+		std::string quotedSource = "\"" + source + "\"";
+		std::string quotedOutput = "\"" + output + "\"";
+		return static_cast<int>(_spawnlp(_P_WAIT, "glslc", "glslc", quotedSource.c_str(), "-o", quotedOutput.c_str(), nullptr));
+#else
+		std::string program = "glslc";
+		std::string outputFlag = "-o";
+		std::string sourceArgument = source;
+		std::string outputArgument = output;
+		char* arguments[] = { program.data(), sourceArgument.data(), outputFlag.data(), outputArgument.data(), nullptr };
+
+		pid_t pid;
+		if (posix_spawnp(&pid, "glslc", nullptr, nullptr, arguments, environ) != 0)
+			return -1;
+		int status = 0;
+		if (waitpid(pid, &status, 0) < 0)
+			return -1;
+		return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+	}
+
+	bool LveShaderWatcher::compile(const std::filesystem::path& source)
+	{
+		// Same invocation as compile.bat, glslc comes with the Vulkan SDK
+		auto output = source.string() + ".spv";
+
+		auto start = std::chrono::high_resolution_clock::now();
+		int result = runGlslc(source.string(), output);
+		std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+		if (result != 0)
+		{
+			std::cerr << "Shader compile failed, keeping the previous pipeline: " << source.string() << "\n";
+			return false;
+		}
+		std::cout << "Recompiled " << source.string() << " in " << duration.count() << "ms\n";
+		return true;
+	}
+
+	void LveShaderWatcher::rebuild(const std::vector<std::filesystem::path>& changed)
+	{
+		std::vector<WatchedPipeline> affected;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			buildFinished.wait(lock, [this] { return !paused || !running; });
+			if (!running)
+				return;
+
+			building = true;
+			for (const auto& pipeline : watched)
+			{
+				bool uses = std::any_of(pipeline.sources.begin(), pipeline.sources.end(), [&](const auto& source)
+					{
+						return std::find(changed.begin(), changed.end(), source) != changed.end();
+					});
+				if (uses)
+					affected.push_back(pipeline);
+			}
+		}
+
+		std::vector<RebuiltPipeline> results;
+		for (auto& pipeline : affected)
+		{
+			try
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				results.emplace_back(pipeline.name, pipeline.factory());
+				std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+				std::cout << "Rebuilt pipeline " << pipeline.name << " in " << duration.count() << "ms\n";
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Pipeline rebuild failed, keeping the previous one: " << pipeline.name << ": " << e.what() << "\n";
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			building = false;
+			for (auto& result : results)
+			{
+				// A newer build of the same pipeline replaces one that was never picked up
+				auto pending = std::find_if(rebuilt.begin(), rebuilt.end(),
+					[&](const auto& item) { return item.first == result.first; });
+				if (pending != rebuilt.end())
+					pending->second = std::move(result.second);
+				else
+					rebuilt.push_back(std::move(result));
+			}
+			if (!rebuilt.empty())
+				rebuiltReady.store(true, std::memory_order_release);
+		}
+		buildFinished.notify_all();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "lve_pipeline.hpp"
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lve
+{
+	// Watches the shader directory on a worker thread, recompiles GLSL that changed into SPIR-V
+	// and rebuilds the pipelines that use it, so the render loop never waits on a compile.
+	// Rebuilt pipelines are handed back to be swapped in at a frame boundary.
+	class LveShaderWatcher
+	{
+	public:
+		using PipelineFactory = std::function<std::unique_ptr<LvePipeline>()>;
+		using RebuiltPipeline = std::pair<std::string, std::unique_ptr<LvePipeline>>;
+
+		explicit LveShaderWatcher(std::string shaderDirectory);
+		~LveShaderWatcher();
+
+		LveShaderWatcher(const LveShaderWatcher&) = delete;
+		LveShaderWatcher& operator=(const LveShaderWatcher&) = delete;
+
+		// glslSources are the files whose ".spv" the factory reads, e.g. "shaders/simple_shader.vert"
+		void watch(const std::string& name, const std::vector<std::string>& glslSources, PipelineFactory factory);
+
+		// Cheap enough to ask every frame, only takes the lock when something is ready
+		bool hasRebuiltPipelines() const { return rebuiltReady.load(std::memory_order_acquire); }
+		std::vector<RebuiltPipeline> takeRebuiltPipelines();
+
+		// Waits for a build in progress and holds off new ones, used while the
+		// state the factories read (render pass, layouts) is being replaced
+		void pause();
+		void resume();
+
+	private:
+		struct WatchedPipeline
+		{
+			std::string name;
+			std::vector<std::filesystem::path> sources;
+			PipelineFactory factory;
+		};
+
+		void workerLoop();
+		std::vector<std::filesystem::path> waitForChanges();
+		bool compile(const std::filesystem::path& source);
+		void rebuild(const std::vector<std::filesystem::path>& changed);
+
+		std::filesystem::path shaderDirectory;
+		std::vector<WatchedPipeline> watched;
+
+		std::mutex mutex;
+		std::condition_variable buildFinished;
+		bool paused = false;
+		bool building = false;
+		std::vector<RebuiltPipeline> rebuilt;
+		std::atomic<bool> rebuiltReady{ false };
+
+		std::atomic<bool> running{ true };
+		std::thread worker;
+
+#ifdef __linux__
+		int inotifyDescriptor = -1;
+#else
+		std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> writeTimes;
+#endif
+	};
+}
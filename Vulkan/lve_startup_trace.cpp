@@ -0,0 +1,87 @@
+#include "lve_startup_trace.hpp"
+
+// std
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace lve
+{
+	// Initialized before main runs, on the main thread, close enough to the process start
+	static const auto processStart = std::chrono::steady_clock::now();
+	static const auto mainThread = std::this_thread::get_id();
+
+	LveStartupTrace::Phase::Phase(const char* name)
+		: name(name), startMs(LveStartupTrace::now())
+	{
+	}
+
+	LveStartupTrace::Phase::~Phase()
+	{
+		LveStartupTrace::get().add({ name, std::this_thread::get_id(), startMs, LveStartupTrace::now() });
+	}
+
+	LveStartupTrace& LveStartupTrace::get()
+	{
+		static LveStartupTrace trace;
+		return trace;
+	}
+
+	double LveStartupTrace::now()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+	}
+
+	void LveStartupTrace::add(const Record& record)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Phases of a later swapchain recreation are not startup anymore
+		if (timeToFirstFrameMs < 0.0)
+			records.push_back(record);
+	}
+
+	void LveStartupTrace::firstFramePresented()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (timeToFirstFrameMs >= 0.0)
+				return;
+			timeToFirstFrameMs = now();
+		}
+		report(std::cout);
+	}
+
+	bool LveStartupTrace::finished() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return timeToFirstFrameMs >= 0.0;
+	}
+
+	void LveStartupTrace::report(std::ostream& out) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto sorted = records;
+		std::sort(sorted.begin(), sorted.end(), [](const Record& a, const Record& b) { return a.startMs < b.startMs; });
+
+		std::vector<std::thread::id> workers;
+		out << "Startup trace (ms since process start)\n";
+		for (const auto& record : sorted)
+		{
+			std::string thread = "main";
+			if (record.thread != mainThread)
+			{
+				auto worker = std::find(workers.begin(), workers.end(), record.thread);
+				if (worker == workers.end())
+					worker = workers.insert(workers.end(), record.thread);
+				thread = "worker " + std::to_string(worker - workers.begin() + 1);
+			}
+
+			out << std::fixed << std::setprecision(2)
+				<< "  " << std::setw(9) << record.startMs << " +" << std::setw(8) << (record.endMs - record.startMs)
+				<< "  " << std::left << std::setw(9) << thread << std::right << " " << record.name << "\n";
+		}
+		out << "Time to first presented frame: " << timeToFirstFrameMs << "ms\n";
+		out << std::defaultfloat << std::setprecision(6);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lve
+{
+	// Records how long every startup phase takes and on which thread, measured from process
+	// start, until the first frame is presented. Phases are timed with a scoped Phase object:
+	//     LveStartupTrace::Phase phase{ "createInstance" };
+	class LveStartupTrace
+	{
+	public:
+		class Phase
+		{
+		public:
+			explicit Phase(const char* name);
+			~Phase();
+
+			Phase(const Phase&) = delete;
+			Phase& operator=(const Phase&) = delete;
+
+		private:
+			const char* name;
+			double startMs;
+		};
+
+		static LveStartupTrace& get();
+
+		// Milliseconds since the process started
+		static double now();
+
+		// The tracked metric, only the first call counts. Prints the report
+		void firstFramePresented();
+		// Any thread, the render thread sets it
+		bool finished() const;
+
+		void report(std::ostream& out) const;
+
+	private:
+		struct Record
+		{
+			const char* name;
+			std::thread::id thread;
+			double startMs;
+			double endMs;
+		};
+
+		LveStartupTrace() = default;
+		void add(const Record& record);
+
+		mutable std::mutex mutex;
+		std::vector<Record> records;
+		double timeToFirstFrameMs = -1.0;
+	};
+}
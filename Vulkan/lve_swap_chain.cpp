@@ -1,5 +1,7 @@
 #include "lve_swap_chain.hpp"
 
+#include "lve_trace.hpp"
+
 // std
 #include <array>
 #include <cstdlib>
@@ -30,9 +32,16 @@ namespace lve {
     {
         createSwapChain();
         createImageViews();
-        createRenderPass();
+        depthFormat = findDepthFormat();
+        // Dynamic rendering takes the image views directly, so a resize only
+        // replaces images and views
+        if (!device.dynamicRenderingEnabled()) {
+          createRenderPass();
+        }
         createDepthResources();
-        createFramebuffers();
+        if (!device.dynamicRenderingEnabled()) {
+          createFramebuffers();
+        }
         createSyncObjects();
     }
 
@@ -50,14 +59,16 @@ namespace lve {
       for (int i = 0; i < depthImages.size(); i++) {
         vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
         vkDestroyImage(device.device(), depthImages[i], nullptr);
-        vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+        device.freeMemory(depthImageMemorys[i]);
       }
 
       for (auto framebuffer : swapChainFramebuffers) {
         vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
       }
 
-      vkDestroyRenderPass(device.device(), renderPass, nullptr);
+      if (renderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(device.device(), renderPass, nullptr);
+      }
 
       // cleanup synchronization objects
       for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -68,6 +79,7 @@ namespace lve {
     }
 
     VkResult LveSwapChain::acquireNextImage(uint32_t *imageIndex) {
+      LVE_TRACE_SCOPE("acquireNextImage");
       vkWaitForFences(
           device.device(),
           1,
@@ -88,6 +100,7 @@ namespace lve {
 
     VkResult LveSwapChain::submitCommandBuffers(
         const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+      LVE_TRACE_SCOPE("submitCommandBuffers");
       if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
         vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
       }
@@ -157,6 +170,11 @@ namespace lve {
       createInfo.imageExtent = extent;
       createInfo.imageArrayLayers = 1;
       createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+      // Lets LveReadback copy the presented images out, where the surface allows it
+      if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      }
+      transferSource = (createInfo.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
 
       QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
       uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -218,7 +236,7 @@ namespace lve {
 
     void LveSwapChain::createRenderPass() {
       VkAttachmentDescription depthAttachment{};
-      depthAttachment.format = findDepthFormat();
+      depthAttachment.format = depthFormat;
       depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
       depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
       depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -303,7 +321,6 @@ namespace lve {
     }
 
     void LveSwapChain::createDepthResources() {
-      VkFormat depthFormat = findDepthFormat();
       VkExtent2D swapChainExtent = getSwapChainExtent();
 
       depthImages.resize(imageCount());
@@ -339,6 +356,9 @@ namespace lve {
         viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
         viewInfo.format = depthFormat;
         viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (hasStencilComponent(depthFormat)) {
+          viewInfo.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
         viewInfo.subresourceRange.baseMipLevel = 0;
         viewInfo.subresourceRange.levelCount = 1;
         viewInfo.subresourceRange.baseArrayLayer = 0;
@@ -434,4 +454,139 @@ namespace lve {
           VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
     }
 
+    bool LveSwapChain::hasStencilComponent(VkFormat format) {
+      return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+    }
+
+    void LveSwapChain::beginRendering(
+        VkCommandBuffer commandBuffer,
+        uint32_t imageIndex,
+        VkClearColorValue clearColor,
+        VkClearDepthStencilValue clearDepthStencil,
+        bool transitions) {
+      if (!usesDynamicRendering()) {
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = clearColor;
+        clearValues[1].depthStencil = clearDepthStencil;
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = swapChainExtent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        return;
+      }
+
+      // The same transitions and dependency the render pass declares: both images
+      // start UNDEFINED since they are cleared, and wait on the previous frame's writes
+      if (transitions) {
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = 0;
+        barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = swapChainImages[imageIndex];
+        barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        // The previous frame that used this depth image wrote it in its late fragment tests
+        barriers[1] = barriers[0];
+        barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].image = depthImages[imageIndex];
+        barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (hasStencilComponent(depthFormat)) {
+          barriers[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            static_cast<uint32_t>(barriers.size()),
+            barriers.data());
+      }
+
+      VkRenderingAttachmentInfoKHR colorAttachment{};
+      colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+      colorAttachment.imageView = swapChainImageViews[imageIndex];
+      colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      colorAttachment.clearValue.color = clearColor;
+
+      VkRenderingAttachmentInfoKHR depthAttachment{};
+      depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+      depthAttachment.imageView = depthImageViews[imageIndex];
+      depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+      depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      depthAttachment.clearValue.depthStencil = clearDepthStencil;
+
+      VkRenderingInfoKHR renderingInfo{};
+      renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+      renderingInfo.renderArea = {{0, 0}, swapChainExtent};
+      renderingInfo.layerCount = 1;
+      renderingInfo.colorAttachmentCount = 1;
+      renderingInfo.pColorAttachments = &colorAttachment;
+      renderingInfo.pDepthAttachment = &depthAttachment;
+      // A combined format has to be given as both, with the same view and layout
+      if (hasStencilComponent(depthFormat)) {
+        renderingInfo.pStencilAttachment = &depthAttachment;
+      }
+
+      device.cmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+
+    void LveSwapChain::endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool transitions) {
+      if (!usesDynamicRendering()) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+      }
+
+      device.cmdEndRendering(commandBuffer);
+      if (!transitions) {
+        return;
+      }
+
+      // The render pass' finalLayout, presentation waits on the renderFinished semaphore
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      barrier.dstAccessMask = 0;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = swapChainImages[imageIndex];
+      barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+      vkCmdPipelineBarrier(
+          commandBuffer,
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+          0,
+          0,
+          nullptr,
+          0,
+          nullptr,
+          1,
+          &barrier);
+    }
+
     }  // namespace lve
@@ -24,9 +24,18 @@ namespace lve
         LveSwapChain(const LveSwapChain &) = delete;
         LveSwapChain& operator=(const LveSwapChain &) = delete;
 
+        // Both are null when the device renders without render passes
         VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
         VkRenderPass getRenderPass() { return renderPass; }
+        bool usesDynamicRendering() { return renderPass == VK_NULL_HANDLE; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+        VkImage getImage(int index) { return swapChainImages[index]; }
+        VkImage getDepthImage(int index) { return depthImages[index]; }
+        VkImageAspectFlags depthAspect() {
+        return hasStencilComponent(depthFormat) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+        // The images can be copied from, they are in PRESENT_SRC_KHR after endRendering
+        bool supportsReadback() { return transferSource; }
         size_t imageCount() { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
         VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -37,6 +46,20 @@ namespace lve
         return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
         }
         VkFormat findDepthFormat();
+        static bool hasStencilComponent(VkFormat format);
+
+        // Starts drawing into the color and depth image of imageIndex, with a render pass
+        // or, when the device supports it, dynamic rendering plus the layout transitions
+        // the render pass would have done. Without transitions the caller does them around
+        // dynamic rendering, e.g. a render graph, a render pass always does its own
+        void beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+                            VkClearColorValue clearColor, VkClearDepthStencilValue clearDepthStencil,
+                            bool transitions = true);
+        void endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool transitions = true);
+
+        // Which of the MAX_FRAMES_IN_FLIGHT slots the next acquire and submit use,
+        // its fence has signaled once acquireNextImage returns
+        size_t currentFrameIndex() { return currentFrame; }
 
         VkResult acquireNextImage(uint32_t *imageIndex);
         VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
@@ -59,9 +82,11 @@ namespace lve
 
         VkFormat swapChainImageFormat;
         VkExtent2D swapChainExtent;
+        bool transferSource = false;
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFormat depthFormat;
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
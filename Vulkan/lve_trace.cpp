@@ -0,0 +1,195 @@
+#include "lve_trace.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace lve
+{
+	namespace
+	{
+		struct Event
+		{
+			const char* name;
+			int64_t startNs;
+			int64_t endNs;
+		};
+
+		// Only its own thread adds to a thread's track, the lock is for start() and the export
+		struct Track
+		{
+			uint32_t id;
+			std::string name;
+			bool thread;
+			std::mutex mutex;
+			std::vector<Event> events;
+		};
+
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<Track>> tracks;
+			int64_t startNs = 0;
+
+			Track& add(std::string name, bool thread)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto track = std::make_unique<Track>();
+				track->id = static_cast<uint32_t>(tracks.size() + 1);
+				track->name = name.empty() ? "thread " + std::to_string(track->id) : std::move(name);
+				track->thread = thread;
+				// Enough for a few thousand frames before the vector has to grow
+				track->events.reserve(16384);
+				tracks.push_back(std::move(track));
+				return *tracks.back();
+			}
+		};
+
+		Registry& registry()
+		{
+			static Registry instance;
+			return instance;
+		}
+
+		Track& threadTrack()
+		{
+			thread_local Track* track = &registry().add("", true);
+			return *track;
+		}
+
+		void add(Track& track, const Event& event)
+		{
+			std::lock_guard<std::mutex> lock(track.mutex);
+			track.events.push_back(event);
+		}
+	}
+
+	int64_t LveTrace::now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void LveTrace::start()
+	{
+		auto& tracks = registry();
+		{
+			std::lock_guard<std::mutex> lock(tracks.mutex);
+			for (auto& track : tracks.tracks)
+			{
+				std::lock_guard<std::mutex> trackLock(track->mutex);
+				track->events.clear();
+			}
+			tracks.startNs = now();
+		}
+		enabledFlag.store(true, std::memory_order_relaxed);
+	}
+
+	void LveTrace::stop()
+	{
+		enabledFlag.store(false, std::memory_order_relaxed);
+	}
+
+	void LveTrace::setThreadName(const std::string& name)
+	{
+		Track& track = threadTrack();
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		track.name = name;
+	}
+
+	void LveTrace::record(const char* name, int64_t startNs, int64_t endNs)
+	{
+		add(threadTrack(), { name, startNs, endNs });
+	}
+
+	void LveTrace::recordOnTrack(const char* trackName, const char* name, int64_t startNs, int64_t endNs)
+	{
+		auto& tracks = registry();
+		Track* track = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(tracks.mutex);
+			for (auto& candidate : tracks.tracks)
+			{
+				if (!candidate->thread && candidate->name == trackName)
+					track = candidate.get();
+			}
+		}
+		if (track == nullptr)
+			track = &tracks.add(trackName, false);
+		add(*track, { name, startNs, endNs });
+	}
+
+	size_t LveTrace::eventCount()
+	{
+		auto& tracks = registry();
+		std::lock_guard<std::mutex> lock(tracks.mutex);
+		size_t count = 0;
+		for (auto& track : tracks.tracks)
+		{
+			std::lock_guard<std::mutex> trackLock(track->mutex);
+			count += track->events.size();
+		}
+		return count;
+	}
+
+	static void writeString(std::ostream& out, const std::string& text)
+	{
+		out << '"';
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				out << '\\';
+			out << (static_cast<unsigned char>(c) < 0x20 ? ' ' : c);
+		}
+		out << '"';
+	}
+
+	void LveTrace::writeJson(std::ostream& out)
+	{
+		auto& tracks = registry();
+		std::lock_guard<std::mutex> lock(tracks.mutex);
+
+		// Complete events ("X") in microseconds since start(), one thread id per track
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		out << std::fixed << std::setprecision(3);
+		bool first = true;
+		auto separator = [&]() -> std::ostream&
+		{
+			if (!first)
+				out << ",\n";
+			first = false;
+			return out;
+		};
+		for (auto& track : tracks.tracks)
+		{
+			std::lock_guard<std::mutex> trackLock(track->mutex);
+			separator() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << track->id << ",\"args\":{\"name\":";
+			writeString(out, track->name);
+			out << "}}";
+			// GPU tracks below the threads
+			separator() << "{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":" << track->id
+				<< ",\"args\":{\"sort_index\":" << (track->thread ? 0 : 1000) + track->id << "}}";
+
+			for (const auto& event : track->events)
+			{
+				separator() << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << track->id << ",\"name\":";
+				writeString(out, event.name);
+				out << ",\"ts\":" << (event.startNs - tracks.startNs) / 1000.0 << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+			}
+		}
+		out << "\n]}\n";
+		out << std::defaultfloat << std::setprecision(6);
+	}
+
+	void LveTrace::writeJson(const std::string& filePath)
+	{
+		std::ofstream file{ filePath, std::ios::trunc };
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open trace file: " + filePath);
+		writeJson(file);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Tracing is compiled in unless LVE_TRACE is defined to 0. While it is not started a scope
+// costs one relaxed atomic load
+#ifndef LVE_TRACE
+#define LVE_TRACE 1
+#endif
+
+#if LVE_TRACE
+#define LVE_TRACE_CONCAT_INNER(a, b) a##b
+#define LVE_TRACE_CONCAT(a, b) LVE_TRACE_CONCAT_INNER(a, b)
+#define LVE_TRACE_SCOPE(name) ::lve::LveTrace::Scope LVE_TRACE_CONCAT(lveTraceScope, __LINE__){ name }
+#else
+#define LVE_TRACE_SCOPE(name) ((void)0)
+#endif
+
+namespace lve
+{
+	// A timeline of named scopes, one track per thread plus tracks for the GPU, written as
+	// Chrome trace event JSON that chrome://tracing and ui.perfetto.dev open. Every event is
+	// in steady_clock nanoseconds. Names are not copied, they have to be string literals:
+	//     LVE_TRACE_SCOPE("drawFrame");
+	class LveTrace
+	{
+	public:
+		class Scope
+		{
+		public:
+			explicit Scope(const char* name) : name(name), startNs(enabled() ? now() : -1) {}
+			~Scope()
+			{
+				if (startNs >= 0)
+					record(name, startNs, now());
+			}
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			const char* name;
+			int64_t startNs;
+		};
+
+		static bool enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+		static int64_t now();
+
+		// Drops what an earlier trace recorded
+		static void start();
+		static void stop();
+
+		// Names the calling thread's track, it is "thread N" otherwise
+		static void setThreadName(const std::string& name);
+		// On the calling thread's track
+		static void record(const char* name, int64_t startNs, int64_t endNs);
+		// On a track of its own that is not a thread, e.g. a queue
+		static void recordOnTrack(const char* track, const char* name, int64_t startNs, int64_t endNs);
+
+		static size_t eventCount();
+		static void writeJson(std::ostream& out);
+		static void writeJson(const std::string& filePath);
+
+	private:
+		inline static std::atomic<bool> enabledFlag{ false };
+	};
+}
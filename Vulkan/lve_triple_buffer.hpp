@@ -0,0 +1,64 @@
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace lve
+{
+	// Hands values from one writer thread to one reader thread without locks or waiting.
+	// The writer fills back() and publishes it, the reader takes the newest published
+	// value and keeps reading it until it asks again. Each side owns one of the three
+	// slots and the third is swapped through an atomic, so neither side ever sees a
+	// slot the other one is using, and values the reader was too slow for are skipped.
+	template<typename T>
+	class LveTripleBuffer
+	{
+	public:
+		LveTripleBuffer() = default;
+
+		LveTripleBuffer(const LveTripleBuffer&) = delete;
+		LveTripleBuffer& operator=(const LveTripleBuffer&) = delete;
+
+		// Starts every slot from value, only before either thread uses the buffer
+		void reset(const T& value)
+		{
+			for (auto& slot : slots)
+				slot = value;
+			backIndex = 0;
+			frontIndex = 1;
+			middle.store(2, std::memory_order_relaxed);
+		}
+
+		// Writer side
+		T& back() { return slots[backIndex]; }
+		void publish()
+		{
+			// release makes the writes to back() visible to the reader that takes it
+			uint8_t previous = middle.exchange(static_cast<uint8_t>(backIndex | FRESH), std::memory_order_acq_rel);
+			backIndex = previous & INDEX_MASK;
+		}
+
+		// Reader side, returns whether a newer value was taken
+		bool update()
+		{
+			if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+				return false;
+			uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+			frontIndex = previous & INDEX_MASK;
+			return true;
+		}
+		const T& front() const { return slots[frontIndex]; }
+
+	private:
+		static constexpr uint8_t INDEX_MASK = 3;
+		static constexpr uint8_t FRESH = 4;
+
+		std::array<T, 3> slots;
+		// Each index is only touched by its own thread, kept apart so they do not share a cache line
+		alignas(64) uint8_t backIndex = 0;
+		alignas(64) uint8_t frontIndex = 1;
+		alignas(64) std::atomic<uint8_t> middle{ 2 };
+	};
+}
@@ -1,5 +1,7 @@
 #include "lve_window.hpp" 
 
+#include "lve_startup_trace.hpp"
+
 #include <stdexcept>
 
 namespace lve
@@ -25,6 +27,8 @@ namespace lve
 
 	void LveWindow::initWindow()
 	{
+		// GLFW only allows this on the main thread, so it cannot be moved to a worker
+		LveStartupTrace::Phase phase{ "initWindow" };
 		glfwInit();
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
@@ -37,9 +41,10 @@ namespace lve
 	void LveWindow::frameBufferResizeCallback(GLFWwindow* window, int width, int height)
 	{
 		auto lveWindow = reinterpret_cast<LveWindow*>(glfwGetWindowUserPointer(window));
-		lveWindow->frameBufferResized = true;
+		// The flag goes last, so the size is already there when the render thread sees it
 		lveWindow->width = width;
 		lveWindow->height = height;
+		lveWindow->frameBufferResized = true;
 	}
 }
 
@@ -3,6 +3,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <string>
 
 namespace lve
@@ -16,7 +17,10 @@ namespace lve
 		LveWindow(const LveWindow&) = delete;
 		LveWindow& operator=(const LveWindow&) = delete;
 
+		// Main thread only, like every GLFW call
 		bool shouldClose() { return glfwWindowShouldClose(window); }
+
+		// The size is written by the event callbacks on the main thread and read by the render thread
 		bool wasWindowResized() { return frameBufferResized; }
 		void resetWindowResizedFlag() { frameBufferResized = false; }
 
@@ -30,9 +34,9 @@ namespace lve
 
 		GLFWwindow* window;
 
-		int width;
-		int height;
-		bool frameBufferResized = false;
+		std::atomic<int> width;
+		std::atomic<int> height;
+		std::atomic<bool> frameBufferResized{ false };
 
 		std::string windowName;
 	};
@@ -1,10 +1,18 @@
 #include "first_app.hpp"
+#include "lve_chaos_game.hpp"
+#include "lve_command_pool.hpp"
+#include "lve_frame_capture.hpp"
+#include "lve_job_system.hpp"
+#include "lve_regression.hpp"
+#include "lve_scene.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main()
+int main(int argc, char** argv)
 {
 	// Create Window
 	// Create Device
@@ -13,11 +21,137 @@ int main()
 	// Create Pipeline
 	// Create Command Buffers
 
-	lve::FirstApp app{};
+	// --bench-pipelines N builds N pipeline variants and exits
+	// --device X selects the GPU by index or name, overriding LVE_DEVICE
+	// --bench-scene N times the scene update over N objects and exits, no window needed
+	// --bench-jobs N times spawning N jobs and parallelFor scaling and exits, no window needed
+	// --bench-particles N times N GPU particles on the compute queue and exits
+	// --bench-sierpinski N compares the Sierpinski mesh with the procedural shader up to depth N and exits
+	// --bench-chaos N splats N chaos game points per frame and exits, headless, no window needed
+	// --chaos-resolution N sets the image size for --bench-chaos, the app's LVE_CHAOS_RESOLUTION default otherwise
+	// --bench-record N times getting N command buffers ready and recorded per round and exits, no window needed
+	// --capture FILE writes the draws of the first --capture-frames N frames (300 by default) to FILE
+	// --replay FILE renders a capture --replay-loops N times (1 by default) and exits, no window needed
+	// --readback DIR writes every presented frame to DIR as PNG, or as raw pixels with --readback-raw
+	// --regress DIR renders the regression scenes headless, on lavapipe unless --device says otherwise,
+	// compares them with the golden images and baseline in DIR and exits with failure on a regression.
+	// --regress-update stores them instead
+	// --trace FILE writes CPU scopes and GPU ranges of the first --trace-frames N frames (300 by default)
+	// to FILE as a Chrome trace, for chrome://tracing or ui.perfetto.dev
+	uint32_t benchPipelines = 0;
+	size_t benchScene = 0;
+	size_t benchJobs = 0;
+	uint32_t benchParticles = 0;
+	int benchSierpinski = 0;
+	uint64_t benchChaos = 0;
+	uint32_t chaosResolution = lve::LveChaosGame::DEFAULT_RESOLUTION;
+	uint32_t benchRecord = 0;
+	std::string captureFile;
+	uint32_t captureFrames = 300;
+	std::string replayFile;
+	uint32_t replayLoops = 1;
+	std::string readbackDirectory;
+	bool readbackRaw = false;
+	std::string regressDirectory;
+	bool regressUpdate = false;
+	std::string traceFile;
+	uint32_t traceFrames = 300;
+	std::string preferredDevice;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--bench-pipelines") == 0 && i + 1 < argc)
+			benchPipelines = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+			preferredDevice = argv[++i];
+		else if (std::strcmp(argv[i], "--bench-scene") == 0 && i + 1 < argc)
+			benchScene = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--bench-jobs") == 0 && i + 1 < argc)
+			benchJobs = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--bench-particles") == 0 && i + 1 < argc)
+			benchParticles = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--bench-sierpinski") == 0 && i + 1 < argc)
+			benchSierpinski = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--bench-chaos") == 0 && i + 1 < argc)
+			benchChaos = std::strtoull(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--chaos-resolution") == 0 && i + 1 < argc)
+			chaosResolution = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--bench-record") == 0 && i + 1 < argc)
+			benchRecord = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			captureFile = argv[++i];
+		else if (std::strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+			captureFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replayFile = argv[++i];
+		else if (std::strcmp(argv[i], "--replay-loops") == 0 && i + 1 < argc)
+			replayLoops = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--readback") == 0 && i + 1 < argc)
+			readbackDirectory = argv[++i];
+		else if (std::strcmp(argv[i], "--readback-raw") == 0)
+			readbackRaw = true;
+		else if (std::strcmp(argv[i], "--regress") == 0 && i + 1 < argc)
+			regressDirectory = argv[++i];
+		else if (std::strcmp(argv[i], "--regress-update") == 0)
+			regressUpdate = true;
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			traceFile = argv[++i];
+		else if (std::strcmp(argv[i], "--trace-frames") == 0 && i + 1 < argc)
+			traceFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+	}
+
+	if (benchScene > 0)
+	{
+		lve::LveScene::benchmark(benchScene);
+		return EXIT_SUCCESS;
+	}
+	if (benchJobs > 0)
+	{
+		lve::LveJobSystem::benchmark(benchJobs);
+		return EXIT_SUCCESS;
+	}
+	if (benchChaos > 0 || benchRecord > 0 || !replayFile.empty() || !regressDirectory.empty())
+	{
+		try
+		{
+			if (!regressDirectory.empty())
+			{
+				if (!lve::LveRegression::run(preferredDevice, regressDirectory, lve::FirstApp::regressionScenes(), regressUpdate))
+					return EXIT_FAILURE;
+			}
+			else if (!replayFile.empty())
+				lve::LveFrameReplay::run(preferredDevice, replayFile, replayLoops);
+			else if (benchChaos > 0)
+				lve::LveChaosGame::benchmark(preferredDevice, benchChaos, chaosResolution);
+			else
+				lve::LveCommandPool::benchmark(preferredDevice, benchRecord);
+		} catch (const std::exception& e)
+		{
+			std::cerr << e.what() << "\n";
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	lve::FirstApp app{ preferredDevice };
 
 	try
 	{
-		app.run();
+		if (benchPipelines > 0)
+			app.benchmarkPipelines(benchPipelines);
+		else if (benchParticles > 0)
+			app.benchmarkParticles(benchParticles);
+		else if (benchSierpinski > 0)
+			app.benchmarkSierpinski(benchSierpinski);
+		else
+		{
+			if (!captureFile.empty())
+				app.startCapture(captureFile, captureFrames);
+			if (!readbackDirectory.empty())
+				app.startReadback(readbackDirectory, readbackRaw);
+			if (!traceFile.empty())
+				app.startTrace(traceFile, traceFrames);
+			app.run();
+		}
 	} catch (const std::exception &e) 
 	{
 		std::cerr << e.what() << "\n";
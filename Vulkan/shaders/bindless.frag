@@ -0,0 +1,18 @@
+#version 450
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) flat in vec3 instanceColor;
+layout (location = 2) flat in int colorMode;
+
+layout (location = 0) out vec4 outColor;
+
+// COLOR_MODE of simple_shader.frag, from the instance's material instead of the pipeline
+void main()
+{
+	if (colorMode == 1)
+		outColor = vec4(fragColor, 1.0);
+	else if (colorMode == 2)
+		outColor = vec4(fragColor * instanceColor, 1.0);
+	else
+		outColor = vec4(instanceColor, 1.0);
+}
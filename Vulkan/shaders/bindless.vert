@@ -0,0 +1,43 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec3 color;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) flat out vec3 instanceColor;
+layout (location = 2) flat out int colorMode;
+
+// Matches BindlessInstanceData, one per object drawn this frame
+struct Instance
+{
+	vec2 offset;
+	float scale;
+	uint material;
+	vec4 color;
+};
+
+struct Material
+{
+	int colorMode;
+};
+
+// Every storage buffer of LveBindlessTable is in the array at binding 0, declared once per
+// layout that is read from it
+layout (set = 0, binding = 0) readonly buffer Instances { Instance instances[]; } instanceBuffers[];
+layout (set = 0, binding = 0) readonly buffer Materials { Material materials[]; } materialBuffers[];
+
+// Handles into the table, the same for every draw of a frame
+layout (push_constant) uniform Push {
+	uint instances;
+	uint materials;
+} push;
+
+void main()
+{
+	Instance instance = instanceBuffers[push.instances].instances[gl_InstanceIndex];
+	gl_Position = vec4(position * instance.scale + instance.offset, 0.0, 1.0);
+	fragColor = color;
+	instanceColor = instance.color.rgb;
+	colorMode = materialBuffers[push.materials].materials[instance.material].colorMode;
+}
@@ -0,0 +1,23 @@
+#version 450
+
+layout (location = 0) in vec2 uv;
+
+layout (location = 0) out vec4 outColor;
+
+layout (set = 0, binding = 0, r32ui) uniform readonly uimage2D counts;
+
+layout (std430, set = 0, binding = 1) readonly buffer Peak
+{
+	uint peak;
+};
+
+void main()
+{
+	ivec2 size = imageSize(counts);
+	uint count = imageLoad(counts, clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1)).r;
+
+	// Counts span several orders of magnitude, a log scale keeps the sparse parts visible
+	float density = peak > 0u ? log(1.0 + float(count)) / log(1.0 + float(peak)) : 0.0;
+	vec3 color = mix(vec3(0.01), vec3(1.0, 0.75, 0.35), pow(density, 0.75));
+	outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 450
+
+// 0,0 at the top left corner of the screen, 1,1 at the bottom right
+layout (location = 0) out vec2 uv;
+
+void main()
+{
+	// One triangle covering the whole screen, no vertex buffer: (-1,-1) (3,-1) (-1,3)
+	vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0;
+	uv = position * 0.5 + 0.5;
+	gl_Position = vec4(position, 0.0, 1.0);
+}
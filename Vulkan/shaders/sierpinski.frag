@@ -0,0 +1,50 @@
+#version 450
+
+layout (location = 0) in vec2 barycentric;
+
+layout (location = 0) out vec4 outColor;
+
+layout (push_constant) uniform Push {
+	vec2 left;
+	vec2 right;
+	vec2 top;
+	uint depth;
+	vec3 color;
+} push;
+
+// Bits kept below the finest level, the last levels are decided on them
+const uint SUBCELL_BITS = 8u;
+
+// Draws the same removed middle triangles as the inverse Sierpinski mesh, per pixel.
+// At level k the point sits in the middle triangle of its cell when the fractional
+// parts of 2^k * u and 2^k * v add up to 1 or more, which in fixed point is a carry
+// into bit (bits - k) when adding U and V. The highest such carry is the first level
+// that removed the point
+void main()
+{
+	float u = barycentric.x;
+	float v = barycentric.y;
+	if (u < 0.0 || v < 0.0 || u + v > 1.0)
+		discard;
+
+	// A float has 24 bits of mantissa, deeper levels would be below its precision
+	uint levels = min(push.depth, 23u);
+	uint bits = levels + SUBCELL_BITS;
+	float scale = float(1u << bits);
+	uint U = uint(u * scale);
+	uint V = uint(v * scale);
+
+	uint carries = ((U + V) ^ U ^ V) & (((1u << levels) - 1u) << SUBCELL_BITS);
+	if (carries == 0u)
+		discard;
+
+	// Position inside the removed triangle, weighted like the mesh's red, green and blue corners
+	int carry = findMSB(carries);
+	uint cellMask = (1u << carry) - 1u;
+	float cellSize = float(1u << carry);
+	float x = float(U & cellMask) / cellSize;
+	float y = float(V & cellMask) / cellSize;
+	vec3 color = vec3(1.0 - x, x + y - 1.0, 1.0 - y);
+
+	outColor = vec4(color * push.color, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 450
+
+// Weights of the right and top corners, the left one has the rest
+layout (location = 0) out vec2 barycentric;
+
+layout (push_constant) uniform Push {
+	vec2 left;
+	vec2 right;
+	vec2 top;
+	uint depth;
+	vec3 color;
+} push;
+
+void main()
+{
+	// One triangle covering the whole screen, no vertex buffer: (-1,-1) (3,-1) (-1,3)
+	vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0;
+
+	// Barycentric coordinates are affine in the position, so interpolating them is exact
+	mat2 edges = mat2(push.right - push.left, push.top - push.left);
+	barycentric = inverse(edges) * (position - push.left);
+	gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -1,15 +1,25 @@
 #version 450
 
-// layout (location = 0) in vec3 fragColor;
+layout (location = 0) in vec3 fragColor;
 
 layout (location = 0) out vec4 outColor;
 
 layout (push_constant) uniform Push {
 	vec2 offset;
 	vec3 color;
+	float scale;
 } push;
 
+// Set when the pipeline is built, the branch below is folded away
+// 0: push constant color, 1: vertex color, 2: both multiplied
+layout (constant_id = 0) const int COLOR_MODE = 0;
+
 void main()
 {
-	outColor = vec4(push.color, 1.0);
+	if (COLOR_MODE == 1)
+		outColor = vec4(fragColor, 1.0);
+	else if (COLOR_MODE == 2)
+		outColor = vec4(fragColor * push.color, 1.0);
+	else
+		outColor = vec4(push.color, 1.0);
 }
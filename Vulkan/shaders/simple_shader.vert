@@ -3,15 +3,16 @@
 layout (location = 0) in vec2 position;
 layout (location = 1) in vec3 color;
 
-// layout (location = 0) out vec3 fragColor;
+layout (location = 0) out vec3 fragColor;
 
 layout (push_constant) uniform Push {
 	vec2 offset;
 	vec3 color;
+	float scale;
 } push;
 
 void main()
 {
-	gl_Position = vec4(position + push.offset, 0.0, 1.0);
-	// fragColor = color;
+	gl_Position = vec4(position * push.scale + push.offset, 0.0, 1.0);
+	fragColor = color;
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "lve_culling.hpp"
+#include "lve_test.hpp"
+
+// std
+#include <random>
+#include <vector>
+
+using namespace lve;
+
+// Enough objects that cull() splits them into chunks on the job system
+static constexpr size_t OBJECT_COUNT = 200003;
+
+static LveScene randomScene(size_t count, uint32_t lodGroupCount)
+{
+	LveScene scene;
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> unit{ -1.0f, 1.0f };
+	for (size_t i = 0; i < count; ++i)
+	{
+		scene.add({ unit(random), unit(random) }, { 0.0f, 0.0f }, 0.01f + 0.05f * (unit(random) + 1.0f),
+			{ 1.0f, 1.0f, 1.0f }, static_cast<LodGroupHandle>(i % lodGroupCount));
+	}
+	return scene;
+}
+
+// One object at a time, the way cullRange's scalar tail does it
+static std::vector<VisibleObject> reference(
+	const LveScene& scene, const std::vector<LodGroup>& lodGroups, const LveCulling::View& view)
+{
+	std::vector<VisibleObject> visible;
+	for (size_t i = 0; i < scene.size(); ++i)
+	{
+		const LodGroup& group = lodGroups[scene.lodGroup(i)];
+		float radius = scene.scale(i) * group.boundingRadius;
+		glm::vec2 position = scene.position(i);
+		if (position.x + radius < view.center.x - view.halfExtent || position.x - radius > view.center.x + view.halfExtent ||
+			position.y + radius < view.center.y - view.halfExtent || position.y - radius > view.center.y + view.halfExtent)
+			continue;
+
+		float pixels = radius * view.viewportHeight / view.halfExtent;
+		size_t level = 0;
+		while (level + 1 < group.levels.size() && pixels < group.levels[level].minPixels)
+			++level;
+		visible.push_back({ static_cast<uint32_t>(i), group.levels[level].model });
+	}
+	return visible;
+}
+
+int main()
+{
+	std::vector<LodGroup> lodGroups{
+		{ { { 0, 0.0f } }, 0.71f },
+		{ { { 1, 300.0f }, { 2, 120.0f }, { 3, 40.0f }, { 4, 0.0f } }, 1.42f },
+	};
+	LveScene scene = randomScene(OBJECT_COUNT, static_cast<uint32_t>(lodGroups.size()));
+
+	LveCulling::View view;
+	view.center = { 0.1f, -0.2f };
+	view.halfExtent = 0.6f;
+
+	auto expected = reference(scene, lodGroups, view);
+	LVE_CHECK(!expected.empty());
+	LVE_CHECK(expected.size() < scene.size());
+
+	// Into an arena, the way FirstApp calls it every frame
+	LveFrameArena arena{ OBJECT_COUNT * sizeof(VisibleObject) };
+	for (int frame = 0; frame < 3; ++frame)
+	{
+		arena.reset();
+		FrameVector<VisibleObject> visible{ LveArenaAllocator<VisibleObject>{ arena } };
+		visible.reserve(scene.size());
+		LveCulling::Stats stats;
+		LveCulling::cull(scene, lodGroups, view, visible, stats);
+
+		// The chunks are appended in order, so the result is exactly the serial one
+		bool same = visible.size() == expected.size();
+		for (size_t i = 0; same && i < visible.size(); ++i)
+			same = visible[i].object == expected[i].object && visible[i].model == expected[i].model;
+		LVE_CHECK(same);
+
+		LVE_CHECK(stats.tested == scene.size());
+		LVE_CHECK(stats.drawn == expected.size());
+		LVE_CHECK(stats.culled == stats.tested - stats.drawn);
+		uint32_t perLod = 0;
+		for (uint32_t count : stats.drawnPerLod)
+			perLod += count;
+		LVE_CHECK(perLod == stats.drawn);
+	}
+
+	// Too few objects to split, and nothing at all
+	LveScene small = randomScene(1000, static_cast<uint32_t>(lodGroups.size()));
+	FrameVector<VisibleObject> visible;
+	LveCulling::Stats stats;
+	LveCulling::cull(small, lodGroups, view, visible, stats);
+	LVE_CHECK(visible.size() == reference(small, lodGroups, view).size());
+
+	LveCulling::cull(LveScene{}, lodGroups, view, visible, stats);
+	LVE_CHECK(visible.empty());
+	LVE_CHECK(stats.tested == 0);
+
+	return lve::test::result();
+}
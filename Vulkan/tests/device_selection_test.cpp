@@ -0,0 +1,127 @@
+#include "lve_device.hpp"
+#include "lve_test.hpp"
+
+// std
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+using namespace lve;
+
+// Device selection only looks at the candidate list, so made up devices stand in for a driver
+static PhysicalDeviceCandidate device(const char* name, VkPhysicalDeviceType type, VkDeviceSize heapMiB)
+{
+	PhysicalDeviceCandidate candidate{};
+	candidate.name = name;
+	candidate.type = type;
+	candidate.deviceLocalHeapSize = heapMiB << 20;
+	candidate.suitable = true;
+	return candidate;
+}
+
+static void typeRanking()
+{
+	auto discrete = device("Discrete", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 2048);
+	auto integrated = device("Integrated", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 8192);
+	auto virtualGpu = device("Virtual", VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU, 8192);
+	auto cpu = device("llvmpipe", VK_PHYSICAL_DEVICE_TYPE_CPU, 65536);
+	auto other = device("Other", VK_PHYSICAL_DEVICE_TYPE_OTHER, 65536);
+
+	LVE_CHECK(LveDevice::scorePhysicalDevice(discrete) > LveDevice::scorePhysicalDevice(integrated));
+	LVE_CHECK(LveDevice::scorePhysicalDevice(integrated) > LveDevice::scorePhysicalDevice(virtualGpu));
+	LVE_CHECK(LveDevice::scorePhysicalDevice(virtualGpu) > LveDevice::scorePhysicalDevice(cpu));
+	LVE_CHECK(LveDevice::scorePhysicalDevice(cpu) > LveDevice::scorePhysicalDevice(other));
+
+	// Memory, queues and features never lift a device over a better type, even when the
+	// better one has none of them
+	const PhysicalDeviceCandidate byType[] = { discrete, integrated, virtualGpu, cpu, other };
+	for (size_t better = 0; better + 1 < std::size(byType); ++better)
+	{
+		auto plain = byType[better];
+		plain.deviceLocalHeapSize = 0;
+		plain.maxImageDimension2D = 0;
+		auto maxed = byType[better + 1];
+		maxed.deviceLocalHeapSize = VkDeviceSize{ 1 } << 50;
+		maxed.dedicatedTransferQueue = true;
+		maxed.asyncComputeQueue = true;
+		maxed.optionalFeatureCount = 9;
+		maxed.maxImageDimension2D = UINT32_MAX;
+		LVE_CHECK(LveDevice::scorePhysicalDevice(plain) > LveDevice::scorePhysicalDevice(maxed));
+	}
+
+	// Within a type the rest decides
+	auto bigger = device("Bigger", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 16384);
+	auto withQueues = discrete;
+	withQueues.asyncComputeQueue = true;
+	LVE_CHECK(LveDevice::scorePhysicalDevice(bigger) > LveDevice::scorePhysicalDevice(discrete));
+	LVE_CHECK(LveDevice::scorePhysicalDevice(withQueues) > LveDevice::scorePhysicalDevice(discrete));
+
+	auto unsuitable = discrete;
+	unsuitable.suitable = false;
+	LVE_CHECK(LveDevice::scorePhysicalDevice(unsuitable) == -1);
+
+	auto selection = LveDevice::selectPhysicalDevice({ cpu, integrated, discrete, other }, "");
+	LVE_CHECK(selection.index == 2);
+	LVE_CHECK(selection.scores.size() == 4);
+	LVE_CHECK(selection.reason == "highest score");
+}
+
+static void requestedDevice()
+{
+	std::vector<PhysicalDeviceCandidate> candidates{
+		device("NVIDIA GeForce RTX 3080", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 10240),
+		device("Intel(R) UHD Graphics 770", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 4096),
+		device("llvmpipe (LLVM 15.0.6, 256 bits)", VK_PHYSICAL_DEVICE_TYPE_CPU, 32768),
+	};
+
+	auto byIndex = LveDevice::selectPhysicalDevice(candidates, "1");
+	LVE_CHECK(byIndex.index == 1);
+	LVE_CHECK(byIndex.reason == "requested \"1\"");
+
+	// Any part of the name, case insensitive
+	auto byName = LveDevice::selectPhysicalDevice(candidates, "LLVMpipe");
+	LVE_CHECK(byName.index == 2);
+	LVE_CHECK(LveDevice::selectPhysicalDevice(candidates, "uhd").index == 1);
+
+	// The first match wins when several names contain it
+	candidates.push_back(device("Intel(R) Arc A770", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 16384));
+	LVE_CHECK(LveDevice::selectPhysicalDevice(candidates, "intel").index == 1);
+}
+
+static void fallback()
+{
+	std::vector<PhysicalDeviceCandidate> candidates{
+		device("Integrated", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 4096),
+		device("Discrete", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192),
+	};
+
+	// Missing index or name, the best scoring device is used instead
+	LVE_CHECK(LveDevice::selectPhysicalDevice(candidates, "7").index == 1);
+	LVE_CHECK(LveDevice::selectPhysicalDevice(candidates, "Radeon").index == 1);
+	LVE_CHECK(LveDevice::selectPhysicalDevice(candidates, "Radeon").reason == "highest score");
+
+	// So is an unsuitable one
+	candidates[0].suitable = false;
+	auto unsuitable = LveDevice::selectPhysicalDevice(candidates, "0");
+	LVE_CHECK(unsuitable.index == 1);
+	LVE_CHECK(unsuitable.scores[0] == -1);
+
+	// Ties keep enumeration order
+	candidates[0].suitable = true;
+	candidates[0] = candidates[1];
+	LVE_CHECK(LveDevice::selectPhysicalDevice(candidates, "").index == 0);
+
+	// Nothing suitable at all
+	candidates[0].suitable = false;
+	candidates[1].suitable = false;
+	LVE_CHECK(LveDevice::selectPhysicalDevice(candidates, "").index == -1);
+	LVE_CHECK(LveDevice::selectPhysicalDevice({}, "").index == -1);
+}
+
+int main()
+{
+	typeRanking();
+	requestedDevice();
+	fallback();
+	return lve::test::result();
+}
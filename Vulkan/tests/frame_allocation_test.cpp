@@ -0,0 +1,80 @@
+#include "lve_allocation_counter.hpp"
+#include "lve_culling.hpp"
+#include "lve_draw_list.hpp"
+#include "lve_test.hpp"
+
+// std
+#include <array>
+#include <random>
+#include <vector>
+
+using namespace lve;
+
+// The CPU side of FirstApp::prepareFrame and buildDrawList without a device: blend the
+// simulation snapshots, cull into the frame's arena and sort the draws. Once warmed up
+// none of it may touch the heap, neither here nor in the culling jobs on the workers
+int main()
+{
+	constexpr size_t objectCount = 200000;
+	constexpr uint32_t framesInFlight = 2;
+
+	std::vector<LodGroup> lodGroups{
+		{ { { 0, 0.0f } }, 0.71f },
+		{ { { 1, 300.0f }, { 2, 120.0f }, { 3, 40.0f }, { 4, 0.0f } }, 1.42f },
+	};
+
+	LveScene scene;
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> unit{ -1.0f, 1.0f };
+	for (size_t i = 0; i < objectCount; ++i)
+	{
+		scene.add({ unit(random), unit(random) }, { unit(random), unit(random) }, 0.01f + 0.05f * (unit(random) + 1.0f),
+			{ 1.0f, 1.0f, 1.0f }, static_cast<LodGroupHandle>(i % lodGroups.size()), static_cast<uint32_t>(i % 3));
+	}
+
+	LveScene::Frame previous, current;
+	scene.saveFrame(previous);
+	scene.update(1.0f / 60.0f);
+	scene.saveFrame(current);
+
+	std::array<LveFrameArena, framesInFlight> arenas;
+	LveDrawList drawList;
+	LveCulling::View view;
+	view.halfExtent = 0.6f;
+
+	auto frame = [&](uint32_t frameNumber)
+	{
+		auto& arena = arenas[frameNumber % framesInFlight];
+		arena.reset();
+
+		scene.interpolate(previous, current, (frameNumber % 10) / 10.0f);
+
+		FrameVector<VisibleObject> visible{ LveArenaAllocator<VisibleObject>(arena) };
+		visible.reserve(scene.size());
+		LveCulling::Stats stats;
+		LveCulling::cull(scene, lodGroups, view, visible, stats);
+
+		drawList.clear(arena);
+		for (const auto& object : visible)
+		{
+			uint32_t material = scene.material(object.object);
+			drawList.add(LveDrawList::makeKey(material, 0, object.model, 0.0f), { material, object.model, object.object });
+		}
+		drawList.sort();
+		return drawList.size();
+	};
+
+	// The arenas grow to fit a frame and the draw list learns its size
+	uint32_t frameNumber = 0;
+	for (; frameNumber < 8; ++frameNumber)
+		frame(frameNumber);
+
+	uint64_t before = LveAllocationCounter::totalAllocations();
+	size_t draws = 0;
+	for (; frameNumber < 108; ++frameNumber)
+		draws += frame(frameNumber);
+	LVE_CHECK(LveAllocationCounter::totalAllocations() == before);
+	LVE_CHECK(draws > 0);
+
+	return lve::test::result();
+}
@@ -0,0 +1,197 @@
+#include "lve_allocation_counter.hpp"
+#include "lve_job_system.hpp"
+#include "lve_test.hpp"
+
+// std
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace lve;
+
+// Every check runs with no workers, where jobs only run inside wait(), and with more
+// workers than most CI machines have cores, where they also run while being queued
+static const uint32_t threadCounts[] = { 1, 2, 4, 8 };
+
+static void parallelForCoversEveryIndex(LveJobSystem& jobs)
+{
+	// A count that is not a multiple of minChunk, so the last chunk is short
+	std::vector<int> hits(100003, 0);
+	for (int repeat = 0; repeat < 20; ++repeat)
+	{
+		jobs.parallelFor(hits.size(), 7, [&](size_t begin, size_t end)
+			{
+				LVE_CHECK(begin % 7 == 0);
+				for (size_t i = begin; i < end; ++i)
+					hits[i]++;
+			});
+	}
+
+	bool allTwenty = true;
+	for (int hit : hits)
+		allTwenty = allTwenty && hit == 20;
+	LVE_CHECK(allTwenty);
+
+	// Nothing to do and less than one chunk
+	int calls = 0;
+	jobs.parallelFor(0, 16, [&](size_t, size_t) { ++calls; });
+	LVE_CHECK(calls == 0);
+	jobs.parallelFor(5, 16, [&](size_t begin, size_t end) { calls += begin == 0 && end == 5; });
+	LVE_CHECK(calls == 1);
+}
+
+static void nestedWaits(LveJobSystem& jobs)
+{
+	// Jobs that wait for their own children, more of them than there are workers
+	std::atomic<int> ran{ 0 };
+	LveJobSystem::Counter outer;
+	for (int i = 0; i < 50; ++i)
+	{
+		jobs.run([&]()
+			{
+				LveJobSystem::Counter children;
+				for (int k = 0; k < 100; ++k)
+					jobs.run([&]() { ran.fetch_add(1, std::memory_order_relaxed); }, &children);
+				jobs.wait(children);
+			}, &outer);
+	}
+	jobs.wait(outer);
+	LVE_CHECK(ran == 5000);
+
+	// parallelFor from inside a parallelFor
+	std::atomic<size_t> sum{ 0 };
+	jobs.parallelFor(64, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				jobs.parallelFor(1000, 10, [&](size_t innerBegin, size_t innerEnd) { sum += innerEnd - innerBegin; });
+		});
+	LVE_CHECK(sum == 64 * 1000);
+}
+
+static void exceptionsReachTheWaiter(LveJobSystem& jobs)
+{
+	// The first one is rethrown, only after every job of the group has finished
+	std::atomic<int> finished{ 0 };
+	LveJobSystem::Counter counter;
+	for (int i = 0; i < 10; ++i)
+	{
+		jobs.run([i, &finished]()
+			{
+				finished.fetch_add(1);
+				if (i == 3 || i == 7)
+					throw std::runtime_error("job " + std::to_string(i));
+			}, &counter);
+	}
+
+	bool caught = false;
+	try
+	{
+		jobs.wait(counter);
+	}
+	catch (const std::runtime_error& e)
+	{
+		caught = std::string(e.what()) == "job 3" || std::string(e.what()) == "job 7";
+	}
+	LVE_CHECK(caught);
+	LVE_CHECK(finished == 10);
+	LVE_CHECK(counter.done());
+
+	// From any chunk of a parallelFor, including the caller's own first one
+	for (size_t failing : { size_t{ 0 }, size_t{ 999 } })
+	{
+		caught = false;
+		try
+		{
+			jobs.parallelFor(1000, 10, [failing](size_t begin, size_t end)
+				{
+					if (failing >= begin && failing < end)
+						throw std::runtime_error("chunk");
+				});
+		}
+		catch (const std::runtime_error&)
+		{
+			caught = true;
+		}
+		LVE_CHECK(caught);
+	}
+
+	// Jobs nobody waits on only print theirs, the pool keeps working. The job waited on also
+	// waits for that one to throw, its exception is allocated on whichever thread runs it and
+	// must not land in a later allocation check
+	std::atomic<bool> thrown{ false };
+	std::atomic<int> after{ 0 };
+	LveJobSystem::Counter afterCounter;
+	jobs.run([&]()
+		{
+			while (!thrown)
+				std::this_thread::yield();
+			after = 1;
+		}, &afterCounter);
+	jobs.run([&thrown]()
+		{
+			struct SetOnUnwind
+			{
+				std::atomic<bool>& flag;
+				~SetOnUnwind() { flag = true; }
+			} setOnUnwind{ thrown };
+			throw std::runtime_error("ignored");
+		});
+	jobs.wait(afterCounter);
+	LVE_CHECK(after == 1);
+}
+
+static void steadyStateDoesNotAllocate(LveJobSystem& jobs)
+{
+	// Enough jobs that the shared queue grows past its first capacity while warming up
+	std::vector<float> values(1 << 16);
+	std::atomic<int> ran{ 0 };
+	auto frame = [&]()
+	{
+		jobs.parallelFor(values.size(), 64, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					values[i] = values[i] * 0.5f + 1.0f;
+			});
+		LveJobSystem::Counter counter;
+		for (int i = 0; i < 1000; ++i)
+			jobs.run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		jobs.wait(counter);
+	};
+
+	for (int warmup = 0; warmup < 3; ++warmup)
+		frame();
+	// Over all threads, the workers run most of the jobs
+	uint64_t before = LveAllocationCounter::totalAllocations();
+	for (int repeat = 0; repeat < 100; ++repeat)
+		frame();
+	LVE_CHECK(LveAllocationCounter::totalAllocations() == before);
+	LVE_CHECK(ran == 103 * 1000);
+}
+
+static void destructorDrainsQueuedJobs(uint32_t threadCount)
+{
+	std::atomic<int> ran{ 0 };
+	{
+		LveJobSystem jobs{ threadCount };
+		for (int i = 0; i < 1000; ++i)
+			jobs.run([&]() { ran.fetch_add(1, std::memory_order_relaxed); });
+	}
+	LVE_CHECK(ran == 1000);
+}
+
+int main()
+{
+	for (uint32_t threadCount : threadCounts)
+	{
+		LveJobSystem jobs{ threadCount };
+		LVE_CHECK(jobs.threadCount() == threadCount);
+		parallelForCoversEveryIndex(jobs);
+		nestedWaits(jobs);
+		exceptionsReachTheWaiter(jobs);
+		steadyStateDoesNotAllocate(jobs);
+		destructorDrainsQueuedJobs(threadCount);
+	}
+	return lve::test::result();
+}
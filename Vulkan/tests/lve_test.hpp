@@ -0,0 +1,32 @@
+#pragma once
+
+// std
+#include <iostream>
+
+// A failed check is printed and fails the test, the checks after it still run:
+//     LVE_CHECK(selection.index == 1);
+//     return lve::test::result();
+#define LVE_CHECK(condition) ::lve::test::check((condition), #condition, __FILE__, __LINE__)
+
+namespace lve::test
+{
+	inline int failures = 0;
+
+	inline bool check(bool passed, const char* condition, const char* file, int line)
+	{
+		if (!passed)
+		{
+			std::cerr << file << ":" << line << ": check failed: " << condition << "\n";
+			++failures;
+		}
+		return passed;
+	}
+
+	// main's return value
+	inline int result()
+	{
+		if (failures > 0)
+			std::cerr << failures << " checks failed\n";
+		return failures == 0 ? 0 : 1;
+	}
+}
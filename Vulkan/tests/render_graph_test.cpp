@@ -0,0 +1,262 @@
+#include "lve_gpu_trace.hpp"
+#include "lve_render_graph.hpp"
+#include "lve_test.hpp"
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace lve;
+
+// compile() and execute() only create images, bind memory and record barriers, so the
+// Vulkan calls they make are defined here and remember what they were given. The test
+// links none of the rest of the engine
+namespace
+{
+	struct ImageRecord
+	{
+		VkDeviceSize size = 0;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+	};
+
+	std::map<VkImage, ImageRecord> images;
+	uint64_t nextHandle = 0x100;
+	std::vector<VkDeviceSize> allocations;
+	uint32_t barrierCalls = 0;
+	std::vector<VkImageMemoryBarrier> recordedImageBarriers;
+	std::vector<std::string> recordedPasses;
+
+	template<typename Handle>
+	Handle newHandle()
+	{
+		return reinterpret_cast<Handle>(static_cast<uintptr_t>(++nextHandle));
+	}
+}
+
+extern "C"
+{
+	VkResult vkCreateImage(VkDevice, const VkImageCreateInfo* createInfo, const VkAllocationCallbacks*, VkImage* image)
+	{
+		*image = newHandle<VkImage>();
+		images[*image].size = VkDeviceSize{ createInfo->extent.width } * createInfo->extent.height * 4;
+		return VK_SUCCESS;
+	}
+
+	void vkGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* requirements)
+	{
+		requirements->size = images[image].size;
+		requirements->alignment = 256;
+		requirements->memoryTypeBits = 3;
+	}
+
+	VkResult vkBindImageMemory(VkDevice, VkImage image, VkDeviceMemory memory, VkDeviceSize offset)
+	{
+		images[image].memory = memory;
+		images[image].offset = offset;
+		return VK_SUCCESS;
+	}
+
+	VkResult vkCreateImageView(VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView* view)
+	{
+		*view = newHandle<VkImageView>();
+		return VK_SUCCESS;
+	}
+
+	void vkDestroyImageView(VkDevice, VkImageView, const VkAllocationCallbacks*) {}
+
+	void vkDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks*)
+	{
+		images.erase(image);
+	}
+
+	void vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags,
+		uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*,
+		uint32_t imageBarrierCount, const VkImageMemoryBarrier* imageBarriers)
+	{
+		++barrierCalls;
+		recordedImageBarriers.insert(recordedImageBarriers.end(), imageBarriers, imageBarriers + imageBarrierCount);
+	}
+}
+
+namespace lve
+{
+	void LveDevice::allocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags, VkDeviceMemory& memory, MemoryTag)
+	{
+		memory = newHandle<VkDeviceMemory>();
+		allocations.push_back(requirements.size);
+	}
+
+	void LveDevice::freeMemory(VkDeviceMemory) {}
+
+	MemoryTag LveMemoryTracker::tagForImageUsage(VkImageUsageFlags)
+	{
+		return MemoryTag::ColorTarget;
+	}
+
+	uint32_t LveGpuTrace::begin(VkCommandBuffer, const char*)
+	{
+		return NO_RANGE;
+	}
+
+	void LveGpuTrace::end(VkCommandBuffer, uint32_t, VkPipelineStageFlagBits) {}
+}
+
+static LveRenderGraph::Record recordAs(const char* name)
+{
+	return [name](VkCommandBuffer) { recordedPasses.push_back(name); };
+}
+
+static const VkImageMemoryBarrier* barrierFor(VkImage image)
+{
+	for (const auto& barrier : recordedImageBarriers)
+	{
+		if (barrier.image == image)
+			return &barrier;
+	}
+	return nullptr;
+}
+
+// What FirstApp builds: particles and chaos game compute, the scene and a readback copy
+static void frameGraph(LveDevice& device)
+{
+	LveRenderGraph graph{ device };
+	auto color = graph.importExternalImage("color", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	auto depth = graph.importImage("depth", VK_IMAGE_ASPECT_DEPTH_BIT);
+	graph.output(color);
+
+	auto particles = graph.importBuffer("particles");
+	auto step = graph.addPass("particles", recordAs("particles"));
+	graph.readWrite(step, particles, RenderGraphUsage::computeStorage());
+
+	// Writes something nobody reads
+	auto unused = graph.addPass("unused", recordAs("unused"));
+	graph.write(unused, graph.importBuffer("unused"), RenderGraphUsage::computeStorage());
+
+	auto scene = graph.addPass("scene", recordAs("scene"));
+	graph.write(scene, color, RenderGraphUsage::colorAttachment());
+	graph.write(scene, depth, RenderGraphUsage::depthAttachment());
+	graph.read(scene, particles, RenderGraphUsage::vertexBuffer());
+
+	auto readback = graph.addPass("readback", recordAs("readback"));
+	graph.read(readback, color, RenderGraphUsage::transferSource());
+	graph.keep(readback);
+
+	graph.compile();
+	auto stats = graph.stats();
+	LVE_CHECK(stats.passes == 3);
+	LVE_CHECK(stats.culledPasses == 1);
+	LVE_CHECK(stats.transientImages == 0);
+	LVE_CHECK(allocations.empty());
+
+	VkImage colorImage = newHandle<VkImage>();
+	VkImage depthImage = newHandle<VkImage>();
+	graph.setImage(color, colorImage);
+	graph.setImage(depth, depthImage);
+	barrierCalls = 0;
+	recordedImageBarriers.clear();
+	recordedPasses.clear();
+	graph.execute(VK_NULL_HANDLE);
+
+	LVE_CHECK((recordedPasses == std::vector<std::string>{ "particles", "scene", "readback" }));
+	// execute() records exactly the plan compile() counted
+	LVE_CHECK(barrierCalls == stats.barriers);
+	LVE_CHECK(recordedImageBarriers.size() == stats.imageBarriers);
+
+	// The color image ends up where presenting expects it
+	VkImageLayout lastColorLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	for (const auto& barrier : recordedImageBarriers)
+	{
+		if (barrier.image == colorImage)
+			lastColorLayout = barrier.newLayout;
+	}
+	LVE_CHECK(lastColorLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+	// Another frame records the same again
+	barrierCalls = 0;
+	recordedPasses.clear();
+	graph.execute(VK_NULL_HANDLE);
+	LVE_CHECK(barrierCalls == stats.barriers);
+	LVE_CHECK(recordedPasses.size() == 3);
+}
+
+// A shadow map only read by the first lighting pass and a bloom image only used at the end
+// never live at the same time, they share memory. The HDR image overlaps both
+static void transientAliasing(LveDevice& device)
+{
+	allocations.clear();
+	LveRenderGraph graph{ device };
+	auto color = graph.importExternalImage("color", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	graph.output(color);
+
+	LveRenderGraph::TransientImageInfo hdrInfo{ VK_FORMAT_R8G8B8A8_UNORM, { 1920, 1080 },
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT };
+	auto shadow = graph.createImage("shadow", { VK_FORMAT_D32_SFLOAT, { 2048, 2048 },
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT });
+	auto hdr = graph.createImage("hdr", hdrInfo);
+	auto bloom = graph.createImage("bloom", hdrInfo);
+	// Never used, so never created
+	graph.createImage("unused", hdrInfo);
+
+	RenderGraphUsage sampled{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	auto shadowPass = graph.addPass("shadow", recordAs("shadow"));
+	graph.write(shadowPass, shadow, RenderGraphUsage::depthAttachment());
+	auto lighting = graph.addPass("lighting", recordAs("lighting"));
+	graph.read(lighting, shadow, sampled);
+	graph.write(lighting, hdr, RenderGraphUsage::colorAttachment());
+	auto bloomPass = graph.addPass("bloom", recordAs("bloom"));
+	graph.read(bloomPass, hdr, sampled);
+	graph.write(bloomPass, bloom, RenderGraphUsage::colorAttachment());
+	auto tonemap = graph.addPass("tonemap", recordAs("tonemap"));
+	graph.read(tonemap, hdr, sampled);
+	graph.read(tonemap, bloom, sampled);
+	graph.write(tonemap, color, RenderGraphUsage::colorAttachment());
+
+	graph.compile();
+	auto stats = graph.stats();
+	LVE_CHECK(stats.passes == 4);
+	LVE_CHECK(stats.transientImages == 3);
+	LVE_CHECK(images.size() == 3);
+	LVE_CHECK(allocations.size() == 2);
+
+	const ImageRecord& shadowImage = images[graph.image(shadow)];
+	const ImageRecord& hdrImage = images[graph.image(hdr)];
+	const ImageRecord& bloomImage = images[graph.image(bloom)];
+	LVE_CHECK(shadowImage.memory != VK_NULL_HANDLE && shadowImage.memory == bloomImage.memory);
+	LVE_CHECK(hdrImage.memory != shadowImage.memory);
+	LVE_CHECK(shadowImage.offset == 0 && hdrImage.offset == 0 && bloomImage.offset == 0);
+	LVE_CHECK(graph.imageView(hdr) != VK_NULL_HANDLE);
+
+	// The shared allocation fits the larger of the two, nothing is counted twice
+	VkDeviceSize unaliased = shadowImage.size + hdrImage.size + bloomImage.size;
+	LVE_CHECK(stats.unaliasedBytes == unaliased);
+	LVE_CHECK(stats.transientBytes == unaliased - std::min(shadowImage.size, bloomImage.size));
+
+	// An aliased image holds whatever was there, its first use starts from UNDEFINED
+	VkImage colorImage = newHandle<VkImage>();
+	graph.setImage(color, colorImage);
+	recordedImageBarriers.clear();
+	graph.execute(VK_NULL_HANDLE);
+	const VkImageMemoryBarrier* bloomBarrier = barrierFor(graph.image(bloom));
+	LVE_CHECK(bloomBarrier != nullptr && bloomBarrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+
+	graph.reset();
+	LVE_CHECK(images.empty());
+}
+
+int main()
+{
+	// Never constructed: the graph only passes it to the functions defined above and reads
+	// device(), which is a null handle here
+	alignas(LveDevice) static unsigned char storage[sizeof(LveDevice)]{};
+	LveDevice& device = *reinterpret_cast<LveDevice*>(storage);
+
+	frameGraph(device);
+	transientAliasing(device);
+	return lve::test::result();
+}